@@ -4,7 +4,12 @@
 #define SWIG_FILE_WITH_INIT
 #include "iCub/eventdriven/vCodec.h"
 #include "iCub/eventdriven/vBottle.h"
+#include "iCub/eventdriven/vPort.h"
 #include <yarp/os/Bottle.h>
+#include <yarp/os/Stamp.h>
+#include <fstream>
+#include <cstdlib>
+#include <algorithm>
 #include <deque>
 #include <vector>
 #include <memory>
@@ -27,6 +32,13 @@ import_array();
                                             (unsigned int* s4, int m4),
                                             (unsigned int* s5, int m5)};
 
+//batch access: records are the EVENT_DTYPE structured array viewed as uint32
+%apply (int* IN_ARRAY1, int DIM1) {(int* words, int n_words)};
+%apply (int* INPLACE_ARRAY1, int DIM1) {(int* out_words, int n_out)};
+%apply (unsigned int* IN_ARRAY1, int DIM1) {(unsigned int* in_records, int n_in)};
+%apply (unsigned int* INPLACE_ARRAY1, int DIM1) {(unsigned int* records, int n_records)};
+%apply (int** ARGOUTVIEW_ARRAY1, int* DIM1) {(int** view, int* n_view)};
+
 namespace ev {
 
 
@@ -165,6 +177,21 @@ public:
         //}
     }
 
+    int _decode(unsigned int* records, int n_records)
+    {
+        std::vector<ev::AE> batch;
+        $self->addtoendof(batch);
+        int n = std::min((int)batch.size(), n_records / 5);
+        for(int i = 0; i < n; i++) {
+            *(records++) = batch[i].stamp;
+            *(records++) = batch[i].x;
+            *(records++) = batch[i].y;
+            *(records++) = batch[i].polarity;
+            *(records++) = batch[i].channel;
+        }
+        return n;
+    }
+
     void _setData(unsigned int* s1, int m1,
                  unsigned int* s2, int m2,
          unsigned int* s3, int m3,
@@ -203,6 +230,77 @@ def setData(binp, data):
         raise ValueError('argument data requires shape (512, 5) and uint32')
     binp._setData(*data.T)
 
+EVENT_DTYPE = np.dtype([('ts', np.uint32), ('x', np.uint32), ('y', np.uint32),
+                        ('pol', np.uint32), ('ch', np.uint32)])
+
+def _records(events):
+    """ a uint32 view of an EVENT_DTYPE array for the batch functions """
+    events = np.ascontiguousarray(events)
+    if events.dtype != EVENT_DTYPE:
+        raise ValueError('events require dtype EVENT_DTYPE')
+    return events.view(np.uint32)
+
+def getEvents(binp):
+    """ returns the AE events contained in the vBottle binp as an
+    EVENT_DTYPE array """
+    events = np.empty(binp.getSize(), dtype=EVENT_DTYPE)
+    n = binp._decode(events.view(np.uint32))
+    return events[:n]
+
+def decodeAE(words):
+    """ decodes [TS AE TS AE ...] words into an EVENT_DTYPE array """
+    words = np.ascontiguousarray(words, dtype=np.int32)
+    events = np.empty(len(words) // 2, dtype=EVENT_DTYPE)
+    _decodeAE(words, events.view(np.uint32))
+    return events
+
+def encodeAE(events):
+    """ encodes an EVENT_DTYPE array into [TS AE TS AE ...] words """
+    words = np.empty(2 * len(events), dtype=np.int32)
+    _encodeAE(_records(events), words)
+    return words
+
+def fromPacket(buffer):
+    """ returns the event type and a view (no copy) of the words of a packet
+    in the wire format of a vWritePort (e.g. bytes read from a connection) """
+    header = np.frombuffer(buffer, dtype=np.int32, count=4)
+    tag = bytes(buffer[16:16 + header[3]]).decode()
+    offset = 16 + header[3]
+    n = np.frombuffer(buffer, dtype=np.int32, count=2, offset=offset)[1]
+    return tag, np.frombuffer(buffer, dtype=np.int32, count=n, offset=offset + 8)
+
+def loadLog(filename, tag='AE'):
+    """ returns the events of type tag recorded by yarpdatadumper in
+    filename as an EVENT_DTYPE array """
+    log = vEventLog()
+    if not log.load(filename, tag):
+        raise IOError('could not read ' + filename)
+    return decodeAE(log.view())
+
+def saveLog(filename, events, packet_size=1000, period=0.001):
+    """ writes an EVENT_DTYPE array as a yarpdatadumper log of packets of
+    packet_size events sent every period seconds """
+    words = encodeAE(events)
+    with open(filename, 'w') as f:
+        for i, start in enumerate(range(0, len(words), 2 * packet_size)):
+            packet = words[start:start + 2 * packet_size]
+            f.write('%d %f AE (%s)\n' % (i, i * period,
+                                         ' '.join(map(str, packet.tolist()))))
+
+def readEvents(reader):
+    """ blocks until the next packet arrives at the vEventReader and returns
+    its events as an EVENT_DTYPE array, or None if the reader was closed """
+    n = reader.read()
+    if n < 0:
+        return None
+    events = np.empty(n, dtype=EVENT_DTYPE)
+    reader._decode(events.view(np.uint32))
+    return events
+
+def writeEvents(writer, events):
+    """ sends an EVENT_DTYPE array as a single packet on the vEventWriter """
+    return writer._write(_records(events))
+
 #vBottle.getData = classmethod(_class_getData)
 #vBottle.setData = classmethod(_class_setData)
 
@@ -216,3 +314,174 @@ def setData(binp, data):
   }
 %}
 
+%inline %{
+namespace ev {
+
+/// \brief decode [TS AE TS AE ...] words into [ts x y pol ch] records
+int _decodeAE(int* words, int n_words, unsigned int* records, int n_records)
+{
+    int n = std::min(n_words / 2, n_records / 5);
+    const int32_t *data = words;
+    AE v;
+    for(int i = 0; i < n; i++) {
+        v.decode(data);
+        *(records++) = v.stamp;
+        *(records++) = v.x;
+        *(records++) = v.y;
+        *(records++) = v.polarity;
+        *(records++) = v.channel;
+    }
+    return n;
+}
+
+/// \brief encode [ts x y pol ch] records into [TS AE TS AE ...] words
+int _encodeAE(unsigned int* in_records, int n_in, int* out_words, int n_out)
+{
+    int n = std::min(n_in / 5, n_out / 2);
+    std::vector<int32_t> pair(2);
+    AE v;
+    for(int i = 0; i < n; i++) {
+        v.stamp = *(in_records++);
+        v.x = *(in_records++);
+        v.y = *(in_records++);
+        v.polarity = *(in_records++);
+        v.channel = *(in_records++);
+        unsigned int pos = 0;
+        v.encode(pair, pos);
+        *(out_words++) = pair[0];
+        *(out_words++) = pair[1];
+    }
+    return n;
+}
+
+/// \brief reads packets of AE from a vWritePort. The raw words of the last
+/// packet can be viewed without a copy until the next read().
+class vEventReader
+{
+private:
+
+    vReadPort< std::vector<int32_t> > port;
+    const std::vector<int32_t> *packet;
+    yarp::os::Stamp stamp;
+
+public:
+
+    vEventReader() : packet(nullptr) {}
+
+    bool open(std::string name, std::string shared_source = "")
+    {
+        return port.open(name, shared_source);
+    }
+
+    void close()
+    {
+        port.close();
+        packet = nullptr;
+    }
+
+    /// \brief block until the next packet arrives
+    /// \returns the number of events in the packet or -1 if closed
+    int read()
+    {
+        packet = port.read(stamp);
+        return packet ? (int)packet->size() / 2 : -1;
+    }
+
+    /// \brief the words of the last packet
+    void view(int** view, int* n_view)
+    {
+        *view = packet ? (int *)packet->data() : nullptr;
+        *n_view = packet ? (int)packet->size() : 0;
+    }
+
+    int _decode(unsigned int* records, int n_records)
+    {
+        if(!packet) return 0;
+        return _decodeAE((int *)packet->data(), packet->size(), records,
+                         n_records);
+    }
+
+    double getTime() { return stamp.getTime(); }
+    int getCount() { return stamp.getCount(); }
+    int queryunprocessed() { return port.queryunprocessed(); }
+
+};
+
+/// \brief writes batches of AE records to a vWritePort
+class vEventWriter
+{
+private:
+
+    vWritePort port;
+    std::vector<int32_t> words;
+    yarp::os::Stamp stamp;
+
+public:
+
+    bool open(std::string name)
+    {
+        port.setWriteType(AE::tag);
+        return port.open(name);
+    }
+
+    void close()
+    {
+        port.close();
+    }
+
+    int _write(unsigned int* in_records, int n_in)
+    {
+        words.resize(2 * (n_in / 5));
+        int n = _encodeAE(in_records, n_in, words.data(), words.size());
+        stamp.update();
+        if(!port.write(words, stamp))
+            return -1;
+        return n;
+    }
+
+};
+
+/// \brief the words of one event type recorded by yarpdatadumper
+class vEventLog
+{
+private:
+
+    std::vector<int32_t> words;
+
+public:
+
+    /// \brief read all packets of type tag from a data.log file
+    bool load(std::string filename, std::string tag = "AE")
+    {
+        std::ifstream file(filename.c_str());
+        if(!file.is_open()) return false;
+
+        words.clear();
+        std::string line;
+        std::string label = " " + tag + " (";
+        while(std::getline(file, line)) {
+            size_t start = line.find(label);
+            if(start == std::string::npos) continue;
+            const char *c = line.c_str() + start + label.size();
+            char *next = nullptr;
+            while(true) {
+                long w = std::strtol(c, &next, 10);
+                if(next == c) break;
+                words.push_back(w);
+                c = next;
+            }
+        }
+        return true;
+    }
+
+    void view(int** view, int* n_view)
+    {
+        *view = (int *)words.data();
+        *n_view = words.size();
+    }
+
+};
+
+}
+%}
+
@@ -1,5 +1,13 @@
 #include "iCub/eventdriven/vtsHelper.h"
 #include "iCub/eventdriven/vCodec.h"
 #include "iCub/eventdriven/vPort.h"
+#include "iCub/eventdriven/vTrace.h"
+#include "iCub/eventdriven/vMetrics.h"
+#include "iCub/eventdriven/vProfile.h"
 #include "iCub/eventdriven/vFilters.h"
+#include "iCub/eventdriven/vMoments.h"
+#include "iCub/eventdriven/vTarget.h"
+#include "iCub/eventdriven/vSkin.h"
+#include "iCub/eventdriven/vMerge.h"
+#include "iCub/eventdriven/vSync.h"
 #include "iCub/eventdriven/vCollectSend.h"
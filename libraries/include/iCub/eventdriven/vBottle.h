@@ -148,18 +148,48 @@ public:
                 break;
             }
 
-            //and decode each one also creating the memory with clone
+            //copy the (EVENTS) once into a contiguous block and decode each
+            //one from it, also creating the memory with clone
             //NOTE: push_back seems as fast as preallocation for a deque
-            size_t pos_b = 0;
-            while(pos_b < b->size()) {
-                if(e->decode(*b, pos_b)) {
-                    q.push_back(e->clone());
-                }
+            size_t stride = packetSize(e->getType());
+            const int32_t *data = intBlock(*b);
+            const int32_t *end = data + stride * (block.size() / stride);
+            while(data < end) {
+                e->decode(data);
+                q.push_back(e->clone());
             }
         }
 
     }
 
+    /// \brief add a specific event-type from the vBottle to the end of a
+    /// typed batch. Only the events with the tag T::tag are decoded and no
+    /// memory is allocated per event.
+    template<class T> void addtoendof(std::vector<T> &batch) {
+
+        for(size_t i = 0; i < Bottle::size(); i+=2) {
+
+            if(Bottle::get(i).asString() != T::tag)
+                continue;
+
+            Bottle * b = Bottle::get(i+1).asList();
+            if(!b) {
+                yError() << "Warning: could not get event data as a list after "
+                             "getting correct tag (e.g. AE) in vBottle::"
+                             "addtoendof(). Check vBottle integrity";
+                break;
+            }
+
+            size_t stride = packetSize(T::tag);
+            const int32_t *data = intBlock(*b);
+            size_t pos = batch.size();
+            batch.resize(pos + block.size() / stride);
+            for(; pos < batch.size(); pos++)
+                batch[pos].decode(data);
+        }
+
+    }
+
     /// \brief get a specific event-type and ensure they are in correct
     /// temporal order
     template<class T> vQueue getSorted()
@@ -246,6 +276,18 @@ private:
 
     yarp::os::Value pop();
 
+    //the last list of events copied by intBlock()
+    std::vector<int32_t> block;
+
+    /// \brief copy the ints of a list of events into block in a single pass
+    const int32_t *intBlock(const Bottle &b)
+    {
+        block.resize(b.size());
+        for(size_t i = 0; i < block.size(); i++)
+            block[i] = b.get(i).asInt();
+        return block.data();
+    }
+
 };
 
 /// \brief a vBottle that avoids memory allocation where possible and can be
@@ -20,6 +20,7 @@
 #define __VCODEC__
 
 #include "vtsHelper.h"
+#include "vProfile.h"
 #include <memory>
 #include <deque>
 #include <math.h>
@@ -46,9 +47,16 @@ template<typename V1, typename V2> inline event<V1> as_event(event<V2> orig_even
 template<typename V1, typename V2> inline event<V1> is_event(event<V2> orig_event) {
     return std::static_pointer_cast<V1>(orig_event);
 }
+/// \brief the events of type V as counted by the vProfiler
+template<typename V> struct vEventKind {
+    static std::string kind() { return "event"; }
+    static std::string type() { return V::tag; }
+};
+/// \brief the allocator of events, counted when profiling is enabled
+template<typename V> using vEventAllocator = vProfileAllocator<V, vEventKind<V> >;
 /// \brief allocate memory for, and instantiate, a new event
 template<typename V> event<V> inline make_event(void) {
-    return std::make_shared<V>();
+    return std::allocate_shared<V>(vEventAllocator<V>());
 }
 /// \brief a fast event-type conversion to access event data. Does no checking
 /// that the event actually exists.
@@ -58,10 +66,16 @@ template<typename V> inline V* read_as(const event<> &orig_event) {
 /// \brief make a new event, copying from an existent event. Can be used to
 /// upgrade the event-type.
 template<typename V1, typename V2> event<V1> make_event(event<V2> orig_event) {
-    return std::make_shared<V1>(*(orig_event.get()));
+    return std::allocate_shared<V1>(vEventAllocator<V1>(), *(orig_event.get()));
 }
+/// \brief the memory of vQueues as counted by the vProfiler
+struct vQueueKind {
+    static std::string kind() { return "vQueue"; }
+    static std::string type() { return "deque"; }
+};
 /// \brief vQueue is a wrapper for a deque of "event"
-using vQueue = std::deque< event<vEvent> >;
+using vQueue = std::deque< event<vEvent>,
+                           vProfileAllocator< event<vEvent>, vQueueKind > >;
 
 /// \brief sort a vQueue ensuring temporal order
 void qsort(vQueue &q, bool respectWraps = false);
@@ -105,15 +119,18 @@ class AddressEvent : public vEvent
 {
 public:
     static const std::string tag;
+    //! the number of bits of x and y (the largest address is 2^bits - 1)
+    static const int xbits = 9;
+    static const int ybits = 8;
 
     union
     {
         uint32_t _coded_data;
         struct {
             unsigned int polarity:1;
-            unsigned int x:9;
+            unsigned int x:xbits;
             unsigned int _xfill:2;
-            unsigned int y:8;
+            unsigned int y:ybits;
             unsigned int _yfill:2;
             unsigned int channel:1;
             unsigned int type:1;
@@ -274,6 +291,36 @@ public:
     virtual std::string getType() const;
 };
 
+/// \brief an AddressEvent with a sub-pixel position and a weight, e.g. one of
+/// the (up to four) pixels an undistorted event is shared between. x and y
+/// are the pixel, subx and suby the position in 1/subpixel pixels.
+class WeightedAE : public AddressEvent
+{
+public:
+    static const std::string tag;
+    static const int subpixel = 32;
+    union {
+        uint32_t _waei[2];
+        struct {
+            int16_t subx;
+            int16_t suby;
+            float weight;
+        };
+    };
+
+    WeightedAE();
+    WeightedAE(const vEvent &v);
+    WeightedAE(const WeightedAE &v);
+
+    virtual event<> clone();
+    virtual void encode(yarp::os::Bottle &b) const;
+    virtual void encode(std::vector<int32_t> &b, unsigned int &pos) const;
+    virtual bool decode(const yarp::os::Bottle &packet, size_t &pos);
+    virtual void decode(const int32_t *&data);
+    virtual yarp::os::Property getContent() const;
+    virtual std::string getType() const;
+};
+
 /// \brief count the events in a vQueue
 template <class T> size_t countEvents(const T &q) { return q.size(); }
 //template <> size_t countEvents<vQueue>(const T &q) { return q.size(); }
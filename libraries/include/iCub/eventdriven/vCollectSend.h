@@ -21,6 +21,7 @@
 
 #include <iCub/eventdriven/vCodec.h>
 #include <iCub/eventdriven/vBottle.h>
+#include <iCub/eventdriven/vMetrics.h>
 #include <yarp/os/all.h>
 
 namespace ev {
@@ -35,13 +36,13 @@ private:
     yarp::os::BufferedPort<vBottle> sendPort;
     yarp::os::Mutex m;
     yarp::os::Stamp ystamp;
-
+    bool stamped;
 
 
 public:
 
     /// \brief constructor
-    collectorPort() : RateThread(1.0) {}
+    collectorPort() : RateThread(1.0), stamped(false) {}
 
     /// \brief open the output port
     bool open(std::string name) {
@@ -50,16 +51,27 @@ public:
 
     }
 
-    /// \brief add an event to be sent on next thread execution
+    /// \brief add an event to be sent on next thread execution. The vBottle
+    /// is sent with the envelope of the first event added, so the age of
+    /// the oldest event is kept.
     void pushevent(event<> v, yarp::os::Stamp y) {
 
         m.lock();
         filler.addEvent(v);
-        ystamp = y;
+        if(!stamped) {
+            ystamp = y;
+            stamped = true;
+        }
         m.unlock();
 
     }
 
+    bool threadInit()
+    {
+        vMetrics::get().registerThread("collectorPort");
+        return true;
+    }
+
     /// \brief on each call of the thread, all events that have been added are
     /// sent on the port in a vBottle. If no events have been added, a vBottle
     /// is not sent.
@@ -72,6 +84,7 @@ public:
             b = filler;
             filler.clear();
             sendPort.setEnvelope(ystamp);
+            stamped = false;
             m.unlock();
 
             sendPort.write();
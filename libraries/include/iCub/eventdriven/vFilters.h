@@ -19,94 +19,358 @@
 #ifndef __VFILTER__
 #define __VFILTER__
 
-#include <yarp/sig/Image.h>
+#include "iCub/eventdriven/vCodec.h"
+#include "iCub/eventdriven/vMerge.h"
+#include <vector>
+#include <string>
+#include <cstdint>
 
 namespace ev {
 
-/// \brief an efficient event-based salt and pepper filter
+/// \brief an efficient event-based salt and pepper filter. The timestamps of
+/// both channels and polarities are kept in a single padded plane, in which
+/// each image row is followed by the same row of the other three
+/// (channel, polarity) pairs, so the neighbourhood of an event is read from
+/// contiguous memory. Timestamps are stored unwrapped relative to an epoch
+/// and the neighbourhood test is branch-free so it can be vectorised.
+///
+/// Each channel can use a different kernel:
+/// BACKGROUND_ACTIVITY keeps an event if a neighbour of the same polarity
+/// fired within Tsize (and the pixel itself did not), REFRACTORY drops an
+/// event if the pixel fired within Tsize, HOT_PIXEL only drops the events
+/// of masked pixels and NONE keeps everything.
 class vNoiseFilter
 {
+public:
+
+    enum kernel { BACKGROUND_ACTIVITY = 0, REFRACTORY = 1, HOT_PIXEL = 2,
+                  NONE = 3 };
+
 private:
 
-    int Tsize;
+    static const uint32_t epoch_step = 1u << 30;
+
+    unsigned int Tsize;
     int Ssize;
+    int width;
+    int height;
+    int pw;
+    kernel kernels[2];
+
+    //[y][channel][polarity][x] with Ssize padding around the image
+    std::vector<uint32_t> plane;
+    std::vector<uint8_t> hot;
+
+    //unwrapped time of the latest event, and the unwrapped time stored as 0
+    int64_t reference;
+    int64_t epoch;
+    bool referenced;
+
+    size_t index(int x, int y, int c, int pol) const
+    {
+        return ((size_t)(y + Ssize) * 4 + c * 2 + pol) * pw + x + Ssize;
+    }
+
+    /// \brief the plane time of a stamp
+    uint32_t timeOf(int ts)
+    {
+        if(!referenced) {
+            reference = ts;
+            epoch = reference - epoch_step;
+            referenced = true;
+        }
+        int64_t key = vMerge::unwrap(ts, reference);
+        if(key > reference) reference = key;
+        //keep plane times below 2^31 by moving the epoch
+        while(key - epoch >= 3 * (int64_t)epoch_step) {
+            for(size_t i = 0; i < plane.size(); i++)
+                plane[i] = plane[i] > epoch_step ? plane[i] - epoch_step : 0;
+            epoch += epoch_step;
+        }
+        return key > epoch ? (uint32_t)(key - epoch) : 0;
+    }
 
-    yarp::sig::ImageOf <yarp::sig::PixelInt> TSleftL;
-    yarp::sig::ImageOf <yarp::sig::PixelInt> TSleftH;
-    yarp::sig::ImageOf <yarp::sig::PixelInt> TSrightL;
-    yarp::sig::ImageOf <yarp::sig::PixelInt> TSrightH;
+    /// \brief true if a neighbour fired within Tsize (but not at now)
+    bool support(const uint32_t *centre, uint32_t now) const
+    {
+        const uint32_t t = Tsize - 1;
+        const int n = 2 * Ssize + 1;
+        const uint32_t *row = centre - Ssize * 4 * pw - Ssize;
+        for(int r = 0; r < n; r++, row += 4 * pw) {
+            unsigned int hits = 0;
+            for(int i = 0; i < n; i++)
+                hits |= (uint32_t)(now - row[i] - 1) < t;
+            if(hits) return true;
+        }
+        return false;
+    }
 
 public:
 
     /// \brief constructor
-    vNoiseFilter() : Tsize(0), Ssize(0) {}
+    vNoiseFilter() : Tsize(1), Ssize(0), width(0), height(0), pw(0),
+        reference(0), epoch(0), referenced(false)
+    {
+        kernels[0] = kernels[1] = BACKGROUND_ACTIVITY;
+    }
 
     /// \brief initialise the sensor size and the filter parameters.
     void initialise(double width, double height, int Tsize, unsigned int Ssize)
     {
-        TSleftL.resize(width + 2 * Ssize, height + 2 * Ssize);
-        TSleftH.resize(width + 2 * Ssize, height + 2 * Ssize);
-        TSrightL.resize(width + 2 * Ssize, height + 2 * Ssize);
-        TSrightH.resize(width + 2 * Ssize, height + 2 * Ssize);
+        this->width = width;
+        this->height = height;
+        this->Tsize = Tsize > 1 ? Tsize : 1;
+        this->Ssize = Ssize;
+        pw = this->width + 2 * Ssize;
+        plane.assign((size_t)pw * (this->height + 2 * Ssize) * 4, 0);
+        hot.assign(plane.size(), 0);
+        referenced = false;
+    }
 
-        TSleftL.zero();
-        TSleftH.zero();
-        TSrightL.zero();
-        TSrightH.zero();
+    /// \brief select the kernel of a channel (0 or 1)
+    void setKernel(int channel, kernel k)
+    {
+        if(channel == 0 || channel == 1)
+            kernels[channel] = k;
+    }
 
-        this->Tsize = Tsize;
-        this->Ssize = Ssize;
+    /// \brief the kernel of a name (ba, refractory, hotpixel or none)
+    static bool kernelOf(std::string name, kernel &k)
+    {
+        if(name == "ba" || name == "background")
+            k = BACKGROUND_ACTIVITY;
+        else if(name == "refractory")
+            k = REFRACTORY;
+        else if(name == "hotpixel")
+            k = HOT_PIXEL;
+        else if(name == "none")
+            k = NONE;
+        else
+            return false;
+        return true;
+    }
+
+    /// \brief mask (or unmask) both polarities of a pixel for the HOT_PIXEL
+    /// kernel
+    void setHotPixel(int x, int y, int channel, bool masked = true)
+    {
+        if(x < 0 || x >= width || y < 0 || y >= height ||
+                channel < 0 || channel > 1)
+            return;
+        hot[index(x, y, channel, 0)] = masked;
+        hot[index(x, y, channel, 1)] = masked;
     }
 
     /// \brief classifies the event as noise or signal
     /// \returns false if the event is noise
     bool check(int x, int y, int p, int c, int ts)
     {
-        if(!Ssize) return false;
-
-        yarp::sig::ImageOf<yarp::sig::PixelInt> *active = 0;
-        if(c == 0) {
-            if(p == 0) {
-                active = &TSleftL;
-            } else if(p == 1) {
-                active = &TSleftH;
-            }
-        } else if(c == 1) {
-            if(p == 0) {
-                active = &TSrightL;
-            } else if(p == 1) {
-                active = &TSrightH;
-            }
+        if(c < 0 || c > 1 || p < 0 || p > 1 || plane.empty()) return false;
+
+        size_t i = index(x, y, c, p);
+        uint32_t *centre = plane.data() + i;
+        switch(kernels[c]) {
+        case NONE:
+            return true;
+        case HOT_PIXEL:
+            return !hot[i];
+        case REFRACTORY: {
+            uint32_t now = timeOf(ts);
+            if(now - *centre < Tsize) return false;
+            *centre = now;
+            return true;
+        }
+        default: {
+            uint32_t now = timeOf(ts);
+            if(now - *centre < Tsize) return false;
+            *centre = now;
+            return Ssize && support(centre, now);
+        }
+        }
+    }
+
+    /// \brief remove the noise from a container of address events
+    /// \returns the number of events removed
+    template <typename C> unsigned int filter(C &q)
+    {
+        size_t k = 0;
+        for(size_t i = 0; i < q.size(); i++) {
+            if(!check(q[i].x, q[i].y, q[i].polarity, q[i].channel, q[i].stamp))
+                continue;
+            if(k != i) q[k] = q[i];
+            k++;
+        }
+        unsigned int removed = q.size() - k;
+        q.resize(k);
+        return removed;
+    }
+
+    /// \brief remove the noise from (stamp, address) word pairs in place,
+    /// given a decoder of a pair into x, y, polarity, channel and stamp
+    /// \returns the number of events kept
+    template <typename D> unsigned int filter(int32_t *words,
+                                              unsigned int n_events, D decode)
+    {
+        unsigned int k = 0;
+        int x, y, p, c, ts;
+        for(unsigned int i = 0; i < n_events; i++) {
+            decode(words + 2 * i, x, y, p, c, ts);
+            if(!check(x, y, p, c, ts))
+                continue;
+            words[2 * k] = words[2 * i];
+            words[2 * k + 1] = words[2 * i + 1];
+            k++;
         }
-        if(!active) return false;
-
-        x += Ssize;
-        y += Ssize;
-
-        bool add = false;
-
-        int dt = ts - (*active)(x, y);
-        if(dt < 0)
-            dt += vtsHelper::max_stamp;
-        if(dt < Tsize)
-            return add;
-
-        (*active)(x, y) = ts;
-        for(int xi = x - Ssize; xi <= x + Ssize; xi++) {
-            for(int yi = y - Ssize; yi <= y + Ssize; yi++) {
-                int dt = ts - (*active)(xi, yi);
-                if(dt < 0) {
-                    dt += vtsHelper::max_stamp;
-                    (*active)(xi, yi) -= vtsHelper::max_stamp;
-                }
-                if(dt && dt < Tsize) {
-                    add = true;
-                    break;
-                }
-            }
+        return k;
+    }
+
+};
+
+/// \brief reduces the resolution of an event stream by a power of two. The
+/// events of each block of factor x factor pixels drive one output pixel
+/// for each channel and polarity, and an event is output (at the block
+/// coordinates, with the stamp and polarity of the event that caused it)
+/// when the output pixel fires:
+/// INTEGRATE accumulates the events in a potential that leaks by one every
+/// leak ticks, and fires (and resets) when it reaches the threshold.
+/// REFRACTORY fires on an event unless the pixel fired within refractory
+/// ticks.
+/// In both cases the output rate is at most that of the input, and for
+/// dense regions it falls with the square of the factor.
+class vDownsample
+{
+public:
+
+    enum mode { INTEGRATE = 0, REFRACTORY = 1 };
+
+private:
+
+    struct cell {
+        int64_t last;
+        float potential;
+    };
+
+    int shift;
+    int width;
+    int height;
+    mode type;
+    float threshold;
+    double leak;
+    int64_t refractory;
+    std::vector<cell> cells;
+
+    int64_t reference;
+    bool referenced;
+
+public:
+
+    /// \brief constructor
+    vDownsample() : shift(1), width(0), height(0), type(INTEGRATE),
+        threshold(2), leak(1), refractory(0), reference(0), referenced(false)
+    {}
+
+    /// \brief initialise the input sensor size and the factor (2, 4, 8 ...)
+    /// \returns false if the factor is not a power of two
+    bool initialise(int width, int height, int factor)
+    {
+        shift = 0;
+        while((1 << shift) < factor) shift++;
+        if(factor < 1 || (1 << shift) != factor) return false;
+        this->width = (width + factor - 1) >> shift;
+        this->height = (height + factor - 1) >> shift;
+        cell empty = {0, 0.0f};
+        cells.assign((size_t)this->width * this->height * 4, empty);
+        referenced = false;
+        return true;
+    }
+
+    /// \brief integrate-and-fire with a threshold (in events) and a leak of
+    /// one event every leak ticks
+    void setIntegrate(float threshold, unsigned int leak)
+    {
+        type = INTEGRATE;
+        this->threshold = threshold > 1 ? threshold : 1;
+        this->leak = leak ? leak : 1;
+    }
+
+    /// \brief fire at most once every refractory ticks
+    void setRefractory(unsigned int refractory)
+    {
+        type = REFRACTORY;
+        this->refractory = refractory;
+    }
+
+    /// \brief the output resolution
+    int outputWidth() const { return width; }
+    int outputHeight() const { return height; }
+
+    /// \brief the mode of a name (integrate or refractory)
+    static bool modeOf(std::string name, mode &m)
+    {
+        if(name == "integrate" || name == "lif")
+            m = INTEGRATE;
+        else if(name == "refractory")
+            m = REFRACTORY;
+        else
+            return false;
+        return true;
+    }
+
+    /// \brief update the output pixel of an event, converting x and y to
+    /// the output coordinates
+    /// \returns true if the output pixel fires
+    bool check(int &x, int &y, int p, int c, int ts)
+    {
+        x >>= shift;
+        y >>= shift;
+        if(x < 0 || x >= width || y < 0 || y >= height ||
+                c < 0 || c > 1 || p < 0 || p > 1)
+            return false;
+
+        if(!referenced) {
+            reference = ts;
+            referenced = true;
         }
+        int64_t now = vMerge::unwrap(ts, reference);
+        if(now > reference) reference = now;
 
-        return add;
+        cell &n = cells[(((size_t)y * width + x) * 2 + c) * 2 + p];
+        if(type == REFRACTORY) {
+            if(n.potential && now - n.last < refractory) return false;
+            n.potential = 1;
+            n.last = now;
+            return true;
+        }
+
+        if(now > n.last) {
+            n.potential -= (now - n.last) / leak;
+            if(n.potential < 0) n.potential = 0;
+        }
+        n.last = now;
+        n.potential += 1;
+        if(n.potential < threshold) return false;
+        n.potential = 0;
+        return true;
+    }
+
+    /// \brief downsample a container of address events in place
+    /// \returns the number of events removed
+    template <typename C> unsigned int filter(C &q)
+    {
+        size_t k = 0;
+        int x, y;
+        for(size_t i = 0; i < q.size(); i++) {
+            x = q[i].x; y = q[i].y;
+            if(!check(x, y, q[i].polarity, q[i].channel, q[i].stamp))
+                continue;
+            if(k != i) q[k] = q[i];
+            q[k].x = x;
+            q[k].y = y;
+            k++;
+        }
+        unsigned int removed = q.size() - k;
+        q.resize(k);
+        return removed;
     }
 
 };
@@ -0,0 +1,151 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VMERGE__
+#define __VMERGE__
+
+#include "iCub/eventdriven/vCodec.h"
+#include "iCub/eventdriven/vtsHelper.h"
+#include <vector>
+#include <cstdint>
+
+namespace ev {
+
+/// \brief puts events from several sources (e.g. left, right and skin
+/// packets, or the packets of several ports) into temporal order. Each
+/// timestamp is unwrapped once into a 64-bit key, the ordered runs of keys are
+/// merged in O(n log k), and batches with too many runs to merge efficiently
+/// fall back to a radix sort that can use several threads.
+class vMerge
+{
+private:
+
+    //the key of the last event merged, to unwrap the following batch
+    int64_t reference;
+    bool referenced;
+    unsigned int threads;
+
+    std::vector<int64_t> keys;
+    std::vector<size_t> runs;
+    std::vector<uint32_t> order;
+
+    static unsigned int stampOf(const event<> &v) { return v->stamp; }
+    template <typename T> static unsigned int stampOf(const T &v) { return v.stamp; }
+
+    /// \brief add the key of the next event, starting a new run if it is
+    /// earlier than the previous key
+    void push(int64_t key)
+    {
+        if(keys.size() && key < keys.back())
+            runs.push_back(keys.size());
+        keys.push_back(key);
+    }
+
+    /// \brief compute order from keys and runs
+    void computeOrder();
+
+public:
+
+    /// \brief threads used by the radix sort of large unordered batches
+    vMerge(unsigned int threads = 1);
+
+    /// \brief forget the time of the previous merge (e.g. after a reset of
+    /// the sensor clock)
+    void reset() { referenced = false; }
+
+    /// \brief the key of a stamp that is within half a wrap of a reference key
+    static int64_t unwrap(unsigned int stamp, int64_t reference)
+    {
+        int64_t d = ((int64_t)stamp - reference) & (int64_t)vtsHelper::max_stamp;
+        if(d > (int64_t)(vtsHelper::max_stamp >> 1))
+            d -= (int64_t)vtsHelper::max_stamp + 1;
+        return reference + d;
+    }
+
+    /// \brief the order of keys given the first index of each ordered run
+    static void mergeOrder(const std::vector<int64_t> &keys,
+                           const std::vector<size_t> &runs,
+                           std::vector<uint32_t> &order);
+
+    /// \brief the (stable) order of keys using a least-significant-digit radix
+    /// sort
+    static void radixOrder(const std::vector<int64_t> &keys,
+                           std::vector<uint32_t> &order,
+                           unsigned int threads = 1);
+
+    /// \brief append the events of sources to out in temporal order. The
+    /// events of a source are expected to be mostly in order, and within half
+    /// a wrap of the previous call.
+    template <typename C> void merge(const std::vector<const C *> &sources,
+                                     C &out)
+    {
+        keys.clear();
+        runs.assign(1, 0);
+        std::vector<const typename C::value_type *> events;
+
+        for(size_t s = 0; s < sources.size(); s++) {
+            int64_t key = reference;
+            for(size_t i = 0; i < sources[s]->size(); i++) {
+                const typename C::value_type &v = (*sources[s])[i];
+                if(!referenced) {
+                    reference = key = stampOf(v);
+                    referenced = true;
+                }
+                key = unwrap(stampOf(v), key);
+                push(key);
+                events.push_back(&v);
+            }
+        }
+        if(keys.empty()) return;
+
+        computeOrder();
+        for(size_t i = 0; i < order.size(); i++)
+            out.push_back(*events[order[i]]);
+
+        reference = keys[order.back()];
+    }
+
+    /// \brief put a container of events in temporal order. If respectWraps
+    /// the events are expected to be within half a wrap of the first event.
+    template <typename C> void sort(C &q, bool respectWraps = true)
+    {
+        if(q.size() < 2) return;
+
+        keys.clear();
+        runs.assign(1, 0);
+        int64_t first = stampOf(q.front());
+        for(size_t i = 0; i < q.size(); i++) {
+            if(respectWraps)
+                push(unwrap(stampOf(q[i]), first));
+            else
+                push(stampOf(q[i]));
+        }
+        if(runs.size() == 1) return;
+
+        computeOrder();
+        C sorted;
+        for(size_t i = 0; i < order.size(); i++)
+            sorted.push_back(q[order[i]]);
+        q.swap(sorted);
+    }
+
+};
+
+}
+
+#endif
@@ -0,0 +1,224 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VMETRICS__
+#define __VMETRICS__
+
+#include <yarp/os/all.h>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ev {
+
+/// \brief a count that only increases (e.g. events received)
+class vCounter
+{
+private:
+    std::atomic<uint64_t> n;
+
+public:
+    vCounter() : n(0) {}
+    void add(uint64_t v = 1) { n.fetch_add(v, std::memory_order_relaxed); }
+    uint64_t value() const { return n.load(std::memory_order_relaxed); }
+};
+
+/// \brief a value that can go up and down (e.g. the depth of a queue)
+class vGauge
+{
+private:
+    std::atomic<double> v;
+
+public:
+    vGauge() : v(0) {}
+    void set(double value) { v.store(value, std::memory_order_relaxed); }
+    double value() const { return v.load(std::memory_order_relaxed); }
+};
+
+/// \brief a log-linear (HDR) histogram of non-negative integers. Each power
+/// of two is split into 16 buckets, so a recorded value is known to within
+/// 1/16 (6%) at any scale, with a fixed number of buckets and no allocation
+/// when recording.
+class vHistogram
+{
+public:
+
+    static const int sub_bits = 4;
+    static const int sub_count = 1 << sub_bits;
+    static const int n_buckets = 2 * sub_count + (63 - sub_bits) * sub_count;
+
+private:
+
+    std::atomic<uint64_t> buckets[n_buckets];
+    std::atomic<uint64_t> n;
+    std::atomic<uint64_t> total;
+    double scale;
+
+public:
+
+    /// \brief values are multiplied by scale when reported (e.g. 1e-6 to
+    /// record microseconds and report seconds)
+    vHistogram(double scale = 1.0) : n(0), total(0), scale(scale)
+    {
+        for(int b = 0; b < n_buckets; b++)
+            buckets[b] = 0;
+    }
+
+    static int bucketOf(uint64_t value)
+    {
+        if(value < 2 * sub_count) return value;
+        int msb = 63 - __builtin_clzll(value);
+        int shift = msb - sub_bits;
+        return 2 * sub_count + (shift - 1) * sub_count +
+                (int)((value >> shift) - sub_count);
+    }
+
+    /// \brief the largest value recorded in a bucket
+    static uint64_t upperOf(int bucket)
+    {
+        if(bucket < 2 * sub_count) return bucket;
+        int shift = (bucket - 2 * sub_count) / sub_count + 1;
+        uint64_t mantissa = (bucket - 2 * sub_count) % sub_count + sub_count;
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+    void record(uint64_t value)
+    {
+        buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+        n.fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const { return n.load(std::memory_order_relaxed); }
+    double sum() const { return total.load(std::memory_order_relaxed) * scale; }
+
+    /// \brief the value (scaled) below which a fraction q of the records fall
+    double quantile(double q) const;
+
+};
+
+/// \brief the counters, gauges and histograms of a process. Each metric has a
+/// name (e.g. ev_port_events_total) and a label set (e.g. port="/vPreProcess/AE:i")
+/// and is created the first time it is asked for; the references returned stay
+/// valid for the life of the process, so the hot path only touches atomics.
+///
+/// The metrics can be dumped in the Prometheus text format to a file, or
+/// read from an rpc port ("metrics" for all of them, "get <name>" for one,
+/// "save <file>" to write a file in the working directory of the process,
+/// "profile" for the vProfiler report). The
+/// port is opened by serve(), or automatically next to the first
+/// vReadPort/vWritePort of the process when the environment variable
+/// EV_METRICS (or EV_PROFILE) is set; EV_METRICS is then also a file name
+/// prefix the metrics are saved to by close().
+///
+/// close() must be called while the yarp Network exists (e.g. from the
+/// close() of the module): a module that serve()s calls it itself, and the
+/// automatic port is closed with the last vReadPort/vWritePort of the process.
+class vMetrics : public yarp::os::PortReader
+{
+private:
+
+    enum kind { COUNTER, GAUGE, HISTOGRAM };
+
+    struct family {
+        kind type;
+        std::string help;
+        std::map<std::string, std::unique_ptr<vCounter> > counters;
+        std::map<std::string, std::unique_ptr<vGauge> > gauges;
+        std::map<std::string, std::unique_ptr<vHistogram> > histograms;
+    };
+
+    yarp::os::Mutex m;
+    std::map<std::string, family> families;
+    std::map<long, std::string> threads;
+
+    yarp::os::Port rpc;
+    bool serving;
+    bool automatic;
+    int users;
+    std::string filename;
+
+    vMetrics();
+    family &familyOf(const std::string &name, const std::string &help,
+                     kind type);
+    void dumpThreads(std::ostream &oss);
+    std::string saveLocal(std::string name);
+
+public:
+
+    ~vMetrics();
+
+    /// \brief the metrics of this process
+    static vMetrics &get();
+
+    vCounter &counter(std::string name, std::string help,
+                      std::string labels = "");
+    vGauge &gauge(std::string name, std::string help,
+                  std::string labels = "");
+    vHistogram &histogram(std::string name, std::string help,
+                          std::string labels = "", double scale = 1.0);
+
+    /// \brief report the cpu time of the calling thread as
+    /// ev_thread_cpu_seconds_total{thread="name"} (linux only). Threads
+    /// registered with the same name are numbered name#1, name#2 ...
+    void registerThread(std::string name);
+
+    /// \brief the cpu time (s) used by the process, also reported as
+    /// process_cpu_seconds_total (linux only, -1 elsewhere)
+    double cpuSeconds();
+
+    /// \brief open an rpc port to query the metrics
+    bool serve(std::string portname);
+
+    /// \brief serve() on moduleName/metrics:rpc if EV_METRICS is set and
+    /// no port is open yet. portname is the name of any port of the module.
+    void serveFrom(std::string portname);
+
+    /// \brief a port that called serveFrom() closed. The last one to close
+    /// calls close().
+    void release();
+
+    /// \brief save the metrics to the EV_METRICS file (once) and close the
+    /// rpc port
+    void close();
+
+    /// \brief the metrics (whose name starts with prefix) in the Prometheus
+    /// text format
+    std::string dump(std::string prefix = "");
+
+    /// \brief write dump() to a file
+    bool save(std::string filename);
+
+    /// \brief the rpc handler
+    bool read(yarp::os::ConnectionReader &connection);
+
+};
+
+/// \brief the label set of a port
+inline std::string portLabel(const std::string &portname)
+{
+    return "port=\"" + portname + "\"";
+}
+
+}
+
+#endif
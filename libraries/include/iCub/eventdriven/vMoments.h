@@ -0,0 +1,267 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VMOMENTS__
+#define __VMOMENTS__
+
+#include "iCub/eventdriven/vCodec.h"
+#include "iCub/eventdriven/vMerge.h"
+#include <deque>
+#include <vector>
+#include <cstdint>
+
+namespace ev {
+
+/// \brief the zeroth, first and second order moments of a set of pixels.
+/// Pixels can be added and removed in O(1), and the sums are kept as integers
+/// so removing a pixel exactly undoes adding it, however long the stream.
+class vMoments
+{
+private:
+
+    int64_t n;
+    int64_t sx, sy;
+    int64_t sxx, sxy, syy;
+
+public:
+
+    vMoments() { clear(); }
+
+    void clear() { n = sx = sy = sxx = sxy = syy = 0; }
+
+    void add(int x, int y)
+    {
+        n++; sx += x; sy += y;
+        sxx += (int64_t)x * x; sxy += (int64_t)x * y; syy += (int64_t)y * y;
+    }
+
+    void remove(int x, int y)
+    {
+        n--; sx -= x; sy -= y;
+        sxx -= (int64_t)x * x; sxy -= (int64_t)x * y; syy -= (int64_t)y * y;
+    }
+
+    /// \brief add the moments of another set of pixels
+    void add(const vMoments &other)
+    {
+        n += other.n; sx += other.sx; sy += other.sy;
+        sxx += other.sxx; sxy += other.sxy; syy += other.syy;
+    }
+
+    int64_t count() const { return n; }
+
+    /// \brief the centroid of the pixels
+    /// \returns false if there are no pixels
+    bool centroid(double &x, double &y) const
+    {
+        if(!n) return false;
+        x = (double)sx / n;
+        y = (double)sy / n;
+        return true;
+    }
+
+    /// \brief the (population) covariance of the pixels
+    /// \returns false if there are no pixels
+    bool covariance(double &xx, double &xy, double &yy) const
+    {
+        if(!n) return false;
+        //n * sum(x^2) - sum(x)^2 is exact in integers
+        double n2 = (double)n * n;
+        xx = (double)(n * sxx - sx * sx) / n2;
+        xy = (double)(n * sxy - sx * sy) / n2;
+        yy = (double)(n * syy - sy * sy) / n2;
+        return true;
+    }
+
+};
+
+/// \brief the moments of the most recent events of each group (e.g. channel)
+/// over a sliding window, either of a fixed time or of a fixed number of
+/// events per group. Adding an event updates the moments of its group and
+/// removes the events that fall out of the window, so the centroid,
+/// covariance and event rate of a group can be queried at any time in O(1)
+/// without scanning the window. An optional ROI ignores the events outside
+/// of it.
+class vMomentWindow
+{
+public:
+
+    enum mode { TIME, COUNT };
+
+private:
+
+    struct sample {
+        int64_t key;
+        int16_t x;
+        int16_t y;
+    };
+
+    struct group {
+        vMoments moments;
+        std::deque<sample> samples;
+    };
+
+    std::vector<group> groups;
+    mode type;
+    unsigned int size;
+
+    int xl, xh, yl, yh;
+
+    //unwrapped time of the latest event
+    int64_t reference;
+    bool referenced;
+
+    static int xOf(const event<> &v) { return read_as<AE>(v)->x; }
+    static int yOf(const event<> &v) { return read_as<AE>(v)->y; }
+    static int cOf(const event<> &v) { return read_as<AE>(v)->channel; }
+    static unsigned int tOf(const event<> &v) { return v->stamp; }
+    template <typename T> static int xOf(const T &v) { return v.x; }
+    template <typename T> static int yOf(const T &v) { return v.y; }
+    template <typename T> static int cOf(const T &v) { return v.channel; }
+    template <typename T> static unsigned int tOf(const T &v) { return v.stamp; }
+
+    void expire(group &g)
+    {
+        if(type == TIME) {
+            while(g.samples.size() &&
+                  reference - g.samples.front().key >= (int64_t)size) {
+                g.moments.remove(g.samples.front().x, g.samples.front().y);
+                g.samples.pop_front();
+            }
+        } else {
+            while(g.samples.size() > size) {
+                g.moments.remove(g.samples.front().x, g.samples.front().y);
+                g.samples.pop_front();
+            }
+        }
+    }
+
+public:
+
+    /// \brief constructor with the number of groups (e.g. 2 channels)
+    vMomentWindow(unsigned int n_groups = 2) :
+        groups(n_groups), type(TIME), size(vtsHelper::vtsscaler * 0.1),
+        xl(0), xh(-1), yl(0), yh(-1), reference(0), referenced(false) {}
+
+    /// \brief keep the events of the last ticks (event timestamp units)
+    void setTimeWindow(unsigned int ticks)
+    {
+        type = TIME;
+        size = ticks;
+        for(size_t i = 0; i < groups.size(); i++) expire(groups[i]);
+    }
+
+    /// \brief keep the last n events of each group
+    void setCountWindow(unsigned int n)
+    {
+        type = COUNT;
+        size = n;
+        for(size_t i = 0; i < groups.size(); i++) expire(groups[i]);
+    }
+
+    /// \brief only accept events within the (inclusive) bounds
+    void setROI(int xl, int xh, int yl, int yh)
+    {
+        this->xl = xl; this->xh = xh; this->yl = yl; this->yh = yh;
+    }
+
+    void clearROI() { xl = 0; xh = -1; yl = 0; yh = -1; }
+
+    void clear()
+    {
+        for(size_t i = 0; i < groups.size(); i++) {
+            groups[i].moments.clear();
+            groups[i].samples.clear();
+        }
+        referenced = false;
+    }
+
+    /// \brief add an event to a group
+    /// \returns false if the event is outside the ROI or of an unknown group
+    bool add(int x, int y, int g, unsigned int stamp)
+    {
+        if(g < 0 || g >= (int)groups.size()) return false;
+        if(xh >= xl && (x < xl || x > xh || y < yl || y > yh)) return false;
+
+        if(!referenced) {
+            reference = stamp;
+            referenced = true;
+        }
+        int64_t key = vMerge::unwrap(stamp, reference);
+        if(key > reference) reference = key;
+
+        group &gr = groups[g];
+        sample s = {key, (int16_t)x, (int16_t)y};
+        gr.samples.push_back(s);
+        gr.moments.add(x, y);
+        expire(gr);
+        if(type == TIME)
+            for(size_t i = 0; i < groups.size(); i++)
+                if((int)i != g) expire(groups[i]);
+        return true;
+    }
+
+    /// \brief add a container of address events (using their channel as the
+    /// group)
+    /// \returns the number of events added
+    template <typename C> unsigned int add(const C &q)
+    {
+        unsigned int added = 0;
+        for(typename C::const_iterator i = q.begin(); i != q.end(); i++)
+            added += add(xOf(*i), yOf(*i), cOf(*i), tOf(*i));
+        return added;
+    }
+
+    /// \brief move the time window on to a stamp without adding an event
+    void advance(unsigned int stamp)
+    {
+        if(!referenced || type != TIME) return;
+        int64_t key = vMerge::unwrap(stamp, reference);
+        if(key <= reference) return;
+        reference = key;
+        for(size_t i = 0; i < groups.size(); i++) expire(groups[i]);
+    }
+
+    /// \brief the moments of the events in the window of a group
+    const vMoments &moments(int g = 0) const { return groups[g].moments; }
+
+    /// \brief the moments of all groups together
+    vMoments total() const
+    {
+        vMoments m;
+        for(size_t i = 0; i < groups.size(); i++) m.add(groups[i].moments);
+        return m;
+    }
+
+    /// \brief the event rate (events/s) of a group over the window, or over
+    /// the events received if the window is not yet full
+    double rate(int g = 0) const
+    {
+        const std::deque<sample> &s = groups[g].samples;
+        if(s.size() < 2) return 0.0;
+        int64_t span = type == TIME ? reference - s.front().key
+                                    : s.back().key - s.front().key;
+        if(span <= 0) return 0.0;
+        return (s.size() - 1) / (span * vtsHelper::tsscaler);
+    }
+
+};
+
+}
+
+#endif
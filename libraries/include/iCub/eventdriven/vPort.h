@@ -23,6 +23,9 @@
 #include <yarp/os/all.h>
 #include "iCub/eventdriven/vCodec.h"
 #include "iCub/eventdriven/vtsHelper.h"
+#include "iCub/eventdriven/vSharedRing.h"
+#include "iCub/eventdriven/vTrace.h"
+#include "iCub/eventdriven/vMetrics.h"
 
 using namespace yarp::os;
 using std::vector;
@@ -67,6 +70,11 @@ public:
         elementBYTES = sizeof(int32_t) * elementINTS;
     }
 
+    /// \brief the number of events in the packet to write
+    unsigned int packetEvents() const {
+        return elementINTS ? header3[1] / elementINTS : header3[1];
+    }
+
     /// \brief set the type of event that this vBottleMimic will send
     void setHeader(std::string eventtype) {
         header1[3] = eventtype.size();  //set the string length
@@ -194,6 +202,23 @@ public:
         return true;
     }
 
+    /// \brief copy the data into a shared memory ring instead of a connection
+    bool writeShared(vSharedRing &ring, const Stamp &envelope) const
+    {
+        return ring.write(header2, datablock, datalength, envelope);
+    }
+
+    /// \brief block until the next packet is available in a shared memory
+    /// ring and read it as if it had arrived on a connection.
+    bool readShared(vSharedRing &ring, Stamp &envelope)
+    {
+        unsigned int n_ints = 0;
+        if(!ring.read(event_type, internaldata, n_ints, envelope))
+            return false;
+        ints_to_read = n_ints;
+        return true;
+    }
+
     bool decodePacket(vQueue &read_q)
     {
         int event_size = packetSize(event_type);
@@ -253,26 +278,73 @@ protected:
 
     vPortableInterface internal_storage;
     Port port;
+    vSharedRing shared;
+    int trace_stage;
+    bool registered;
+    vCounter *events_out;
+    vCounter *packets_out;
+    vCounter *failed_out;
 
     bool _internal_write(Stamp &envelope)
     {
-        if(!port.setEnvelope(envelope))
-            return false;
-        if(!port.write(internal_storage))
+        int n = internal_storage.packetEvents();
+        vTracer::get().trace(trace_stage, vTracer::WRITTEN, envelope, n, 0);
+        if(events_out) {
+            events_out->add(n);
+            packets_out->add();
+        }
+        if(shared.isOpen()) {
+            if(!internal_storage.writeShared(shared, envelope))
+                return false;
+            //only serialise if there are also network connections
+            if(!port.getOutputCount())
+                return true;
+        }
+        if(!port.setEnvelope(envelope) || !port.write(internal_storage)) {
+            if(failed_out) failed_out->add();
             return false;
+        }
         return true;
     }
 
 public:
 
+    vWritePort() : trace_stage(-1), registered(false), events_out(nullptr),
+        packets_out(nullptr), failed_out(nullptr) {}
+
     bool open(std::string name)
     {
+        registered = true;
+        trace_stage = vTracer::get().stage(name);
+        vMetrics &metrics = vMetrics::get();
+        failed_out = &metrics.counter("ev_port_write_failures_total",
+                                      "packets that could not be written",
+                                      portLabel(name));
+        packets_out = &metrics.counter("ev_port_packets_out_total",
+                                       "packets written", portLabel(name));
+        events_out = &metrics.counter("ev_port_events_out_total",
+                                      "events written", portLabel(name));
+        metrics.serveFrom(name);
         return port.open(name);
     }
 
+    /// \brief also publish into a shared memory ring that local vReadPorts
+    /// can read from (see vReadPort::open). Call after open().
+    bool enableSharedMemory(unsigned int ring_bytes = 16777216)
+    {
+        return shared.create(port.getName(), ring_bytes);
+    }
+
     void close()
     {
         port.close();
+        shared.close();
+        if(registered) {
+            //the last port of the process saves the trace and the metrics
+            registered = false;
+            vTracer::get().release();
+            vMetrics::get().release();
+        }
     }
 
     void setWriteType(std::string tag)
@@ -318,6 +390,8 @@ protected:
 
     vPortableInterface internal_storage;
     Port port;
+    vSharedRing shared;
+    bool use_shared;
 
     deque< T* > qq;
     deque<Stamp> sq;
@@ -327,6 +401,15 @@ protected:
     Mutex read_mutex;
     Semaphore dataavailable;
 
+    int trace_stage;
+    bool registered;
+    std::string portname;
+    vCounter *events_in;
+    vCounter *packets_in;
+    vCounter *dropped_in;
+    vGauge *depth;
+    vHistogram *latency;
+
     unsigned int qlimit;
     unsigned int unprocdqs;
     unsigned int delay_nv;
@@ -345,6 +428,12 @@ public:
         event_rate = 0;
         unprocdqs = 0;
         working_queue = nullptr;
+        use_shared = false;
+        trace_stage = -1;
+        registered = false;
+        events_in = packets_in = dropped_in = nullptr;
+        depth = nullptr;
+        latency = nullptr;
 
         setPriority(99, SCHED_FIFO);
 
@@ -363,13 +452,38 @@ public:
     }
 
 
-    bool open(std::string name)
+    /// \brief open the input port. If shared_source is the name of a
+    /// vWritePort on the same host with shared memory enabled, data is read
+    /// from its shared memory ring instead of from network connections.
+    bool open(std::string name, std::string shared_source = "")
     {
         //port.setTimeout(1.0);
+        registered = true;
+        trace_stage = vTracer::get().stage(name);
+        portname = name;
+        vMetrics &metrics = vMetrics::get();
+        std::string label = portLabel(name);
+        events_in = &metrics.counter("ev_port_events_in_total",
+                                     "events received", label);
+        packets_in = &metrics.counter("ev_port_packets_in_total",
+                                      "packets received", label);
+        dropped_in = &metrics.counter("ev_port_packets_dropped_total",
+                                      "packets dropped by the queue limit", label);
+        depth = &metrics.gauge("ev_port_queue_depth",
+                               "packets received but not yet read", label);
+        latency = &metrics.histogram("ev_port_latency_seconds",
+                                     "time from the packet envelope to its read",
+                                     label, 1e-6);
+        metrics.serveFrom(name);
         if(!port.open(name)) {
             yError() << "Could not open vGenReadPort input port: " << name;
             return false;
         }
+        if(shared_source.size()) {
+            use_shared = true;
+            if(!shared.attach(shared_source))
+                yWarning() << "Waiting for shared memory of" << shared_source;
+        }
         start();
         return true;
     }
@@ -390,10 +504,16 @@ public:
     {
         this->stop(); //make sure the isStopping() is true
         port.close(); //close the port connections
+        if(registered) {
+            registered = false;
+            vTracer::get().release();
+            vMetrics::get().release();
+        }
     }
 
     void onStop()
     {
+        shared.interrupt(); //shared.read() will return false
         port.interrupt(); //port.read() will return false
         read_mutex.unlock(); //allow port.read() to be called
         dataavailable.post(); //all a this->read() to return
@@ -401,11 +521,19 @@ public:
 
     void run()
     {
+        vMetrics::get().registerThread(portname);
         while(true) {
 
             //blocking read of data from the port
+            yarp::os::Stamp yarp_stamp;
+            bool read_success;
             read_mutex.lock();
-            bool read_success = port.read(internal_storage);
+            if(use_shared) {
+                read_success = internal_storage.readShared(shared, yarp_stamp);
+            } else {
+                read_success = port.read(internal_storage);
+                port.getEnvelope(yarp_stamp);
+            }
             read_mutex.unlock();
 
             if(!read_success) {
@@ -414,11 +542,11 @@ public:
                 break;
             }
 
-            if(qlimit && qq.size() >= qlimit)
+            if(qlimit && qq.size() >= qlimit) {
+                dropped_in->add();
                 continue;
+            }
 
-            yarp::os::Stamp yarp_stamp;
-            port.getEnvelope(yarp_stamp);
             T *next_queue = new T;
             internal_storage.decodePacket(*next_queue);
 
@@ -437,6 +565,12 @@ public:
             if(q_time)
                 event_rate = q_events / (double)q_time;
 
+            vTracer::get().trace(trace_stage, vTracer::RECEIVED, yarp_stamp,
+                                 q_events, unprocdqs);
+            events_in->add(q_events);
+            packets_in->add();
+            depth->set(unprocdqs);
+
             m.unlock();
 
             dataavailable.post();
@@ -467,7 +601,14 @@ public:
             working_queue = qq.front();
             m.lock();
             unprocdqs--;
+            vTracer::get().trace(trace_stage, vTracer::READ, yarpstamp,
+                                 countEvents<T>(*working_queue), unprocdqs);
+            depth->set(unprocdqs);
             m.unlock();
+            if(yarpstamp.isValid()) {
+                double age = Time::now() - yarpstamp.getTime();
+                latency->record(age > 0 ? (uint64_t)(age * 1e6) : 0);
+            }
         }  else {
             working_queue =  0;
         }
@@ -514,11 +655,22 @@ public:
         return event_rate * vtsHelper::vtsscaler;
     }
 
+    /// \brief ask for the number of packets lost by a slow shared memory
+    /// reader since the last call.
+    unsigned int querySharedLoss()
+    {
+        return shared.queryLost();
+    }
+
+    /// \brief the queue state as a log line. The same values are in the
+    /// ev_port_* metrics of this port (see vMetrics).
     std::string delayStatString()
     {
         std::ostringstream oss;
         oss << "qs: " << queryunprocessed() << " events: " << queryDelayN() <<
                " time(s): " << queryDelayT() << " rate: " << queryRate();
+        if(use_shared)
+            oss << " shm lost: " << querySharedLoss();
         return oss.str();
     }
 
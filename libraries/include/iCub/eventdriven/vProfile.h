@@ -0,0 +1,212 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VPROFILE__
+#define __VPROFILE__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+
+namespace ev {
+
+/// \brief accounts where a process allocates and copies events. It counts
+/// the events allocated (make_event and clone) and the vQueue memory
+/// allocated, by type, with the lifetime of each allocation; the vQueues
+/// returned by value by the surfaces (getSurf, getSurface, queryWindow ...),
+/// by the function and the code that called it; and the events held by each
+/// surface.
+///
+/// Profiling is off unless the environment variable EV_PROFILE is set when
+/// the process starts, and then costs a few atomic adds per allocation. The
+/// report ranks the allocations by bytes and the copies by events copied. It
+/// is returned by the "profile" command of the metrics rpc port (see vMetrics,
+/// opened automatically when EV_PROFILE is set), and saved when the process
+/// exits to EV_PROFILE.<pid>.txt, unless EV_PROFILE is 1.
+class vProfiler
+{
+public:
+
+    /// \brief the allocations of one type of object
+    struct allocations {
+        std::string kind;
+        std::string type;
+        std::atomic<uint64_t> allocated;
+        std::atomic<uint64_t> freed;
+        std::atomic<uint64_t> bytes;
+        std::atomic<uint64_t> live_bytes;
+        //(sampled) lifetimes of 2^b to 2^(b+1) microseconds
+        std::atomic<uint64_t> lifetimes[32];
+    };
+
+    /// \brief the vQueue copies made by a function when called from one place
+    struct site {
+        std::string function;
+        void *caller;
+        std::atomic<uint64_t> calls;
+        std::atomic<uint64_t> events;
+    };
+
+    /// \brief the events held by a surface
+    struct surface {
+        std::string name;
+        std::atomic<uint64_t> events;
+        std::atomic<uint64_t> peak;
+        bool alive;
+    };
+
+    /// \brief true if EV_PROFILE was set when the process started
+    static bool enabled()
+    {
+        static const bool on = startup();
+        return on;
+    }
+
+    /// \brief the statistics of a type of object (e.g. "event", "AE")
+    static allocations &allocationsOf(const std::string &kind,
+                                      const std::string &type);
+
+    /// \brief record the allocation and release of bytes. allocated returns
+    /// the time of the allocation (in microseconds) for freed to measure its
+    /// lifetime, or 0 if the lifetime is not sampled.
+    static uint64_t allocated(allocations &a, size_t bytes);
+    static void freed(allocations &a, size_t bytes, uint64_t since);
+
+    /// \brief record a vQueue of n events copied by function for caller
+    static void copied(const char *function, void *caller, size_t n);
+
+    /// \brief a surface to report the events of (nullptr if not enabled)
+    static surface *surfaceOf(const std::string &name);
+    static void release(surface *s);
+
+    /// \brief record the number of events a surface holds
+    static void holds(surface *s, size_t n)
+    {
+        if(!s) return;
+        s->events.store(n, std::memory_order_relaxed);
+        if(n > s->peak.load(std::memory_order_relaxed))
+            s->peak.store(n, std::memory_order_relaxed);
+    }
+
+    /// \brief the ranked report of this process
+    static std::string report();
+
+    /// \brief write report() to a file
+    static bool save(std::string filename);
+
+private:
+
+    static bool startup();
+
+};
+
+/// \brief allocates through the vProfiler, as the allocations of K::kind()
+/// and K::type(), when profiling is enabled, and through std::allocator
+/// otherwise. Each allocation is preceded by its time so its lifetime is
+/// known when it is released.
+template <typename T, typename K>
+class vProfileAllocator
+{
+private:
+
+    static const size_t header = alignof(std::max_align_t) > sizeof(uint64_t) ?
+                alignof(std::max_align_t) : sizeof(uint64_t);
+
+    static vProfiler::allocations &stats()
+    {
+        static vProfiler::allocations &a =
+                vProfiler::allocationsOf(K::kind(), K::type());
+        return a;
+    }
+
+public:
+
+    typedef T value_type;
+    template <typename U> struct rebind { typedef vProfileAllocator<U, K> other; };
+
+    vProfileAllocator() {}
+    template <typename U> vProfileAllocator(const vProfileAllocator<U, K> &) {}
+
+    T *allocate(size_t n)
+    {
+        size_t bytes = n * sizeof(T);
+        if(!vProfiler::enabled())
+            return static_cast<T *>(::operator new(bytes));
+        char *p = static_cast<char *>(::operator new(bytes + header));
+        *reinterpret_cast<uint64_t *>(p) = vProfiler::allocated(stats(), bytes);
+        return reinterpret_cast<T *>(p + header);
+    }
+
+    void deallocate(T *p, size_t n)
+    {
+        if(!vProfiler::enabled()) {
+            ::operator delete(p);
+            return;
+        }
+        char *start = reinterpret_cast<char *>(p) - header;
+        vProfiler::freed(stats(), n * sizeof(T),
+                         *reinterpret_cast<uint64_t *>(start));
+        ::operator delete(start);
+    }
+
+    template <typename U> bool operator==(const vProfileAllocator<U, K> &) const
+    { return true; }
+    template <typename U> bool operator!=(const vProfileAllocator<U, K> &) const
+    { return false; }
+};
+
+/// \brief the vProfiler record of the events held by a surface. A copy of
+/// a surface is recorded separately, and the record is marked destroyed with
+/// the surface.
+class vProfileSurface
+{
+private:
+
+    const char *name;
+    vProfiler::surface *s;
+
+public:
+
+    vProfileSurface(const char *name) :
+        name(name), s(vProfiler::surfaceOf(name)) {}
+    vProfileSurface(const vProfileSurface &other) :
+        name(other.name), s(vProfiler::surfaceOf(other.name)) {}
+    vProfileSurface &operator=(const vProfileSurface &) { return *this; }
+    ~vProfileSurface() { vProfiler::release(s); }
+
+    void holds(size_t n) { vProfiler::holds(s, n); }
+};
+
+}
+
+/// \brief record the vQueue q returned by the calling function as a copy
+/// made for the code that called it. The caller is the return address of the
+/// function the macro expands in, so it is only the call site in the module
+/// when that function is compiled out of line (e.g. in vWindow_adv.cpp). In
+/// a function defined in a header (getEverything, staticSurface::getSurf, the
+/// vSurfaceHandlerTh queries) that the compiler inlines, it is the caller of
+/// the enclosing function instead: often the handler rather than the module,
+/// and different between builds. The function name is always right.
+#define EV_PROFILE_COPY(q) \
+    do { if(ev::vProfiler::enabled()) \
+        ev::vProfiler::copied(__func__, __builtin_return_address(0), (q).size()); \
+    } while(0)
+
+#endif
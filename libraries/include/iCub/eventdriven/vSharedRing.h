@@ -0,0 +1,97 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VSHAREDRING__
+#define __VSHAREDRING__
+
+#include <yarp/os/all.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace ev {
+
+struct sharedRingHeader;
+
+/// \brief a single-writer, multiple-reader ring of event packets in POSIX
+/// shared memory. The writer copies each packet into the ring once and any
+/// number of readers on the same host read it with their own cursor. A reader
+/// that falls more than a ring-length behind the writer detects the overrun,
+/// counts the lost packets and skips to the most recent packet. A reader
+/// whose writer exits without closing the ring (e.g. it crashed) detaches
+/// and waits for a new writer.
+class vSharedRing
+{
+private:
+
+    std::string shm_name;
+    bool owner;
+    int fd;
+    size_t mapped_bytes;
+    sharedRingHeader *header;
+    char *ring;
+
+    //reader state (last_seq is the packet counter for the writer)
+    uint64_t cursor;
+    uint64_t last_seq;
+    unsigned int lost;
+    std::atomic<bool> interrupted;
+
+    bool map(size_t bytes, bool create);
+    bool writerAlive() const;
+
+public:
+
+    /// \brief the shared memory name used for a port name
+    static std::string sharedName(std::string port_name);
+
+    vSharedRing();
+    ~vSharedRing();
+
+    /// \brief (writer) create the ring associated to a port name
+    bool create(std::string port_name, unsigned int capacity_bytes);
+    /// \brief (reader) attach to the ring created by the writer port. Reading
+    /// starts from the next packet written. If the writer does not exist yet
+    /// read() keeps trying to attach.
+    bool attach(std::string port_name);
+    /// \brief detach from (and if the writer, remove) the ring
+    void close();
+    /// \brief true if created or attached
+    bool isOpen() const { return header != nullptr; }
+
+    /// \brief (writer) copy a packet into the ring and wake the readers
+    bool write(const std::string &type, const char *data,
+               unsigned int data_bytes, const yarp::os::Stamp &envelope);
+
+    /// \brief (reader) block until the next packet is available and copy it.
+    /// \returns false if interrupted, or if the ring can no longer be locked.
+    bool read(std::string &type, std::vector<int32_t> &data,
+              unsigned int &n_ints, yarp::os::Stamp &envelope);
+
+    /// \brief (reader) make a blocking read() return false
+    void interrupt();
+
+    /// \brief (reader) number of packets lost to overruns since the last call
+    unsigned int queryLost();
+
+};
+
+}
+
+#endif
@@ -0,0 +1,204 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VSKIN__
+#define __VSKIN__
+
+#include "iCub/eventdriven/vCodec.h"
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+namespace ev {
+
+/// \brief skin samples stored as a structure of arrays. The raw address and
+/// value words, and the timestamp of each, are kept so the samples can be
+/// forwarded unchanged in the SkinSample wire format.
+class skinSamples
+{
+public:
+
+    //the timestamp of the value (the time of the sample)
+    std::vector<int32_t> stamp;
+    std::vector<int32_t> address_stamp;
+    std::vector<int32_t> address;
+    std::vector<int32_t> sample;
+
+    /// \brief the table index of a skin address (side, body_part, taxel)
+    static unsigned int taxelIndex(int32_t address)
+    {
+        return ((address >> 9) & 0x2000) | ((address >> 6) & 0x1C00) |
+                ((address >> 1) & 0x03FF);
+    }
+    /// \brief the number of distinct taxelIndex()
+    static unsigned int taxelCount() { return 0x4000; }
+
+    size_t size() const { return stamp.size(); }
+    bool empty() const { return stamp.empty(); }
+    void clear()
+    {
+        stamp.clear(); address_stamp.clear(); address.clear(); sample.clear();
+    }
+    void reserve(size_t n)
+    {
+        stamp.reserve(n); address_stamp.reserve(n); address.reserve(n);
+        sample.reserve(n);
+    }
+
+    void push_back(int32_t address_ts, int32_t address_word, int32_t ts,
+                   int32_t sample_word)
+    {
+        stamp.push_back(ts);
+        address_stamp.push_back(address_ts);
+        address.push_back(address_word);
+        sample.push_back(sample_word);
+    }
+
+    unsigned int taxel(size_t i) const { return taxelIndex(address[i]); }
+    int value(size_t i) const { return sample[i] & 0xFFFF; }
+
+    /// \brief append the samples as [TS ADDRESS TS VALUE]
+    void encode(std::vector<int32_t> &wire) const
+    {
+        size_t pos = wire.size();
+        wire.resize(pos + 4 * size());
+        int32_t *w = wire.data() + pos;
+        for(size_t i = 0; i < size(); i++) {
+            *(w++) = address_stamp[i];
+            *(w++) = address[i];
+            *(w++) = stamp[i];
+            *(w++) = sample[i];
+        }
+    }
+
+};
+
+/// \brief splits [TS word] pairs of skin data into skin events and skin
+/// samples. The address and value of a sample can arrive in different
+/// packets: an address is kept until its value arrives, a value without an
+/// address is dropped and counted.
+class skinDemux
+{
+private:
+
+    bool pending;
+    int32_t pending_stamp;
+    int32_t pending_address;
+    unsigned int dropped;
+
+public:
+
+    skinDemux() : pending(false), pending_stamp(0), pending_address(0),
+        dropped(0) {}
+
+    /// \brief demultiplex a single skin [TS word] pair
+    inline void push(const int32_t *pair, std::vector<int32_t> &events,
+                     skinSamples &samples)
+    {
+        int32_t word = pair[1];
+        if(!(IS_SAMPLE(word))) {
+            events.push_back(pair[0]);
+            events.push_back(word);
+        } else if(IS_SSA(word)) {
+            if(pending) dropped++;
+            pending = true;
+            pending_stamp = pair[0];
+            pending_address = word;
+        } else if(pending) {
+            samples.push_back(pending_stamp, pending_address, pair[0], word);
+            pending = false;
+        } else {
+            dropped++;
+        }
+    }
+
+    /// \brief demultiplex a packet of skin [TS word] pairs. Pairs that are not
+    /// skin data are ignored.
+    void process(const int32_t *data, size_t n_ints,
+                 std::vector<int32_t> &events, skinSamples &samples)
+    {
+        const int32_t *end = data + (n_ints & ~(size_t)1);
+        for(; data < end; data += 2)
+            if(IS_SKIN(data[1]))
+                push(data, events, samples);
+    }
+
+    /// \brief the number of sample halves dropped since the last call
+    unsigned int queryDropped()
+    {
+        unsigned int n = dropped;
+        dropped = 0;
+        return n;
+    }
+
+};
+
+/// \brief the latest value of every taxel, its change from the previous
+/// sample, and the time it was updated. Updated by a single thread and read
+/// by any other thread without locking.
+class skinTaxelTable
+{
+private:
+
+    //value in the upper 16 bits, delta in the lower 16 bits
+    std::vector< std::atomic<uint32_t> > latest;
+    std::vector< std::atomic<int32_t> > stamps;
+
+public:
+
+    skinTaxelTable() : latest(skinSamples::taxelCount()),
+        stamps(skinSamples::taxelCount())
+    {
+        for(size_t i = 0; i < latest.size(); i++) {
+            latest[i].store(0, std::memory_order_relaxed);
+            stamps[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /// \brief (writer) update the taxels of a batch of samples
+    void update(const skinSamples &samples)
+    {
+        for(size_t i = 0; i < samples.size(); i++) {
+            unsigned int t = samples.taxel(i);
+            uint32_t v = samples.value(i);
+            uint32_t prev = latest[t].load(std::memory_order_relaxed) >> 16;
+            latest[t].store((v << 16) | ((v - prev) & 0xFFFF),
+                            std::memory_order_relaxed);
+            stamps[t].store(samples.stamp[i], std::memory_order_relaxed);
+        }
+    }
+
+    /// \brief (reader) the latest value and change of a taxel
+    void get(unsigned int taxel, int &value, int &delta) const
+    {
+        uint32_t l = latest[taxel].load(std::memory_order_relaxed);
+        value = l >> 16;
+        delta = (int16_t)(l & 0xFFFF);
+    }
+
+    /// \brief (reader) the stamp of the latest sample of a taxel
+    int32_t stamp(unsigned int taxel) const
+    {
+        return stamps[taxel].load(std::memory_order_relaxed);
+    }
+
+};
+
+}
+
+#endif
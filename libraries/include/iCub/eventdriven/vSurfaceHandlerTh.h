@@ -29,9 +29,86 @@
 #include <deque>
 #include <string>
 #include <map>
+#include <atomic>
+#include <thread>
 
 namespace ev {
 
+inline void surfaceAdd(temporalSurface &surface, const event<> &v)
+{
+    surface.fastAddEvent(v);
+}
+
+inline void surfaceAdd(historicalSurface &surface, const event<> &v)
+{
+    surface.addEvent(v);
+}
+
+/// \brief two copies of a surface, so queries never wait for events to be
+/// added. A single writer adds events to the back copy, then publish() swaps
+/// the copies and, once the queries already reading the old front copy have
+/// finished, adds the same events to it. Queries always see the surface as
+/// it was at a publish().
+template <typename S> class doubleSurface
+{
+private:
+
+    S copies[2];
+    vQueue backlog;
+    std::atomic<int> front;
+    std::atomic<int> version;
+    std::atomic<int> readers[2];
+
+public:
+
+    doubleSurface() : front(0), version(0)
+    {
+        readers[0] = 0;
+        readers[1] = 0;
+    }
+
+    /// \brief access a copy for initialisation (before events are added)
+    S &copy(int i) { return copies[i]; }
+
+    /// \brief (writer) add an event to the back copy
+    void add(const event<> &v)
+    {
+        surfaceAdd(copies[1 - front.load()], v);
+        backlog.push_back(v);
+    }
+
+    /// \brief (writer) make the events added so far visible to queries
+    void publish()
+    {
+        if(backlog.empty()) return;
+
+        int new_front = 1 - front.load();
+        front.store(new_front);
+
+        //wait for any query that could still be reading the old front copy
+        int previous = version.load();
+        while(readers[1 - previous].load()) std::this_thread::yield();
+        version.store(1 - previous);
+        while(readers[previous].load()) std::this_thread::yield();
+
+        for(auto &v : backlog)
+            surfaceAdd(copies[1 - new_front], v);
+        backlog.clear();
+    }
+
+    /// \brief (reader) call f(S &) with the front copy and return its result
+    template <typename F> auto query(F f) -> decltype(f(copies[0]))
+    {
+        struct reading {
+            std::atomic<int> &count;
+            reading(std::atomic<int> &count) : count(count) { count++; }
+            ~reading() { count--; }
+        } r(readers[version.load()]);
+        return f(copies[front.load()]);
+    }
+
+};
+
 /// \brief an asynchronous reading port that accepts vBottles and decodes them
 class queueAllocator : public yarp::os::BufferedPort<ev::vBottle>
 {
@@ -207,16 +284,17 @@ class surfaceThread : public yarp::os::Thread
 {
 private:
 
-    ev::temporalSurface surfaceLeft;
-    ev::temporalSurface surfaceRight;
+    doubleSurface<ev::temporalSurface> surfaceLeft;
+    doubleSurface<ev::temporalSurface> surfaceRight;
 
     queueAllocator allocatorCallback;
 
-    yarp::os::Mutex m;
+    yarp::os::Mutex m; //only protects the published stamp
     yarp::os::Stamp yarpstamp;
-    unsigned int ctime;
+    yarp::os::Stamp published_stamp;
+    std::atomic<unsigned int> ctime;
 
-    int vcount;
+    std::atomic<int> vcount;
 
 
 public:
@@ -229,8 +307,10 @@ public:
 
     void configure(int height, int width)
     {
-        surfaceLeft = ev::temporalSurface(width, height);
-        surfaceRight = ev::temporalSurface(width, height);
+        for(int i = 0; i < 2; i++) {
+            surfaceLeft.copy(i) = ev::temporalSurface(width, height);
+            surfaceRight.copy(i) = ev::temporalSurface(width, height);
+        }
     }
 
     bool open(std::string portname)
@@ -249,6 +329,7 @@ public:
 
     void run()
     {
+        vMetrics::get().registerThread("surfaceThread");
         while(true) {
 
             ev::vQueue *q = 0;
@@ -259,22 +340,25 @@ public:
 
             for(ev::vQueue::iterator qi = q->begin(); qi != q->end(); qi++) {
 
-                m.lock();
-
-                vcount++;
-
-                ctime = (*qi)->stamp;
-
                 if((*qi)->getChannel() == 0)
-                    surfaceLeft.fastAddEvent(*qi);
+                    surfaceLeft.add(*qi);
                 else if((*qi)->getChannel() == 1)
-                    surfaceRight.fastAddEvent(*qi);
+                    surfaceRight.add(*qi);
                 else
                     std::cout << "Unknown channel" << std::endl;
 
-                m.unlock();
+            }
 
+            //make the whole packet visible to queries at once
+            surfaceLeft.publish();
+            surfaceRight.publish();
+            if(q->size()) {
+                vcount += q->size();
+                ctime = q->back()->stamp;
             }
+            m.lock();
+            published_stamp = yarpstamp;
+            m.unlock();
 
             //allocatorCallback.scrapQ();
 
@@ -287,28 +371,34 @@ public:
 
         //if(!vcount) return false;
 
-        m.lock();
+        auto roi = [&](ev::temporalSurface &s) { return s.getSurf_Tlim(t, x, y, r); };
         if(c == 0)
-            fillq = surfaceLeft.getSurf_Tlim(t, x, y, r);
+            fillq = surfaceLeft.query(roi);
         else
-            fillq = surfaceRight.getSurf_Tlim(t, x, y, r);
+            fillq = surfaceRight.query(roi);
         vcount = 0;
-        m.unlock();
-        return yarpstamp;
+        return queryStamp();
     }
 
     yarp::os::Stamp queryWindow(ev::vQueue &fillq, int c, unsigned int t)
     {
 
-        m.lock();
+        auto window = [&](ev::temporalSurface &s) { return s.getSurf_Tlim(t); };
         if(c == 0)
-            fillq = surfaceLeft.getSurf_Tlim(t);
+            fillq = surfaceLeft.query(window);
         else
-            fillq = surfaceRight.getSurf_Tlim(t);
+            fillq = surfaceRight.query(window);
         vcount = 0;
-        m.unlock();
 
-        return yarpstamp;
+        return queryStamp();
+    }
+
+    yarp::os::Stamp queryStamp()
+    {
+        m.lock();
+        yarp::os::Stamp ys = published_stamp;
+        m.unlock();
+        return ys;
     }
 
     unsigned int queryVTime()
@@ -326,12 +416,14 @@ private:
     int maxcpudelay; //maximum delay between v time and cpu time (in v time)
 
     queueAllocator allocatorCallback;
-    historicalSurface surfaceleft;
-    historicalSurface surfaceright;
-    yarp::os::Mutex m;
+    doubleSurface<historicalSurface> surfaceleft;
+    doubleSurface<historicalSurface> surfaceright;
+    yarp::os::Mutex m;      //queries use a shared scratch image
+    yarp::os::Mutex mdelay; //protects the stamps and delays below
 
     //current stamp to propagate
     yarp::os::Stamp ystamp;
+    yarp::os::Stamp published_ystamp;
     unsigned int vstamp;
 
     //synchronising value (add to it when stamps come in, subtract from it
@@ -341,6 +433,27 @@ private:
     double cputimeR;
     int cpudelayR;
 
+    int updateDelay(int channel, double gain)
+    {
+        mdelay.lock();
+        double cpunow = yarp::os::Time::now();
+        double &cputime = channel == 0 ? cputimeL : cputimeR;
+        int &cpudelay = channel == 0 ? cpudelayL : cpudelayR;
+
+        cpudelay -= (cpunow - cputime) * vtsHelper::vtsscaler * gain;
+        cputime = cpunow;
+
+        if(cpudelay < 0) cpudelay = 0;
+        if(cpudelay > maxcpudelay) {
+            yWarning() << "CPU delay hit maximum";
+            cpudelay = maxcpudelay;
+        }
+
+        int delay = cpudelay;
+        mdelay.unlock();
+        return delay;
+    }
+
 public:
 
     hSurfThread()
@@ -354,8 +467,10 @@ public:
     void configure(int height, int width, double maxcpudelay)
     {
         this->maxcpudelay = maxcpudelay * vtsHelper::vtsscaler;
-        surfaceleft.initialise(height, width);
-        surfaceright.initialise(height, width);
+        for(int i = 0; i < 2; i++) {
+            surfaceleft.copy(i).initialise(height, width);
+            surfaceright.copy(i).initialise(height, width);
+        }
     }
 
     bool open(std::string portname)
@@ -376,8 +491,8 @@ public:
 
     void run()
     {
+        vMetrics::get().registerThread("hSurfThread");
         static int maxqs = 4;
-        bool allowproc = true;
 
         while(true) {
 
@@ -387,34 +502,33 @@ public:
             }
             if(isStopping()) break;
 
+            //while we are behind, keep adding events without publishing them
+            //so queries are not given a surface that is about to change
+            bool allowproc = allocatorCallback.queryunprocessed() < maxqs;
+
+            for(ev::vQueue::iterator qi = q->begin(); qi != q->end(); qi++) {
+
+                if((*qi)->getChannel() == 0)
+                    surfaceleft.add(*qi);
+                else if((*qi)->getChannel() == 1)
+                    surfaceright.add(*qi);
 
-            int nqs = allocatorCallback.queryunprocessed();
+            }
 
-            if(allowproc)
-                m.lock();
+            if(!allowproc)
+                continue;
 
-            if(nqs >= maxqs)
-                allowproc = false;
-            else if(nqs < maxqs)
-                allowproc = true;
+            surfaceleft.publish();
+            surfaceright.publish();
 
+            mdelay.lock();
             int dt = q->back()->stamp - vstamp;
             if(dt < 0) dt += vtsHelper::max_stamp;
             cpudelayL += dt;
             cpudelayR += dt;
             vstamp = q->back()->stamp;
-
-            for(ev::vQueue::iterator qi = q->begin(); qi != q->end(); qi++) {
-
-                if((*qi)->getChannel() == 0)
-                    surfaceleft.addEvent(*qi);
-                else if((*qi)->getChannel() == 1)
-                    surfaceright.addEvent(*qi);
-
-            }
-
-            if(allowproc)
-                m.unlock();
+            published_ystamp = ystamp;
+            mdelay.unlock();
 
             //allocatorCallback.scrapQ();
 
@@ -426,37 +540,14 @@ public:
     {
 
         vQueue q;
+        int delay = updateDelay(channel, 1.1);
 
+        auto roi = [&](historicalSurface &s) { s.getSurfaceN(q, delay, numEvts, r); };
         m.lock();
-        double cpunow = yarp::os::Time::now();
-
-        if(channel == 0) {
-
-            cpudelayL -= (cpunow - cputimeL) * vtsHelper::vtsscaler * 1.1;
-            cputimeL = cpunow;
-
-            if(cpudelayL < 0) cpudelayL = 0;
-            if(cpudelayL > maxcpudelay) {
-                yWarning() << "CPU delay hit maximum";
-                cpudelayL = maxcpudelay;
-            }
-
-            surfaceleft.getSurfaceN(q, cpudelayL, numEvts, r);
-        }
-        else {
-
-            cpudelayR -= (cpunow - cputimeR) * vtsHelper::vtsscaler * 1.1;
-            cputimeR = cpunow;
-
-            if(cpudelayR < 0) cpudelayR = 0;
-            if(cpudelayR > maxcpudelay) {
-                yWarning() << "CPU delay hit maximum";
-                cpudelayR = maxcpudelay;
-            }
-
-            surfaceright.getSurfaceN(q, cpudelayR, numEvts, r);
-        }
-
+        if(channel == 0)
+            surfaceleft.query(roi);
+        else
+            surfaceright.query(roi);
         m.unlock();
 
         return q;
@@ -465,39 +556,11 @@ public:
     vQueue queryROI(int channel, unsigned int querySize, int x, int y, int r)
     {
 
+        int delay = updateDelay(channel, 1.01);
 
-        vQueue q;
-
+        auto roi = [&](historicalSurface &s) { return s.getSurface(delay, querySize, r, x, y); };
         m.lock();
-
-        double cpunow = yarp::os::Time::now();
-
-        if(channel == 0) {
-
-            cpudelayL -= (cpunow - cputimeL) * vtsHelper::vtsscaler * 1.01;
-            cputimeL = cpunow;
-
-            if(cpudelayL < 0) cpudelayL = 0;
-            if(cpudelayL > maxcpudelay) {
-                yWarning() << "CPU delay hit maximum";
-                cpudelayL = maxcpudelay;
-            }
-
-            q = surfaceleft.getSurface(cpudelayL, querySize, r, x, y);
-        } else {
-
-            cpudelayR -= (cpunow - cputimeR) * vtsHelper::vtsscaler * 1.01;
-            cputimeR = cpunow;
-
-            if(cpudelayR < 0) cpudelayR = 0;
-            if(cpudelayR > maxcpudelay) {
-                yWarning() << "CPU delay hit maximum";
-                cpudelayR = maxcpudelay;
-            }
-
-            q = surfaceright.getSurface(cpudelayR, querySize, r, x, y);
-        }
-
+        vQueue q = channel == 0 ? surfaceleft.query(roi) : surfaceright.query(roi);
         m.unlock();
 
         return q;
@@ -505,39 +568,11 @@ public:
 
     vQueue queryWindow(int channel, unsigned int querySize)
     {
-        vQueue q;
+        int delay = updateDelay(channel, 1.01);
 
+        auto window = [&](historicalSurface &s) { return s.getSurface(delay, querySize); };
         m.lock();
-
-        double cpunow = yarp::os::Time::now();
-
-        if(channel == 0) {
-
-            cpudelayL -= (cpunow - cputimeL) * vtsHelper::vtsscaler * 1.01;
-            cputimeL = cpunow;
-
-            if(cpudelayL < 0) cpudelayL = 0;
-            if(cpudelayL > maxcpudelay) {
-                yWarning() << "CPU delay hit maximum";
-                cpudelayL = maxcpudelay;
-            }
-
-            q = surfaceleft.getSurface(cpudelayL, querySize);
-        }
-        else {
-
-            cpudelayR -= (cpunow - cputimeR) * vtsHelper::vtsscaler * 1.01;
-            cputimeR = cpunow;
-
-            if(cpudelayR < 0) cpudelayR = 0;
-            if(cpudelayR > maxcpudelay) {
-                yWarning() << "CPU delay hit maximum";
-                cpudelayR = maxcpudelay;
-            }
-
-            q = surfaceright.getSurface(cpudelayR, querySize);
-        }
-
+        vQueue q = channel == 0 ? surfaceleft.query(window) : surfaceright.query(window);
         m.unlock();
 
         return q;
@@ -554,19 +589,22 @@ public:
 
     yarp::os::Stamp queryYstamp()
     {
-        return ystamp;
+        mdelay.lock();
+        yarp::os::Stamp ys = published_ystamp;
+        mdelay.unlock();
+        return ys;
     }
 
     int queryVstamp(int channel = 0)
     {
         int modvstamp;
-        m.lock();
+        mdelay.lock();
         if(channel) {
             modvstamp = vstamp - cpudelayR;
         } else {
             modvstamp = vstamp - cpudelayL;
         }
-        m.unlock();
+        mdelay.unlock();
 
         if(modvstamp < 0) modvstamp += vtsHelper::max_stamp;
         return modvstamp;
@@ -629,6 +667,7 @@ public:
 
     void run()
     {
+        vMetrics::get().registerThread("tWinThread");
         if(strictUpdatePeriod) {
             safety.lock();
             waitforquery.lock();
@@ -715,7 +754,8 @@ public:
 };
 
 /// \brief automatically accept multiple event types from different ports
-/// (e.g. as in the vFramer)
+/// (e.g. as in the vFramer). Use vStreamSync for time-aligned slices of the
+/// inputs.
 class syncvstreams
 {
 private:
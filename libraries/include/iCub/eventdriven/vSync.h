@@ -0,0 +1,308 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VSYNC__
+#define __VSYNC__
+
+#include <yarp/os/all.h>
+#include "iCub/eventdriven/vCodec.h"
+#include "iCub/eventdriven/vPort.h"
+#include "iCub/eventdriven/vMerge.h"
+#include <map>
+#include <string>
+#include <sstream>
+#include <atomic>
+
+namespace ev {
+
+/// \brief reads events from several ports (e.g. left and right cameras, or
+/// skin and vision) and releases them as time-aligned slices. A slice is
+/// released once the watermark (the latest timestamp reached by every
+/// input) has passed its end, or once the timeout has expired since the
+/// first input passed its end. An input that times out is then left behind
+/// (not waited for) until it catches up with the watermark again, so a
+/// silent or disconnected input delays the other inputs by at most the
+/// timeout, once, and not per slice. Events are moved from the inputs into
+/// the slices without copying windows. Each input is expected to be in
+/// temporal order; events that arrive for a slice already released are
+/// dropped and counted.
+class vStreamSync
+{
+private:
+
+    class input : public yarp::os::Thread
+    {
+    public:
+
+        vStreamSync *sync;
+        vReadPort<vQueue> port;
+
+        //events not yet released, and their unwrapped timestamps
+        vQueue events;
+        std::deque<int64_t> keys;
+        //the latest unwrapped timestamp received
+        int64_t progress;
+        bool started;
+        //timed out, and not waited for until it reaches the watermark
+        bool lagging;
+        yarp::os::Stamp ystamp;
+
+        input() : sync(nullptr), progress(0), started(false), lagging(false) {}
+
+        void run()
+        {
+            vMetrics::get().registerThread("vStreamSync");
+            while(!isStopping()) {
+                yarp::os::Stamp s;
+                const vQueue *q = port.read(s);
+                if(!q) break;
+                sync->add(*this, *q, s);
+            }
+        }
+
+        void onStop()
+        {
+            port.close();
+        }
+    };
+
+    std::map<std::string, input> inputs;
+    yarp::os::Mutex m;
+    yarp::os::Semaphore progressed;
+
+    int64_t reference;
+    bool referenced;
+    int64_t watermark;
+    int period;
+    double timeout;
+    double ready_since;
+    unsigned int late;
+    std::atomic<bool> closing;
+
+    yarp::os::Stamp yStamp;
+    int vStamp;
+
+    void add(input &in, const vQueue &q, const yarp::os::Stamp &s)
+    {
+        m.lock();
+        for(size_t i = 0; i < q.size(); i++) {
+            if(!referenced) {
+                reference = q[i]->stamp;
+                watermark = reference;
+                referenced = true;
+            }
+            int64_t key = vMerge::unwrap(q[i]->stamp,
+                                         in.started ? in.progress : reference);
+            if(!in.started || key > in.progress)
+                in.progress = key;
+            in.started = true;
+            if(key < watermark) {
+                late++;
+                continue;
+            }
+            in.events.push_back(q[i]);
+            in.keys.push_back(key);
+        }
+        in.ystamp = s;
+        m.unlock();
+        progressed.post();
+    }
+
+    //(locked) true if the slice ending at end can be released
+    bool complete(int64_t end)
+    {
+        bool all = true, any = false;
+        std::map<std::string, input>::iterator i;
+        for(i = inputs.begin(); i != inputs.end(); i++) {
+            input &in = i->second;
+            if(in.lagging && in.started && in.progress >= watermark)
+                in.lagging = false;
+            bool passed = in.started && in.progress >= end;
+            if(!in.lagging) all = all && passed;
+            any = any || passed;
+        }
+        if(all && any) return true;
+        if(!any || timeout <= 0) return false;
+
+        if(!ready_since) ready_since = yarp::os::Time::now();
+        if(yarp::os::Time::now() - ready_since <= timeout) return false;
+
+        //stop waiting for the inputs that did not arrive in time
+        for(i = inputs.begin(); i != inputs.end(); i++) {
+            input &in = i->second;
+            if(in.lagging || (in.started && in.progress >= end)) continue;
+            in.lagging = true;
+            yWarning() << "vStreamSync:" << i->first << "timed out, releasing"
+                       << "slices without it until it catches up";
+        }
+        return true;
+    }
+
+public:
+
+    vStreamSync() : progressed(0)
+    {
+        reference = 0;
+        referenced = false;
+        watermark = 0;
+        period = (int)(0.01 * vtsHelper::vtsscaler);
+        timeout = 0.05;
+        ready_since = 0;
+        late = 0;
+        closing = false;
+        vStamp = 0;
+    }
+
+    /// \brief open an input port for an event type, named
+    /// moduleName/eventType:i
+    bool open(std::string moduleName, std::string eventType)
+    {
+        if(inputs.count(eventType))
+            return true;
+
+        input &in = inputs[eventType];
+        in.sync = this;
+        if(!in.port.open(moduleName + "/" + eventType + ":i"))
+            return false;
+        return in.start();
+    }
+
+    /// \brief set the length of a slice (in event timestamps) and how long
+    /// (in seconds) to wait for a late input. A timeout of 0 always waits
+    /// for every input.
+    void setSlicing(int period, double timeout)
+    {
+        this->period = std::max(period, 1);
+        this->timeout = timeout;
+    }
+
+    /// \brief block until the next slice can be released and move its events
+    /// into slice[eventType]. Slices with no events from any input are
+    /// skipped.
+    /// \returns false if closed
+    bool getSlice(std::map<std::string, vQueue> &slice)
+    {
+        while(!closing) {
+
+            m.lock();
+            if(referenced) {
+
+                //skip the slices that no input has events in
+                int64_t first = watermark + period;
+                bool pending = false;
+                std::map<std::string, input>::iterator i;
+                for(i = inputs.begin(); i != inputs.end(); i++) {
+                    if(i->second.keys.empty()) continue;
+                    if(!pending || i->second.keys.front() < first)
+                        first = i->second.keys.front();
+                    pending = true;
+                }
+                int64_t end = watermark + period;
+                if(pending && first >= end) {
+                    int64_t skip = watermark + ((first - watermark) / period) * period;
+                    if(complete(skip)) {
+                        watermark = skip;
+                        end = watermark + period;
+                        ready_since = 0;
+                    }
+                }
+
+                if(pending && complete(end)) {
+                    for(i = inputs.begin(); i != inputs.end(); i++) {
+                        vQueue &out = slice[i->first];
+                        out.clear();
+                        input &in = i->second;
+                        while(in.keys.size() && in.keys.front() < end) {
+                            out.push_back(in.events.front());
+                            in.events.pop_front();
+                            in.keys.pop_front();
+                        }
+                        if(in.ystamp.isValid() &&
+                                in.ystamp.getTime() > yStamp.getTime())
+                            yStamp = in.ystamp;
+                    }
+                    watermark = end;
+                    vStamp = (end - 1) & vtsHelper::max_stamp;
+                    ready_since = 0;
+                    m.unlock();
+                    return true;
+                }
+            }
+            m.unlock();
+
+            progressed.waitWithTimeout(timeout > 0 ? timeout : 0.1);
+        }
+        return false;
+    }
+
+    /// \brief stop reading all inputs and make getSlice() return false
+    void close()
+    {
+        closing = true;
+        progressed.post();
+        std::map<std::string, input>::iterator i;
+        for(i = inputs.begin(); i != inputs.end(); i++)
+            i->second.stop();
+    }
+
+    /// \brief the most recent envelope of the inputs of the last slice
+    yarp::os::Stamp getystamp()
+    {
+        return yStamp;
+    }
+
+    /// \brief the last timestamp of the last slice
+    int getvstamp()
+    {
+        return vStamp;
+    }
+
+    /// \brief the number of events that arrived after their slice was
+    /// released, since the last call
+    unsigned int queryLate()
+    {
+        m.lock();
+        unsigned int n = late;
+        late = 0;
+        m.unlock();
+        return n;
+    }
+
+    /// \brief how far (in event timestamps) each input is ahead of the
+    /// watermark
+    std::string progressStats()
+    {
+        std::ostringstream oss;
+        m.lock();
+        std::map<std::string, input>::iterator i;
+        for(i = inputs.begin(); i != inputs.end(); i++) {
+            oss << i->first << ": ";
+            if(i->second.started)
+                oss << i->second.progress - watermark << " ";
+            else
+                oss << "- ";
+        }
+        m.unlock();
+        return oss.str();
+    }
+
+};
+
+}
+
+#endif
@@ -0,0 +1,268 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VTARGET__
+#define __VTARGET__
+
+#include <yarp/os/all.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ev {
+
+/// \brief the state of a tracked target in one camera
+struct vTarget {
+    int id;
+    int channel;
+    double x;
+    double y;
+    double r;
+    bool present;
+    //event timestamp of the state and (local) time it was updated
+    unsigned int stamp;
+    double time;
+};
+
+/// \brief the latest vTarget of each (id, channel). One thread writes and any
+/// number of threads read without locking: each slot has a sequence number
+/// that is odd while it is written, and a reader that sees it change copies
+/// the slot again. A write never waits for the readers and simply replaces
+/// the previous value, so a slow reader only ever sees the newest state.
+class vTargetSlots
+{
+private:
+
+    struct slot {
+        std::atomic<unsigned int> seq;
+        vTarget value;
+    };
+
+    int n_ids;
+    std::unique_ptr<slot[]> slots;
+
+    slot *slotOf(int id, int channel) const
+    {
+        if(id < 0 || id >= n_ids || channel < 0 || channel > 1) return nullptr;
+        return &slots[id * 2 + channel];
+    }
+
+public:
+
+    /// \brief constructor with the number of target IDs
+    vTargetSlots(int n_ids = 16) : n_ids(0)
+    {
+        resize(n_ids);
+    }
+
+    /// \brief set the number of target IDs, clearing every slot. Not thread
+    /// safe: call before the slots are used.
+    void resize(int n_ids)
+    {
+        this->n_ids = n_ids > 0 ? n_ids : 1;
+        slots.reset(new slot[this->n_ids * 2]);
+        for(int i = 0; i < this->n_ids * 2; i++) {
+            slots[i].seq = 0;
+            slots[i].value = vTarget();
+        }
+    }
+
+    int size() const { return n_ids; }
+
+    /// \brief (single writer) replace the state of a target
+    /// \returns false if the id or channel is out of range
+    bool set(const vTarget &t)
+    {
+        slot *s = slotOf(t.id, t.channel);
+        if(!s) return false;
+        unsigned int seq = s->seq.load(std::memory_order_relaxed);
+        s->seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        s->value = t;
+        s->seq.store(seq + 2, std::memory_order_release);
+        return true;
+    }
+
+    /// \brief the latest state of a target
+    /// \returns false if it was never set
+    bool get(int id, int channel, vTarget &t) const
+    {
+        const slot *s = slotOf(id, channel);
+        if(!s) return false;
+        unsigned int before, after;
+        do {
+            before = s->seq.load(std::memory_order_acquire);
+            t = s->value;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = s->seq.load(std::memory_order_relaxed);
+        } while(before != after || (before & 1));
+        return before != 0;
+    }
+
+    /// \brief the most recently updated target of a channel, of any id
+    /// \returns false if no target of the channel was set
+    bool newest(int channel, vTarget &t) const
+    {
+        bool found = false;
+        vTarget candidate;
+        for(int id = 0; id < n_ids; id++) {
+            if(!get(id, channel, candidate)) continue;
+            if(!found || candidate.time > t.time) t = candidate;
+            found = true;
+        }
+        return found;
+    }
+
+};
+
+/// \brief publishes the latest state of each target. Targets are collected
+/// with publish() while a batch of events is processed and flush() sends only
+/// the last state of each (id, channel) in a single non-strict write, so a
+/// slow reader is given the newest states instead of a queue of old ones.
+class vTargetWriter
+{
+private:
+
+    yarp::os::BufferedPort<yarp::os::Bottle> port;
+    std::vector<vTarget> pending;
+
+public:
+
+    bool open(std::string name) { return port.open(name); }
+    void close() { port.close(); }
+    void interrupt() { port.interrupt(); }
+    int getOutputCount() { return port.getOutputCount(); }
+
+    /// \brief set the state of a target, replacing an unsent state of the
+    /// same (id, channel)
+    void publish(int id, int channel, double x, double y, double r,
+                 bool present, unsigned int stamp)
+    {
+        vTarget t = {id, channel, x, y, r, present, stamp,
+                     yarp::os::Time::now()};
+        for(size_t i = 0; i < pending.size(); i++) {
+            if(pending[i].id == id && pending[i].channel == channel) {
+                pending[i] = t;
+                return;
+            }
+        }
+        pending.push_back(t);
+    }
+
+    /// \brief send the states published since the last flush
+    void flush(yarp::os::Stamp *envelope = nullptr)
+    {
+        if(pending.empty()) return;
+        if(port.getOutputCount()) {
+            yarp::os::Bottle &b = port.prepare();
+            b.clear();
+            for(size_t i = 0; i < pending.size(); i++) {
+                const vTarget &t = pending[i];
+                yarp::os::Bottle &tb = b.addList();
+                tb.addInt(t.id);
+                tb.addInt(t.channel);
+                tb.addDouble(t.x);
+                tb.addDouble(t.y);
+                tb.addDouble(t.r);
+                tb.addInt(t.present);
+                tb.addInt(t.stamp);
+            }
+            if(envelope) port.setEnvelope(*envelope);
+            port.write();
+        }
+        pending.clear();
+    }
+
+};
+
+/// \brief receives the states of a vTargetWriter into vTargetSlots. The port
+/// is not strict, so states that arrive while the previous ones are decoded
+/// replace each other instead of queueing, and the control loop reads the
+/// newest state of a target (and how old it is) without waiting. Targets
+/// with an ID outside the slots are dropped, with a warning at most every
+/// few seconds.
+class vTargetReader : public yarp::os::BufferedPort<yarp::os::Bottle>
+{
+private:
+
+    vTargetSlots slots;
+    unsigned int dropped;
+    int max_dropped;
+    double warn_time;
+
+public:
+
+    vTargetReader(int n_ids = 16) : slots(n_ids), dropped(0), max_dropped(0),
+        warn_time(0.0)
+    {
+        useCallback();
+    }
+
+    /// \brief set the number of target IDs (0 to n_ids-1) kept. Call before
+    /// open().
+    void setTargetCount(int n_ids) { slots.resize(n_ids); }
+
+    void onRead(yarp::os::Bottle &b)
+    {
+        double now = yarp::os::Time::now();
+        for(size_t i = 0; i < b.size(); i++) {
+            yarp::os::Bottle *tb = b.get(i).asList();
+            if(!tb || tb->size() < 7) continue;
+            vTarget t = {tb->get(0).asInt(), tb->get(1).asInt(),
+                         tb->get(2).asDouble(), tb->get(3).asDouble(),
+                         tb->get(4).asDouble(), tb->get(5).asInt() != 0,
+                         (unsigned int)tb->get(6).asInt(), now};
+            if(!slots.set(t)) {
+                dropped++;
+                if(t.id > max_dropped) max_dropped = t.id;
+            }
+        }
+        if(dropped && now - warn_time > 5.0) {
+            yWarning() << getName() << "dropped" << dropped
+                       << "target states with an ID (up to" << max_dropped
+                       << ") or channel out of range: it keeps" << slots.size()
+                       << "IDs";
+            dropped = 0;
+            max_dropped = 0;
+            warn_time = now;
+        }
+    }
+
+    /// \brief the latest state of a target and the seconds since it arrived
+    /// \returns false if the target was never received
+    bool latest(int id, int channel, vTarget &t, double &age) const
+    {
+        if(!slots.get(id, channel, t)) return false;
+        age = yarp::os::Time::now() - t.time;
+        return true;
+    }
+
+    /// \brief the most recently received target of a channel, of any id
+    bool newest(int channel, vTarget &t, double &age) const
+    {
+        if(!slots.newest(channel, t)) return false;
+        age = yarp::os::Time::now() - t.time;
+        return true;
+    }
+
+};
+
+}
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VTRACE__
+#define __VTRACE__
+
+#include <yarp/os/all.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace ev {
+
+/// \brief records when packets pass through the vReadPorts and vWritePorts of
+/// a process. The envelope of a packet is its provenance: the time is the
+/// time the packet left its origin (e.g. the zynqGrabber) and the count is
+/// its packet ID, and modules forward the envelope of the packets they
+/// process. Each record holds the time, the envelope, the number of events
+/// and the depth of the input queue; the age of the packet (time since its
+/// origin) is accumulated in a histogram for each port.
+///
+/// Tracing is off unless a process calls open(), or the environment variable
+/// EV_TRACE is set to a file name. Records are kept in a ring buffer (of
+/// EV_TRACE_SIZE records) and saved as a Chrome trace (chrome://tracing or
+/// Perfetto) by close(), which is called when the last vReadPort/vWritePort
+/// of the process closes.
+class vTracer
+{
+public:
+
+    enum point { RECEIVED = 0, READ = 1, WRITTEN = 2, N_POINTS = 3 };
+
+private:
+
+    struct record {
+        double time;
+        double origin;
+        int packet;
+        int events;
+        int depth;
+        int stage;
+        int point;
+    };
+
+    static const int max_stages = 64;
+    //ages of 2^b to 2^(b+1) microseconds
+    static const int n_buckets = 32;
+
+    std::atomic<bool> active;
+    std::string filename;
+    std::vector<record> ring;
+    std::atomic<unsigned long> next;
+    int users;
+
+    yarp::os::Mutex names_mutex;
+    std::vector<std::string> names;
+    std::atomic<unsigned long> ages[max_stages][N_POINTS][n_buckets];
+
+    vTracer();
+    void push(int stage, point p, const yarp::os::Stamp &envelope,
+              int events, int depth);
+
+public:
+
+    ~vTracer();
+
+    /// \brief the tracer of this process
+    static vTracer &get();
+
+    /// \brief start tracing, keeping the most recent capacity records. The
+    /// trace is saved to filename by close().
+    bool open(std::string filename, unsigned int capacity = 1 << 20);
+
+    bool isActive() const { return active; }
+
+    /// \brief the stage number of a port name
+    int stage(std::string name);
+
+    /// \brief a port that asked for a stage() closed. The last one to close
+    /// calls close().
+    void release();
+
+    /// \brief stop tracing and save the trace (if open() was called)
+    void close();
+
+    /// \brief record a packet passing a point of a stage
+    void trace(int stage, point p, const yarp::os::Stamp &envelope,
+               int events, int depth)
+    {
+        if(active && stage >= 0)
+            push(stage, p, envelope, events, depth);
+    }
+
+    /// \brief write the records as a Chrome trace (the filename given to
+    /// open() if empty)
+    bool save(std::string filename = "");
+
+    /// \brief the median and 99th percentile age (in ms) of the packets at
+    /// each point of each stage
+    std::string latencyStats();
+
+};
+
+}
+
+#endif
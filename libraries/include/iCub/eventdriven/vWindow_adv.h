@@ -22,22 +22,66 @@
 #include <yarp/os/all.h>
 #include <yarp/sig/all.h>
 #include <vector>
+#include <queue>
+#include <unordered_map>
+#include <string>
+#include <new>
+#include <cstdlib>
+#include <climits>
+#include <cmath>
 #include "iCub/eventdriven/vCodec.h"
 #include "iCub/eventdriven/vtsHelper.h"
 #include "iCub/eventdriven/vWindow_basic.h"
 
 namespace ev {
 
+/// \brief allocates memory aligned to a boundary A (a cache line by default)
+template <typename T, size_t A = 64>
+class alignedAllocator
+{
+public:
+
+    typedef T value_type;
+    template <typename U> struct rebind { typedef alignedAllocator<U, A> other; };
+
+    alignedAllocator() {}
+    template <typename U> alignedAllocator(const alignedAllocator<U, A> &) {}
+
+    T *allocate(size_t n)
+    {
+        void *p = 0;
+        size_t bytes = n * sizeof(T);
+        if(posix_memalign(&p, A, bytes ? bytes : A))
+            throw std::bad_alloc();
+        return static_cast<T *>(p);
+    }
+
+    void deallocate(T *p, size_t) { free(p); }
+
+    template <typename U> bool operator==(const alignedAllocator<U, A> &) const
+    { return true; }
+    template <typename U> bool operator!=(const alignedAllocator<U, A> &) const
+    { return false; }
+};
+
+class temporalExpiry;
+class fixedExpiry;
+class lifetimeExpiry;
+
 /// \brief a spatial-temporal surface storage data structure
 class vSurface2 {
 
+    friend class temporalExpiry;
+    friend class fixedExpiry;
+    friend class lifetimeExpiry;
+
 protected:
 
     //! event storage
     vQueue q;
 
-    //! for quick spatial accessing and surfacing
-    std::vector< std::vector < event<> > > spatial;
+    //! for quick spatial accessing and surfacing (one row after the other)
+    std::vector< event<>, alignedAllocator< event<> > > spatial;
 
     //!retina size
     int width;
@@ -46,6 +90,12 @@ protected:
     //! active events
     int count;
 
+    //! the events held, when profiling
+    vProfileSurface profile;
+
+    //! called after an event is stored on the surface
+    virtual void stored(event<> v) {}
+
 public:
 
     ///
@@ -61,11 +111,14 @@ public:
     /// \param event the event to add
     ///
     virtual vQueue addEvent(event<> v);
-    void fastAddEvent(event <> v, bool onlyAdd = false);
+    virtual void fastAddEvent(event <> v, bool onlyAdd = false);
 
     virtual vQueue removeEvents(event<> toAdd) = 0;
     virtual void fastRemoveEvents(event<> toAdd) = 0;
 
+    /// \brief the event stored at a location (no bounds check)
+    event<> &cell(int x, int y) { return spatial[y * width + x]; }
+
     ///
     /// \brief getMostRecent
     /// \return
@@ -74,7 +127,11 @@ public:
 
     int getEventCount() { return count; }
 
-    vQueue getEverything() { return q; }
+    vQueue getEverything()
+    {
+        EV_PROFILE_COPY(q);
+        return q;
+    }
 
     ///
     /// \brief getWindow
@@ -102,7 +159,7 @@ public:
     /// \param yh upper y value of window
     /// \return a vQueue containing a copy of the events
     ///
-    vQueue getSurf(int xl, int xh, int yl, int yh);
+    virtual vQueue getSurf(int xl, int xh, int yl, int yh);
 
     vQueue getSurf_Tlim(int dt);
     vQueue getSurf_Tlim(int dt, int d);
@@ -117,6 +174,257 @@ public:
     void getSurfSorted(vQueue &fillq);
 
 };
+
+/******************************************************************************/
+
+/// \brief the expiry policies of the surfaces. remove<E>(s, toAdd, removed)
+/// is called before toAdd is stored on the surface s (of events of type E),
+/// and appends the events it removes to removed; a null removed is the fast
+/// version, which can skip some of the work. stored(s, v) is called after v
+/// is stored, and accepts(v) is false for events the surface ignores.
+
+/// \brief removes events older than a duration (in clock-ticks)
+class temporalExpiry
+{
+public:
+
+    int duration;
+
+    temporalExpiry(int duration = 2.0 * vtsHelper::vtsscaler) :
+        //whichever is smaller 2 seconds or ~1/2 of the maximum window
+        duration(std::min(duration, (int)(vtsHelper::max_stamp * 0.45))) {}
+
+    bool accepts(const event<> &) const { return true; }
+    template <typename S> void stored(S &, const event<> &) {}
+
+    template <typename E, typename S>
+    void remove(S &s, const event<> &toAdd, vQueue *removed)
+    {
+        //calculate event window boundaries based on latest timestamp
+        int ctime = toAdd->stamp;
+        int upper = ctime + vtsHelper::max_stamp - duration;
+        int lower = ctime - duration;
+
+        //remove any events falling out the back of the window
+        while(s.q.size()) {
+
+            E *v = read_as<E>(s.q.front());
+            event<> &c = s.cell(v->x, v->y);
+            if(c != s.q.front()) {
+                s.q.pop_front();
+                continue;
+            }
+
+            int vtime = v->stamp;
+            if((vtime > ctime && vtime < upper) || vtime < lower) {
+                if(removed) removed->push_back(s.q.front());
+                c = nullptr;
+                s.q.pop_front();
+                s.count--;
+            } else {
+                break;
+            }
+        }
+
+        //the fast version does not check the front of the window
+        if(!removed) return;
+
+        while(s.q.size()) {
+
+            E *v = read_as<E>(s.q.back());
+            event<> &c = s.cell(v->x, v->y);
+            if(c != s.q.back()) {
+                s.q.pop_back();
+                continue;
+            }
+
+            int vtime = v->stamp;
+            if((vtime > ctime && vtime < upper) || vtime < lower) {
+                removed->push_back(s.q.back());
+                c = nullptr;
+                s.q.pop_back();
+                s.count--;
+            } else {
+                break;
+            }
+        }
+    }
+};
+
+/// \brief keeps a fixed number of events
+class fixedExpiry
+{
+public:
+
+    int qlength;
+
+    fixedExpiry(int qlength = 2000) : qlength(qlength) {}
+
+    bool accepts(const event<> &) const { return true; }
+    template <typename S> void stored(S &, const event<> &) {}
+
+    template <typename E, typename S>
+    void remove(S &s, const event<> &, vQueue *removed)
+    {
+        //events replaced at their location are still in q
+        while(s.q.size()) {
+            E *v = read_as<E>(s.q.front());
+            if(s.cell(v->x, v->y) == s.q.front()) break;
+            s.q.pop_front();
+        }
+
+        if(s.count > qlength) {
+            E *v = read_as<E>(s.q.front());
+            if(removed) removed->push_back(s.q.front());
+            s.cell(v->x, v->y) = nullptr;
+            s.q.pop_front();
+            s.count--;
+        }
+    }
+};
+
+/// \brief keeps (flow) events for a "lifetime" given by the inverse of
+/// velocity. Events are indexed by their (unwrapped) time of death in buckets
+/// of 2^bucket_bits timestamps, ordered by a min-heap of bucket numbers, so
+/// adding and expiring events is amortised O(1).
+class lifetimeExpiry
+{
+private:
+
+    struct mortal {
+        unsigned long int death;
+        event<FlowEvent> v;
+    };
+
+    struct deathBucket {
+        unsigned long int first_death;
+        std::vector<mortal> mortals;
+    };
+
+    int bucket_bits;
+    vtsHelper unwrapper;
+    std::unordered_map<unsigned long int, deathBucket> buckets;
+    std::priority_queue<unsigned long int, std::vector<unsigned long int>,
+                        std::greater<unsigned long int> > bucket_order;
+
+    template <typename S>
+    void kill(S &s, const event<FlowEvent> &v, vQueue *removed)
+    {
+        //the event could have already been replaced at its location
+        event<> &c = s.cell(v->x, v->y);
+        if(c != v)
+            return;
+
+        if(removed) removed->push_back(v);
+        c = nullptr;
+        s.count--;
+    }
+
+    template <typename S>
+    void expire(S &s, unsigned long int now, vQueue *removed)
+    {
+        unsigned long int now_bucket = now >> bucket_bits;
+
+        while(!bucket_order.empty() && bucket_order.top() <= now_bucket) {
+
+            unsigned long int b = bucket_order.top();
+            deathBucket &bucket = buckets[b];
+
+            if(b < now_bucket) {
+                //everything in a past bucket is dead
+                for(auto &m : bucket.mortals)
+                    kill(s, m.v, removed);
+            } else {
+                //the current bucket is partially dead
+                if(now <= bucket.first_death)
+                    break;
+                unsigned long int next_death = ULONG_MAX;
+                size_t alive = 0;
+                for(size_t i = 0; i < bucket.mortals.size(); i++) {
+                    if(now > bucket.mortals[i].death) {
+                        kill(s, bucket.mortals[i].v, removed);
+                    } else {
+                        next_death = std::min(next_death, bucket.mortals[i].death);
+                        bucket.mortals[alive++] = bucket.mortals[i];
+                    }
+                }
+                bucket.mortals.resize(alive);
+                bucket.first_death = next_death;
+                if(alive) break;
+            }
+
+            buckets.erase(b);
+            bucket_order.pop();
+        }
+    }
+
+public:
+
+    lifetimeExpiry(int bucket_bits = 10) : bucket_bits(bucket_bits) {}
+
+    bool accepts(const event<> &v) const { return (bool)as_event<FlowEvent>(v); }
+
+    template <typename S> void stored(S &, const event<> &toAdd)
+    {
+        event<FlowEvent> v = as_event<FlowEvent>(toAdd);
+        if(!v) return;
+
+        //lifetime is the time to move one pixel
+        double lifetime = 1.0 / (sqrt(pow(v->vx, 2.0f) + pow(v->vy, 2.0f))
+                                 * vtsHelper::tstosecs());
+        if(!(lifetime < vtsHelper::max_stamp))
+            lifetime = vtsHelper::max_stamp;
+
+        unsigned long int death = unwrapper(v->stamp) + (unsigned long int)lifetime;
+        unsigned long int b = death >> bucket_bits;
+
+        deathBucket &bucket = buckets[b];
+        if(bucket.mortals.empty()) {
+            bucket.first_death = death;
+            bucket_order.push(b);
+        } else if(death < bucket.first_death) {
+            bucket.first_death = death;
+        }
+        bucket.mortals.push_back({death, v});
+    }
+
+    template <typename E, typename S>
+    void remove(S &s, const event<> &toAdd, vQueue *removed)
+    {
+        //lifetime requires a flow event only
+        event<FlowEvent> v = as_event<FlowEvent>(toAdd);
+        if(!v) return;
+
+        expire(s, unwrapper(v->stamp), removed);
+
+        //the new event replaces the event at its location
+        event<> &previous = s.cell(v->x, v->y);
+        if(previous) {
+            if(removed) removed->push_back(previous);
+            previous = nullptr;
+            s.count--;
+        }
+
+        //removed events are left in q (as for the other surfaces). Drop them
+        //from the front, and compact q if they build up behind a long-lived
+        //event
+        while(s.q.size()) {
+            E *f = read_as<E>(s.q.front());
+            if(s.cell(f->x, f->y) == s.q.front()) break;
+            s.q.pop_front();
+        }
+
+        if(s.q.size() > 2 * (size_t)s.count + 1024) {
+            vQueue alive;
+            for(auto &qi : s.q) {
+                E *c = read_as<E>(qi);
+                if(s.cell(c->x, c->y) == qi) alive.push_back(qi);
+            }
+            s.q.swap(alive);
+        }
+    }
+};
+
 /******************************************************************************/
 
 /// \brief a spatio-temporal surface storing events for a limited time
@@ -124,15 +432,16 @@ class temporalSurface : public vSurface2
 {
 private:
 
-    int duration;
+    temporalExpiry expiry;
 
 public:
 
-    temporalSurface(int width = 128, int height = 128, int duration = 2.0 * vtsHelper::vtsscaler);
+    temporalSurface(int width = 128, int height = 128, int duration = 2.0 * vtsHelper::vtsscaler) :
+        vSurface2(width, height), expiry(duration) {}
     virtual vQueue removeEvents(event<> toAdd);
     virtual void fastRemoveEvents(event<> toAdd);
 
-    void setTemporalSize(int duration) {this->duration = duration;}
+    void setTemporalSize(int duration) {expiry.duration = duration;}
 
 };
 
@@ -143,36 +452,163 @@ class fixedSurface : public vSurface2
 {
 private:
 
-    int qlength;
+    fixedExpiry expiry;
 
 public:
 
     fixedSurface(int qlength = 2000, int width = 128, int height = 128)  :
-        vSurface2(width, height), qlength(qlength) {}
+        vSurface2(width, height), expiry(qlength) {}
     virtual vQueue removeEvents(event<> toAdd);
     virtual void fastRemoveEvents(event<> toAdd);
 
-    void setFixedWindowSize(int length) {this->qlength = length;}
+    void setFixedWindowSize(int length) {expiry.qlength = length;}
 };
 
 /******************************************************************************/
 
-/// \brief a spatio-temporal surface storing events for a "lifetime" given by
-/// the inverse of velocity
+/// \brief a spatio-temporal surface storing flow events for a "lifetime"
+/// given by the inverse of velocity (see lifetimeExpiry)
 class lifetimeSurface : public vSurface2
 {
+private:
+
+    lifetimeExpiry expiry;
+
+protected:
+
+    virtual void stored(event<> v);
 
 public:
 
-    lifetimeSurface(int width = 128, int height = 128) :
-        vSurface2(width, height) {}
+    lifetimeSurface(int width = 128, int height = 128, int bucket_bits = 10) :
+        vSurface2(width, height), expiry(bucket_bits) {}
     virtual vQueue addEvent(event<> toAdd);
+    virtual void fastAddEvent(event<> toAdd, bool onlyAdd = false);
     virtual vQueue removeEvents(event<> toAdd);
     virtual void fastRemoveEvents(event<> toAdd);
 };
 
 /******************************************************************************/
 
+/// \brief a surface with the sensor size (W x H), event type and expiry
+/// policy (temporalExpiry, fixedExpiry or lifetimeExpiry) fixed at compile
+/// time. The location of an event is a constant-stride offset, the policy is
+/// called directly rather than through virtuals, and the bounds check of x
+/// or y is compiled out when the event cannot hold an address outside the
+/// sensor. It is a vSurface2, so it can be used wherever the run-time
+/// surfaces are (see createSurface).
+template <typename P, int W, int H, typename E = AddressEvent>
+class staticSurface : public vSurface2
+{
+private:
+
+    P policy;
+
+    static const bool x_fits = (1 << E::xbits) <= W;
+    static const bool y_fits = (1 << E::ybits) <= H;
+
+    static bool inside(const E *c)
+    {
+        return (x_fits || c->x < W) && (y_fits || c->y < H);
+    }
+
+protected:
+
+    virtual void stored(event<> v) { policy.stored(*this, v); }
+
+public:
+
+    staticSurface(const P &policy = P()) : vSurface2(W, H), policy(policy) {}
+
+    /// \brief the expiry policy (e.g. to change its parameters)
+    P &getPolicy() { return policy; }
+
+    /// \brief the event stored at a location (no bounds check)
+    event<> &cell(int x, int y) { return spatial[y * W + x]; }
+
+    virtual vQueue addEvent(event<> v)
+    {
+        if(!policy.accepts(v)) return vQueue();
+        const E *c = read_as<E>(v);
+        if(!inside(c)) return vQueue();
+
+        vQueue removed;
+        policy.template remove<E>(*this, v, &removed);
+
+        q.push_back(v);
+        event<> &here = cell(c->x, c->y);
+        if(here)
+            removed.push_back(here);
+        else
+            count++;
+        here = v;
+        policy.stored(*this, v);
+        profile.holds(q.size());
+
+        return removed;
+    }
+
+    virtual void fastAddEvent(event<> v, bool onlyAdd = false)
+    {
+        if(!policy.accepts(v)) return;
+        const E *c = read_as<E>(v);
+        if(!inside(c)) return;
+
+        if(!onlyAdd)
+            policy.template remove<E>(*this, v, nullptr);
+
+        q.push_back(v);
+        event<> &here = cell(c->x, c->y);
+        if(!here) count++;
+        here = v;
+        policy.stored(*this, v);
+        profile.holds(q.size());
+    }
+
+    virtual vQueue removeEvents(event<> toAdd)
+    {
+        vQueue removed;
+        policy.template remove<E>(*this, toAdd, &removed);
+        return removed;
+    }
+
+    virtual void fastRemoveEvents(event<> toAdd)
+    {
+        policy.template remove<E>(*this, toAdd, nullptr);
+    }
+
+    using vSurface2::getSurf;
+    virtual vQueue getSurf(int xl, int xh, int yl, int yh)
+    {
+        vQueue qcopy;
+
+        xl = std::max(xl, 0);
+        xh = std::min(xh, W-1);
+        yl = std::max(yl, 0);
+        yh = std::min(yh, H-1);
+
+        for(int y = yl; y <= yh; y++) {
+            const event<> *row = spatial.data() + y * W;
+            for(int x = xl; x <= xh; x++)
+                if(row[x]) qcopy.push_back(row[x]);
+        }
+
+        EV_PROFILE_COPY(qcopy);
+        return qcopy;
+    }
+
+};
+
+/// \brief make a surface of type "temporal", "fixed" or "lifetime" with the
+/// parameter being the duration (in clock-ticks), the number of events or the
+/// bucket bits. The sensor sizes in use (128x128, 304x240 and 640x480) get a
+/// staticSurface and other sizes the run-time surfaces.
+/// \returns a new surface, or 0 if the type is not known
+vSurface2 *createSurface(std::string type, int width, int height,
+                         int parameter);
+
+/******************************************************************************/
+
 /// \brief a spatio-temporal surface storing events along edges as given by
 /// plane fitting
 class vEdge : public vSurface
@@ -94,6 +94,8 @@ protected:
     //!precalculated thresholds
     int tUpper;
     int tLower;
+    //! the events held, when profiling
+    vProfileSurface profile;
 
 public:
 
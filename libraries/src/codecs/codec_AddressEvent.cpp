@@ -64,7 +64,7 @@ AddressEvent::AddressEvent(const AddressEvent &v) : vEvent(v)
 
 event<> AddressEvent::clone()
 {
-    return std::make_shared<AddressEvent>(*this);
+    return std::allocate_shared<AddressEvent>(vEventAllocator<AddressEvent>(), *this);
 }
 
 void AddressEvent::encode(yarp::os::Bottle &b) const
@@ -42,7 +42,7 @@ FlowEvent::FlowEvent(const FlowEvent &v) : AddressEvent(v)
 
 event<> FlowEvent::clone()
 {
-    return std::make_shared<FlowEvent>(*this);
+    return std::allocate_shared<FlowEvent>(vEventAllocator<FlowEvent>(), *this);
 }
 
 void FlowEvent::encode(yarp::os::Bottle &b) const
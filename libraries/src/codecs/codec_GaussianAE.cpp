@@ -44,7 +44,7 @@ GaussianAE::GaussianAE(const GaussianAE &v) : LabelledAE(v)
 
 event<> GaussianAE::clone()
 {
-    return std::make_shared<GaussianAE>(*this);
+    return std::allocate_shared<GaussianAE>(vEventAllocator<GaussianAE>(), *this);
 }
 
 void GaussianAE::encode(yarp::os::Bottle &b) const
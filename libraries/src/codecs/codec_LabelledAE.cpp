@@ -40,7 +40,7 @@ LabelledAE::LabelledAE(const LabelledAE &v) : AddressEvent(v)
 
 event<> LabelledAE::clone()
 {
-    return std::make_shared<LabelledAE>(*this);
+    return std::allocate_shared<LabelledAE>(vEventAllocator<LabelledAE>(), *this);
 }
 
 void LabelledAE::encode(yarp::os::Bottle &b) const
@@ -41,7 +41,7 @@ SkinEvent::SkinEvent(const SkinEvent &v) : vEvent(v)
 
 event<> SkinEvent::clone()
 {
-    return std::make_shared<SkinEvent>(*this);
+    return std::allocate_shared<SkinEvent>(vEventAllocator<SkinEvent>(), *this);
 }
 
 void SkinEvent::encode(yarp::os::Bottle &b) const
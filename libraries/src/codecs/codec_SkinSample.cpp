@@ -42,7 +42,7 @@ SkinSample::SkinSample(const SkinSample &v) : SkinEvent(v)
 
 event<> SkinSample::clone()
 {
-    return std::make_shared<SkinSample>(*this);
+    return std::allocate_shared<SkinSample>(vEventAllocator<SkinSample>(), *this);
 }
 
 void SkinSample::encode(yarp::os::Bottle &b) const
@@ -0,0 +1,100 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "iCub/eventdriven/vCodec.h"
+#include "iCub/eventdriven/vtsHelper.h"
+
+namespace ev {
+
+const std::string WeightedAE::tag = "WAE";
+
+WeightedAE::WeightedAE() : AddressEvent(), subx(0), suby(0), weight(1) {}
+
+WeightedAE::WeightedAE(const vEvent &v) : AddressEvent(v)
+{
+    const WeightedAE * v2 = dynamic_cast<const WeightedAE *>(&v);
+    if(v2) {
+        subx = v2->subx;
+        suby = v2->suby;
+        weight = v2->weight;
+    } else {
+        subx = x * subpixel;
+        suby = y * subpixel;
+        weight = 1;
+    }
+}
+
+WeightedAE::WeightedAE(const WeightedAE &v) : AddressEvent(v)
+{
+    subx = v.subx;
+    suby = v.suby;
+    weight = v.weight;
+}
+
+event<> WeightedAE::clone()
+{
+    return std::allocate_shared<WeightedAE>(vEventAllocator<WeightedAE>(), *this);
+}
+
+void WeightedAE::encode(yarp::os::Bottle &b) const
+{
+    AddressEvent::encode(b);
+    b.addInt32(_waei[0]);
+    b.addInt32(_waei[1]);
+}
+
+void WeightedAE::encode(std::vector<int32_t> &b, unsigned int &pos) const
+{
+    AddressEvent::encode(b, pos);
+    b[pos++] = _waei[0];
+    b[pos++] = _waei[1];
+}
+
+void WeightedAE::decode(const int32_t *&data)
+{
+    AddressEvent::decode(data);
+    _waei[0] = *(data++);
+    _waei[1] = *(data++);
+}
+
+bool WeightedAE::decode(const yarp::os::Bottle &packet, size_t &pos)
+{
+    if (AddressEvent::decode(packet, pos) && pos + 2 <= packet.size())
+    {
+        _waei[0] = packet.get(pos++).asInt();
+        _waei[1] = packet.get(pos++).asInt();
+        return true;
+    }
+    return false;
+}
+
+yarp::os::Property WeightedAE::getContent() const
+{
+    yarp::os::Property prop = AddressEvent::getContent();
+    prop.put("subx", subx / (double)subpixel);
+    prop.put("suby", suby / (double)subpixel);
+    prop.put("weight", weight);
+    return prop;
+}
+
+std::string WeightedAE::getType() const
+{
+    return WeightedAE::tag;
+}
+
+}
@@ -33,7 +33,7 @@ vEvent::~vEvent() {}
 
 event<> vEvent::clone()
 {
-    return std::make_shared<vEvent>(*this);
+    return std::allocate_shared<vEvent>(vEventAllocator<vEvent>(), *this);
 }
 
 void vEvent::encode(yarp::os::Bottle &b) const
@@ -20,6 +20,7 @@
 #include <yarp/os/Bottle.h>
 #include "iCub/eventdriven/vCodec.h"
 #include "iCub/eventdriven/vtsHelper.h"
+#include "iCub/eventdriven/vMerge.h"
 
 namespace ev {
 
@@ -38,6 +39,8 @@ event<> createEvent(const std::string &type)
         return make_event<FlowEvent>();
     if(type == GaussianAE::tag)
         return make_event<GaussianAE>();
+    if(type == WeightedAE::tag)
+        return make_event<WeightedAE>();
     return event<>(nullptr);
 
 }
@@ -58,32 +61,18 @@ unsigned int packetSize(const std::string &type)
         return 4;
     if(type == GaussianAE::tag)
         return 6;
+    if(type == WeightedAE::tag)
+        return 4;
     return 0;
 
 
 }
 
-bool temporalSortStraight(const event<> &e1, const event<> &e2) {
-    return e2->stamp > e1->stamp;
-}
-
-bool temporalSortWrap(const event<> &e1, const event<> &e2)
-{
-
-    if((unsigned int)(std::abs(e1->stamp - e2->stamp)) > vtsHelper::max_stamp/2)
-        return e1->stamp > e2->stamp;
-    else
-        return e2->stamp > e1->stamp;
-
-}
-
 void qsort(vQueue &q, bool respectWraps)
 {
 
-    if(respectWraps)
-        std::sort(q.begin(), q.end(), temporalSortWrap);
-    else
-        std::sort(q.begin(), q.end(), temporalSortStraight);
+    vMerge sorter;
+    sorter.sort(q, respectWraps);
 
 }
 
@@ -0,0 +1,156 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "iCub/eventdriven/vMerge.h"
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <thread>
+
+namespace ev {
+
+//radix digits of 11 bits: 3 passes cover a batch spanning a full wrap
+static const unsigned int radix_bits = 11;
+static const unsigned int radix_size = 1 << radix_bits;
+//batches smaller than this are sorted by a single thread
+static const size_t parallel_min = 1 << 16;
+
+vMerge::vMerge(unsigned int threads)
+{
+    reference = 0;
+    referenced = false;
+    this->threads = std::max(threads, 1u);
+}
+
+void vMerge::computeOrder()
+{
+    if(runs.size() == 1) {
+        order.resize(keys.size());
+        for(size_t i = 0; i < order.size(); i++)
+            order[i] = i;
+    } else if(runs.size() > 16 + keys.size() / 64) {
+        radixOrder(keys, order, threads);
+    } else {
+        mergeOrder(keys, runs, order);
+    }
+}
+
+void vMerge::mergeOrder(const std::vector<int64_t> &keys,
+                        const std::vector<size_t> &runs,
+                        std::vector<uint32_t> &order)
+{
+    //the head of each run, ties taken from the earliest run
+    typedef std::pair<int64_t, size_t> head;
+    std::priority_queue<head, std::vector<head>, std::greater<head> > heads;
+
+    std::vector<size_t> pos(runs);
+    std::vector<size_t> end(runs.begin() + 1, runs.end());
+    end.push_back(keys.size());
+    for(size_t r = 0; r < runs.size(); r++)
+        heads.push(head(keys[pos[r]], r));
+
+    order.resize(keys.size());
+    size_t o = 0;
+    while(heads.size()) {
+        size_t r = heads.top().second;
+        heads.pop();
+        //take the run while it stays earliest
+        int64_t limit = heads.size() ? heads.top().first : keys.back();
+        bool last = heads.empty();
+        do {
+            order[o++] = pos[r]++;
+        } while(pos[r] < end[r] && (last || keys[pos[r]] < limit ||
+                (keys[pos[r]] == limit && r < heads.top().second)));
+        if(pos[r] < end[r])
+            heads.push(head(keys[pos[r]], r));
+    }
+}
+
+void vMerge::radixOrder(const std::vector<int64_t> &keys,
+                        std::vector<uint32_t> &order,
+                        unsigned int threads)
+{
+    size_t n = keys.size();
+    order.resize(n);
+    for(size_t i = 0; i < n; i++)
+        order[i] = i;
+    if(n < 2) return;
+
+    int64_t kmin = *std::min_element(keys.begin(), keys.end());
+    uint64_t span = *std::max_element(keys.begin(), keys.end()) - kmin;
+
+    if(n < parallel_min) threads = 1;
+    size_t chunk = (n + threads - 1) / threads;
+    std::vector<uint32_t> scratch(n);
+    std::vector< std::vector<size_t> > counts(threads,
+                                              std::vector<size_t>(radix_size));
+
+    for(unsigned int shift = 0; shift == 0 || (span >> shift); shift += radix_bits) {
+
+        //count the digits of each chunk
+        auto count = [&](unsigned int t) {
+            std::vector<size_t> &c = counts[t];
+            std::fill(c.begin(), c.end(), 0);
+            size_t end = std::min(n, (t + 1) * chunk);
+            for(size_t i = t * chunk; i < end; i++)
+                c[((keys[order[i]] - kmin) >> shift) & (radix_size - 1)]++;
+        };
+
+        //scatter each chunk to its own positions so the sort stays stable
+        auto scatter = [&](unsigned int t) {
+            std::vector<size_t> &c = counts[t];
+            size_t end = std::min(n, (t + 1) * chunk);
+            for(size_t i = t * chunk; i < end; i++) {
+                uint32_t j = order[i];
+                scratch[c[((keys[j] - kmin) >> shift) & (radix_size - 1)]++] = j;
+            }
+        };
+
+        if(threads == 1) {
+            count(0);
+        } else {
+            std::vector<std::thread> workers;
+            for(unsigned int t = 0; t < threads; t++)
+                workers.push_back(std::thread(count, t));
+            for(auto &w : workers) w.join();
+        }
+
+        //convert the counts into the first position of each (digit, chunk)
+        size_t total = 0;
+        for(size_t d = 0; d < radix_size; d++) {
+            for(unsigned int t = 0; t < threads; t++) {
+                size_t c = counts[t][d];
+                counts[t][d] = total;
+                total += c;
+            }
+        }
+
+        if(threads == 1) {
+            scatter(0);
+        } else {
+            std::vector<std::thread> workers;
+            for(unsigned int t = 0; t < threads; t++)
+                workers.push_back(std::thread(scatter, t));
+            for(auto &w : workers) w.join();
+        }
+
+        order.swap(scratch);
+    }
+}
+
+}
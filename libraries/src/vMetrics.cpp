@@ -0,0 +1,328 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "iCub/eventdriven/vMetrics.h"
+#include "iCub/eventdriven/vProfile.h"
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+namespace ev {
+
+double vHistogram::quantile(double q) const
+{
+    uint64_t total = count();
+    if(!total) return 0;
+
+    uint64_t target = (uint64_t)(q * total);
+    if(target >= total) target = total - 1;
+    uint64_t seen = 0;
+    for(int b = 0; b < n_buckets; b++) {
+        seen += buckets[b].load(std::memory_order_relaxed);
+        if(seen > target) return upperOf(b) * scale;
+    }
+    return upperOf(n_buckets - 1) * scale;
+}
+
+vMetrics::vMetrics()
+{
+    serving = false;
+    automatic = false;
+    users = 0;
+    const char *env = std::getenv("EV_METRICS");
+    if(env && *env) {
+        automatic = true;
+        std::ostringstream oss;
+        oss << env << "." << getpid() << ".prom";
+        filename = oss.str();
+    }
+    //the profile report is read from the same port
+    if(vProfiler::enabled())
+        automatic = true;
+}
+
+//the static metrics are destroyed after the yarp Network: nothing is saved or
+//closed here (see close())
+vMetrics::~vMetrics()
+{
+}
+
+vMetrics &vMetrics::get()
+{
+    static vMetrics metrics;
+    return metrics;
+}
+
+vMetrics::family &vMetrics::familyOf(const std::string &name,
+                                     const std::string &help, kind type)
+{
+    std::map<std::string, family>::iterator i = families.find(name);
+    if(i == families.end()) {
+        family &f = families[name];
+        f.type = type;
+        f.help = help;
+        return f;
+    }
+    if(i->second.type != type)
+        yWarning() << "Metric" << name << "registered with two types";
+    return i->second;
+}
+
+vCounter &vMetrics::counter(std::string name, std::string help,
+                            std::string labels)
+{
+    m.lock();
+    std::unique_ptr<vCounter> &c = familyOf(name, help, COUNTER).counters[labels];
+    if(!c) c.reset(new vCounter);
+    m.unlock();
+    return *c;
+}
+
+vGauge &vMetrics::gauge(std::string name, std::string help,
+                        std::string labels)
+{
+    m.lock();
+    std::unique_ptr<vGauge> &g = familyOf(name, help, GAUGE).gauges[labels];
+    if(!g) g.reset(new vGauge);
+    m.unlock();
+    return *g;
+}
+
+vHistogram &vMetrics::histogram(std::string name, std::string help,
+                                std::string labels, double scale)
+{
+    m.lock();
+    std::unique_ptr<vHistogram> &h =
+            familyOf(name, help, HISTOGRAM).histograms[labels];
+    if(!h) h.reset(new vHistogram(scale));
+    m.unlock();
+    return *h;
+}
+
+void vMetrics::registerThread(std::string name)
+{
+#ifdef __linux__
+    long tid = syscall(SYS_gettid);
+    m.lock();
+    //threads of the same name (e.g. workers) are numbered
+    int same = 0;
+    std::map<long, std::string>::iterator t;
+    for(t = threads.begin(); t != threads.end(); t++)
+        if(t->first != tid && !t->second.compare(0, name.size(), name) &&
+                (t->second.size() == name.size() || t->second[name.size()] == '#'))
+            same++;
+    if(same) {
+        std::ostringstream oss;
+        oss << name << "#" << same;
+        name = oss.str();
+    }
+    threads[tid] = name;
+    m.unlock();
+#else
+    yWarning() << "Thread cpu metrics are linux only";
+#endif
+}
+
+//the cpu time of a process or task, from utime and stime (fields 14 and 15
+//of its stat), or -1 if it cannot be read
+static double cpuOf(const std::string &stat_path)
+{
+    static const double ticks = sysconf(_SC_CLK_TCK);
+    std::ifstream stat(stat_path.c_str());
+    std::string line;
+    if(!std::getline(stat, line)) return -1;
+
+    //the name of the task is in brackets and can contain spaces
+    std::istringstream fields(line.substr(line.rfind(')') + 2));
+    std::string field;
+    unsigned long utime = 0, stime = 0;
+    for(int i = 3; i <= 15 && fields >> field; i++) {
+        if(i == 14) utime = std::strtoul(field.c_str(), 0, 10);
+        if(i == 15) stime = std::strtoul(field.c_str(), 0, 10);
+    }
+    return (utime + stime) / ticks;
+}
+
+double vMetrics::cpuSeconds()
+{
+    return cpuOf("/proc/self/stat");
+}
+
+void vMetrics::dumpThreads(std::ostream &oss)
+{
+    //(locked)
+    if(threads.empty()) return;
+
+    oss << "# HELP ev_thread_cpu_seconds_total cpu time used by a thread\n";
+    oss << "# TYPE ev_thread_cpu_seconds_total counter\n";
+    std::map<long, std::string>::iterator t;
+    for(t = threads.begin(); t != threads.end(); t++) {
+        std::ostringstream path;
+        path << "/proc/self/task/" << t->first << "/stat";
+        double seconds = cpuOf(path.str());
+        if(seconds < 0) continue;
+        oss << "ev_thread_cpu_seconds_total{thread=\"" << t->second << "\"} "
+            << seconds << "\n";
+    }
+}
+
+std::string vMetrics::dump(std::string prefix)
+{
+    static const double quantiles[3] = {0.5, 0.9, 0.99};
+    std::ostringstream oss;
+
+    m.lock();
+    std::map<std::string, family>::iterator i;
+    for(i = families.begin(); i != families.end(); i++) {
+        const std::string &name = i->first;
+        family &f = i->second;
+        if(name.compare(0, prefix.size(), prefix)) continue;
+
+        static const char *types[3] = {"counter", "gauge", "summary"};
+        oss << "# HELP " << name << " " << f.help << "\n";
+        oss << "# TYPE " << name << " " << types[f.type] << "\n";
+
+        for(auto &c : f.counters) {
+            oss << name;
+            if(c.first.size()) oss << "{" << c.first << "}";
+            oss << " " << c.second->value() << "\n";
+        }
+        for(auto &g : f.gauges) {
+            oss << name;
+            if(g.first.size()) oss << "{" << g.first << "}";
+            oss << " " << g.second->value() << "\n";
+        }
+        for(auto &h : f.histograms) {
+            std::string sep = h.first.size() ? h.first + "," : "";
+            for(int q = 0; q < 3; q++)
+                oss << name << "{" << sep << "quantile=\"" << quantiles[q]
+                    << "\"} " << h.second->quantile(quantiles[q]) << "\n";
+            std::string labels = h.first.size() ? "{" + h.first + "}" : "";
+            oss << name << "_sum" << labels << " " << h.second->sum() << "\n";
+            oss << name << "_count" << labels << " " << h.second->count() << "\n";
+        }
+    }
+    std::string cpu = "ev_thread_cpu_seconds_total";
+    if(!cpu.compare(0, prefix.size(), prefix))
+        dumpThreads(oss);
+    std::string process = "process_cpu_seconds_total";
+    double seconds = cpuSeconds();
+    if(!process.compare(0, prefix.size(), prefix) && seconds >= 0) {
+        oss << "# HELP process_cpu_seconds_total cpu time used by the process\n";
+        oss << "# TYPE process_cpu_seconds_total counter\n";
+        oss << "process_cpu_seconds_total " << seconds << "\n";
+    }
+    m.unlock();
+
+    return oss.str();
+}
+
+bool vMetrics::save(std::string filename)
+{
+    std::ofstream file(filename.c_str());
+    if(!file.is_open()) {
+        yError() << "Could not write metrics to" << filename;
+        return false;
+    }
+    file << dump();
+    return true;
+}
+
+std::string vMetrics::saveLocal(std::string name)
+{
+    //any rpc client can ask: only a plain file name in the working directory
+    if(name.empty() || name.find('/') != std::string::npos ||
+            name == "." || name == "..")
+        return "failed: give a file name (written in the working directory)";
+    return save(name) ? "ok" : "failed";
+}
+
+bool vMetrics::serve(std::string portname)
+{
+    if(serving) return true;
+    rpc.setReader(*this);
+    if(!rpc.open(portname)) {
+        yError() << "Could not open metrics port" << portname;
+        return false;
+    }
+    serving = true;
+    return true;
+}
+
+void vMetrics::serveFrom(std::string portname)
+{
+    m.lock();
+    users++;
+    m.unlock();
+    if(!automatic || serving) return;
+    //only the first port of a process decides the name
+    automatic = false;
+    size_t slash = portname.rfind('/');
+    std::string module = slash && slash != std::string::npos ?
+                portname.substr(0, slash) : portname;
+    serve(module + "/metrics:rpc");
+}
+
+void vMetrics::release()
+{
+    m.lock();
+    bool last = users > 0 && --users == 0;
+    m.unlock();
+    if(last) close();
+}
+
+void vMetrics::close()
+{
+    if(filename.size()) {
+        save(filename);
+        filename.clear();
+    }
+    if(!serving) return;
+    serving = false;
+    rpc.close();
+}
+
+bool vMetrics::read(yarp::os::ConnectionReader &connection)
+{
+    yarp::os::Bottle command, reply;
+    if(!command.read(connection))
+        return false;
+
+    std::string c = command.get(0).asString();
+    if(c == "get")
+        reply.addString(dump(command.get(1).asString()));
+    else if(c == "profile")
+        reply.addString(vProfiler::report());
+    else if(c == "save")
+        reply.addString(saveLocal(command.get(1).asString()));
+    else if(c == "metrics" || command.size() == 0)
+        reply.addString(dump());
+    else
+        reply.addString("commands: metrics | get <name> | save <file> | profile");
+
+    yarp::os::ConnectionWriter *writer = connection.getWriter();
+    if(writer)
+        reply.write(*writer);
+    return true;
+}
+
+}
@@ -0,0 +1,310 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "iCub/eventdriven/vProfile.h"
+#include <yarp/os/all.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include <unistd.h>
+#ifdef __linux__
+#include <dlfcn.h>
+#include <cxxabi.h>
+#endif
+
+namespace ev {
+
+namespace {
+
+const unsigned int lifetime_sampling = 16;
+
+struct profile {
+    yarp::os::Mutex m;
+    std::chrono::steady_clock::time_point start;
+    std::string filename;
+    std::map<std::pair<std::string, std::string>,
+             std::unique_ptr<vProfiler::allocations> > allocations;
+    std::map<std::pair<const char *, void *>,
+             std::unique_ptr<vProfiler::site> > sites;
+    std::vector<std::unique_ptr<vProfiler::surface> > surfaces;
+
+    profile() : start(std::chrono::steady_clock::now()) {}
+};
+
+//never destroyed, so the events released while the process exits are still
+//counted
+profile &state()
+{
+    static profile *p = new profile;
+    return *p;
+}
+
+uint64_t microseconds()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - state().start).count();
+}
+
+struct reporter {
+    ~reporter()
+    {
+        if(state().filename.size())
+            vProfiler::save(state().filename);
+    }
+};
+
+std::string moduleName()
+{
+    std::string name = "unknown";
+#ifdef __linux__
+    std::ifstream comm("/proc/self/comm");
+    std::getline(comm, name);
+#endif
+    return name;
+}
+
+std::string callerName(void *caller)
+{
+    std::ostringstream oss;
+#ifdef __linux__
+    Dl_info info;
+    if(dladdr(caller, &info)) {
+        if(info.dli_sname) {
+            int status = 0;
+            char *name = abi::__cxa_demangle(info.dli_sname, 0, 0, &status);
+            oss << (status == 0 && name ? name : info.dli_sname) << "+0x"
+                << std::hex << ((char *)caller - (char *)info.dli_saddr);
+            std::free(name);
+            return oss.str();
+        }
+        //no symbol: the offset in the binary, for addr2line
+        if(info.dli_fname) {
+            oss << info.dli_fname << "+0x" << std::hex
+                << ((char *)caller - (char *)info.dli_fbase);
+            return oss.str();
+        }
+    }
+#endif
+    oss << caller;
+    return oss.str();
+}
+
+std::string lifetimeOf(uint64_t us)
+{
+    std::ostringstream oss;
+    if(us < 1000) oss << us << "us";
+    else if(us < 1000000) oss << us / 1000 << "ms";
+    else oss << us / 1000000 << "s";
+    return oss.str();
+}
+
+//the upper bound of the bucket holding the median lifetime
+std::string medianOf(const vProfiler::allocations &a)
+{
+    uint64_t total = 0;
+    for(int b = 0; b < 32; b++)
+        total += a.lifetimes[b].load(std::memory_order_relaxed);
+    if(!total) return "-";
+    uint64_t seen = 0;
+    int b = 0;
+    for(; b < 31; b++) {
+        seen += a.lifetimes[b].load(std::memory_order_relaxed);
+        if(seen * 2 >= total) break;
+    }
+    return "<" + lifetimeOf(2ull << b);
+}
+
+}
+
+bool vProfiler::startup()
+{
+    const char *env = std::getenv("EV_PROFILE");
+    if(!env || !*env) return false;
+
+    profile &p = state();
+    if(std::string(env) != "1") {
+        std::ostringstream oss;
+        oss << env << "." << getpid() << ".txt";
+        p.filename = oss.str();
+    }
+    static reporter r;
+    return true;
+}
+
+vProfiler::allocations &vProfiler::allocationsOf(const std::string &kind,
+                                                 const std::string &type)
+{
+    profile &p = state();
+    p.m.lock();
+    std::unique_ptr<allocations> &a = p.allocations[std::make_pair(kind, type)];
+    if(!a) {
+        a.reset(new allocations());
+        a->kind = kind;
+        a->type = type;
+    }
+    p.m.unlock();
+    return *a;
+}
+
+uint64_t vProfiler::allocated(allocations &a, size_t bytes)
+{
+    a.allocated.fetch_add(1, std::memory_order_relaxed);
+    a.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    a.live_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    //reading the clock costs as much as the counting, so only the lifetimes
+    //of one in lifetime_sampling allocations are measured
+    static thread_local unsigned int n = 0;
+    if(++n % lifetime_sampling) return 0;
+    return microseconds() + 1;
+}
+
+void vProfiler::freed(allocations &a, size_t bytes, uint64_t since)
+{
+    a.freed.fetch_add(1, std::memory_order_relaxed);
+    a.live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    if(!since) return;
+    uint64_t lifetime = microseconds() + 1 - since;
+    int b = lifetime < 2 ? 0 : 63 - __builtin_clzll(lifetime);
+    a.lifetimes[std::min(b, 31)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void vProfiler::copied(const char *function, void *caller, size_t n)
+{
+    profile &p = state();
+    p.m.lock();
+    std::unique_ptr<site> &s = p.sites[std::make_pair(function, caller)];
+    if(!s) {
+        s.reset(new site());
+        s->function = function;
+        s->caller = caller;
+    }
+    p.m.unlock();
+    s->calls.fetch_add(1, std::memory_order_relaxed);
+    s->events.fetch_add(n, std::memory_order_relaxed);
+}
+
+vProfiler::surface *vProfiler::surfaceOf(const std::string &name)
+{
+    if(!enabled()) return nullptr;
+    profile &p = state();
+    p.m.lock();
+    p.surfaces.push_back(std::unique_ptr<surface>(new surface()));
+    surface *s = p.surfaces.back().get();
+    std::ostringstream oss;
+    oss << name << "#" << p.surfaces.size();
+    s->name = oss.str();
+    s->alive = true;
+    p.m.unlock();
+    return s;
+}
+
+void vProfiler::release(surface *s)
+{
+    if(!s) return;
+    profile &p = state();
+    p.m.lock();
+    s->alive = false;
+    s->events.store(0, std::memory_order_relaxed);
+    p.m.unlock();
+}
+
+std::string vProfiler::report()
+{
+    std::ostringstream oss;
+    if(!enabled()) {
+        oss << "profiling is off (set EV_PROFILE)\n";
+        return oss.str();
+    }
+
+    profile &p = state();
+    p.m.lock();
+
+    oss << "eventdriven profile of " << moduleName() << " (pid " << getpid()
+        << ") after " << microseconds() / 1000000.0 << "s\n";
+
+    //allocations ranked by bytes
+    std::vector<allocations *> a;
+    for(auto &i : p.allocations) a.push_back(i.second.get());
+    std::sort(a.begin(), a.end(), [](allocations *l, allocations *r) {
+        return l->bytes.load() > r->bytes.load(); });
+
+    oss << "\n" << std::left << std::setw(24) << "allocations" << std::right
+        << std::setw(14) << "count" << std::setw(12) << "live"
+        << std::setw(16) << "bytes" << std::setw(14) << "live bytes"
+        << std::setw(12) << "lifetime" << "\n";
+    for(size_t i = 0; i < a.size(); i++) {
+        uint64_t n = a[i]->allocated.load(), f = a[i]->freed.load();
+        oss << std::left << std::setw(24) << a[i]->kind + " " + a[i]->type
+            << std::right << std::setw(14) << n << std::setw(12) << n - f
+            << std::setw(16) << a[i]->bytes.load()
+            << std::setw(14) << a[i]->live_bytes.load()
+            << std::setw(12) << medianOf(*a[i]) << "\n";
+    }
+
+    //vQueue copies ranked by events copied
+    std::vector<site *> s;
+    for(auto &i : p.sites) s.push_back(i.second.get());
+    std::sort(s.begin(), s.end(), [](site *l, site *r) {
+        return l->events.load() > r->events.load(); });
+
+    //(see EV_PROFILE_COPY) the caller of an inlined header function is the
+    //caller of the function it was inlined into
+    oss << "\n" << std::left << std::setw(60) << "vQueue copies" << std::right
+        << std::setw(12) << "calls" << std::setw(14) << "events"
+        << std::setw(10) << "mean" << "\n";
+    oss << "(function <- caller; the caller of a function inlined from a "
+           "header may be the code it was inlined into)\n";
+    for(size_t i = 0; i < s.size(); i++) {
+        uint64_t calls = s[i]->calls.load(), events = s[i]->events.load();
+        oss << std::left << std::setw(60)
+            << s[i]->function + " <- " + callerName(s[i]->caller)
+            << std::right << std::setw(12) << calls << std::setw(14) << events
+            << std::setw(10) << (calls ? events / calls : 0) << "\n";
+    }
+
+    oss << "\n" << std::left << std::setw(24) << "surfaces" << std::right
+        << std::setw(12) << "events" << std::setw(12) << "peak" << "\n";
+    for(size_t i = 0; i < p.surfaces.size(); i++) {
+        surface &f = *p.surfaces[i];
+        oss << std::left << std::setw(24) << f.name << std::right
+            << std::setw(12) << f.events.load() << std::setw(12)
+            << f.peak.load() << (f.alive ? "" : " (destroyed)") << "\n";
+    }
+
+    p.m.unlock();
+    return oss.str();
+}
+
+bool vProfiler::save(std::string filename)
+{
+    std::ofstream file(filename.c_str());
+    if(!file.is_open()) {
+        yError() << "Could not write the profile to" << filename;
+        return false;
+    }
+    file << report();
+    return true;
+}
+
+}
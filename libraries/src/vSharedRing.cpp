@@ -0,0 +1,420 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "iCub/eventdriven/vSharedRing.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <atomic>
+#include <cstring>
+#include <new>
+
+namespace ev {
+
+static const uint32_t ring_magic = 0x65765353;
+static const uint32_t record_padding = 0xFFFFFFFF;
+
+//lives at the start of the shared memory, followed by the ring data
+struct sharedRingHeader {
+    std::atomic<uint32_t> magic;
+    std::atomic<uint32_t> closed;
+    uint32_t capacity;
+    int32_t writer;                 //pid of the writer process
+    std::atomic<uint64_t> head;     //bytes committed by the writer
+    std::atomic<uint64_t> reserve;  //bytes committed + bytes being written
+    std::atomic<uint64_t> last;     //position of the most recent packet
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+};
+
+//precedes each packet in the ring
+struct sharedRecord {
+    uint32_t bytes;      //record size including this header
+    uint32_t type_len;   //record_padding marks the unused end of the ring
+    uint32_t data_bytes;
+    int32_t stamp_count;
+    double stamp_time;
+    uint64_t seq;
+};
+
+static inline uint32_t align8(uint32_t n) { return (n + 7) & ~7u; }
+static inline size_t dataOffset() { return (sizeof(sharedRingHeader) + 63) & ~(size_t)63; }
+
+static int lockRobust(pthread_mutex_t *m)
+{
+    int r = pthread_mutex_lock(m);
+    if(r == EOWNERDEAD) { //a process died holding the lock
+        pthread_mutex_consistent(m);
+        r = 0;
+    }
+    return r;
+}
+
+std::string vSharedRing::sharedName(std::string port_name)
+{
+    for(size_t i = 0; i < port_name.size(); i++)
+        if(port_name[i] == '/') port_name[i] = '_';
+    return "/ev" + port_name;
+}
+
+vSharedRing::vSharedRing()
+{
+    owner = false;
+    fd = -1;
+    mapped_bytes = 0;
+    header = nullptr;
+    ring = nullptr;
+    cursor = 0;
+    last_seq = 0;
+    lost = 0;
+    interrupted = false;
+}
+
+vSharedRing::~vSharedRing()
+{
+    close();
+}
+
+bool vSharedRing::map(size_t bytes, bool create)
+{
+    if(create) {
+        shm_unlink(shm_name.c_str()); //remove a stale ring of a dead writer
+        fd = shm_open(shm_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+    } else {
+        fd = shm_open(shm_name.c_str(), O_RDWR, 0);
+    }
+    if(fd < 0)
+        return false;
+
+    if(create) {
+        if(ftruncate(fd, bytes) < 0) {
+            yError() << "Could not size shared memory" << shm_name
+                     << std::strerror(errno);
+            ::close(fd); fd = -1;
+            return false;
+        }
+    } else {
+        struct stat shm_stat;
+        if(fstat(fd, &shm_stat) < 0 || (size_t)shm_stat.st_size <= dataOffset()) {
+            ::close(fd); fd = -1;
+            return false;
+        }
+        bytes = shm_stat.st_size;
+    }
+
+    void *addr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(addr == MAP_FAILED) {
+        yError() << "Could not map shared memory" << shm_name
+                 << std::strerror(errno);
+        ::close(fd); fd = -1;
+        return false;
+    }
+
+    mapped_bytes = bytes;
+    header = (sharedRingHeader *)addr;
+    ring = (char *)addr + dataOffset();
+    return true;
+}
+
+//the writer only marks the ring closed if it exits cleanly
+bool vSharedRing::writerAlive() const
+{
+    return kill(header->writer, 0) == 0 || errno != ESRCH;
+}
+
+bool vSharedRing::create(std::string port_name, unsigned int capacity_bytes)
+{
+    close();
+    owner = true;
+    shm_name = sharedName(port_name);
+
+    capacity_bytes &= ~7u;
+    if(!map(dataOffset() + capacity_bytes, true)) {
+        yError() << "Could not create shared memory" << shm_name;
+        owner = false;
+        return false;
+    }
+
+    new (header) sharedRingHeader;
+    header->closed = 0;
+    header->capacity = capacity_bytes;
+    header->writer = getpid();
+    header->head = 0;
+    header->reserve = 0;
+    header->last = 0;
+
+    pthread_mutexattr_t mattr;
+    pthread_mutexattr_init(&mattr);
+    pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&mattr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&header->mutex, &mattr);
+    pthread_mutexattr_destroy(&mattr);
+
+    pthread_condattr_t cattr;
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+    pthread_cond_init(&header->cond, &cattr);
+    pthread_condattr_destroy(&cattr);
+
+    header->magic.store(ring_magic, std::memory_order_release);
+
+    yInfo() << "Shared memory ring" << shm_name << "of" << capacity_bytes
+            << "bytes";
+    return true;
+}
+
+bool vSharedRing::attach(std::string port_name)
+{
+    close();
+    owner = false;
+    shm_name = sharedName(port_name);
+
+    if(!map(0, false))
+        return false;
+
+    if(header->magic.load(std::memory_order_acquire) != ring_magic ||
+            header->closed || !writerAlive()) {
+        close();
+        return false;
+    }
+
+    cursor = header->head.load(std::memory_order_acquire);
+    last_seq = 0;
+    interrupted = false;
+    return true;
+}
+
+void vSharedRing::close()
+{
+    if(!header) return;
+
+    if(owner) {
+        header->closed = 1;
+        if(!lockRobust(&header->mutex)) {
+            pthread_cond_broadcast(&header->cond);
+            pthread_mutex_unlock(&header->mutex);
+        }
+        shm_unlink(shm_name.c_str());
+    }
+
+    munmap(header, mapped_bytes);
+    ::close(fd);
+    fd = -1;
+    header = nullptr;
+    ring = nullptr;
+    mapped_bytes = 0;
+}
+
+bool vSharedRing::write(const std::string &type, const char *data,
+                        unsigned int data_bytes,
+                        const yarp::os::Stamp &envelope)
+{
+    if(!header || !owner) return false;
+
+    const uint32_t capacity = header->capacity;
+    uint32_t bytes = sizeof(sharedRecord) + align8(type.size()) + align8(data_bytes);
+    if(bytes > capacity / 2) {
+        yError() << "Packet of" << data_bytes << "bytes is too large for"
+                 << shm_name;
+        return false;
+    }
+
+    uint64_t head = header->head.load(std::memory_order_relaxed);
+    uint64_t pos = head % capacity;
+    uint64_t skip = 0;
+    if(capacity - pos < bytes)
+        skip = capacity - pos;
+
+    //readers check this after copying to know if their data was overwritten
+    header->reserve.store(head + skip + bytes, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if(skip) {
+        if(skip >= sizeof(sharedRecord)) {
+            sharedRecord *pad = (sharedRecord *)(ring + pos);
+            pad->bytes = skip;
+            pad->type_len = record_padding;
+            pad->data_bytes = 0;
+        }
+        head += skip;
+        pos = 0;
+    }
+
+    sharedRecord *r = (sharedRecord *)(ring + pos);
+    r->bytes = bytes;
+    r->type_len = type.size();
+    r->data_bytes = data_bytes;
+    r->stamp_count = envelope.getCount();
+    r->stamp_time = envelope.getTime();
+    r->seq = ++last_seq;
+    char *payload = ring + pos + sizeof(sharedRecord);
+    std::memcpy(payload, type.data(), type.size());
+    std::memcpy(payload + align8(type.size()), data, data_bytes);
+
+    header->last.store(head, std::memory_order_relaxed);
+    header->head.store(head + bytes, std::memory_order_release);
+
+    if(!lockRobust(&header->mutex)) {
+        pthread_cond_broadcast(&header->cond);
+        pthread_mutex_unlock(&header->mutex);
+    }
+
+    return true;
+}
+
+bool vSharedRing::read(std::string &type, std::vector<int32_t> &data,
+                       unsigned int &n_ints, yarp::os::Stamp &envelope)
+{
+    while(!interrupted) {
+
+        //the writer has not yet started, or has restarted
+        if(!header || header->closed) {
+            if(header) close();
+            if(!map(0, false)) {
+                yarp::os::Time::delay(0.1);
+                continue;
+            }
+            if(header->magic.load(std::memory_order_acquire) != ring_magic ||
+                    header->closed || !writerAlive()) {
+                close();
+                yarp::os::Time::delay(0.1);
+                continue;
+            }
+            cursor = header->head.load(std::memory_order_acquire);
+            last_seq = 0;
+        }
+
+        const uint32_t capacity = header->capacity;
+        uint64_t head = header->head.load(std::memory_order_acquire);
+
+        //wait for the writer
+        if(head == cursor) {
+            int error = lockRobust(&header->mutex);
+            if(error) {
+                //e.g. ENOTRECOVERABLE: retrying would spin
+                yError() << "Could not lock shared memory" << shm_name
+                         << std::strerror(error);
+                return false;
+            }
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += 100000000;
+            if(deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+            while(!interrupted && !header->closed &&
+                  header->head.load(std::memory_order_acquire) == cursor) {
+                int r = pthread_cond_timedwait(&header->cond, &header->mutex,
+                                               &deadline);
+                if(r == EOWNERDEAD) pthread_mutex_consistent(&header->mutex);
+                else if(r) break; //timed out (or failed)
+            }
+            pthread_mutex_unlock(&header->mutex);
+
+            //a restarted writer creates a new ring, so detach from the ring
+            //of a dead one
+            if(header->head.load(std::memory_order_acquire) == cursor &&
+                    !writerAlive()) {
+                yWarning() << "The writer of" << shm_name << "died - waiting"
+                           << "for it to restart";
+                close();
+            }
+            continue;
+        }
+
+        //overrun: we were lapped by the writer
+        if(head - cursor > capacity) {
+            cursor = header->last.load(std::memory_order_acquire);
+            continue;
+        }
+
+        uint64_t pos = cursor % capacity;
+        uint64_t remaining = capacity - pos;
+        if(remaining < sizeof(sharedRecord)) {
+            cursor += remaining;
+            continue;
+        }
+
+        sharedRecord r;
+        std::memcpy(&r, ring + pos, sizeof(sharedRecord));
+        bool sane = r.bytes <= remaining &&
+                (r.type_len == record_padding ||
+                 sizeof(sharedRecord) + align8(r.type_len) + r.data_bytes <= r.bytes);
+
+        if(sane && r.type_len != record_padding) {
+            const char *payload = ring + pos + sizeof(sharedRecord);
+            type.assign(payload, r.type_len);
+            n_ints = r.data_bytes / sizeof(int32_t);
+            if(data.size() < n_ints)
+                data.resize(n_ints);
+            std::memcpy(data.data(), payload + align8(r.type_len), r.data_bytes);
+        }
+
+        //check the writer did not overwrite the record while we copied it
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(header->reserve.load(std::memory_order_relaxed) - cursor > capacity) {
+            cursor = header->last.load(std::memory_order_acquire);
+            continue;
+        }
+
+        if(!sane) {
+            yError() << "Corrupt packet in" << shm_name << "- resynchronising";
+            cursor = header->last.load(std::memory_order_acquire);
+            continue;
+        }
+
+        if(r.type_len == record_padding) {
+            cursor += remaining;
+            continue;
+        }
+
+        cursor += r.bytes;
+        if(last_seq && r.seq > last_seq + 1)
+            lost += r.seq - last_seq - 1;
+        last_seq = r.seq;
+        envelope = yarp::os::Stamp(r.stamp_count, r.stamp_time);
+        return true;
+    }
+
+    return false;
+}
+
+void vSharedRing::interrupt()
+{
+    interrupted = true;
+    if(header && !lockRobust(&header->mutex)) {
+        pthread_cond_broadcast(&header->cond);
+        pthread_mutex_unlock(&header->mutex);
+    }
+}
+
+unsigned int vSharedRing::queryLost()
+{
+    unsigned int n = lost;
+    lost = 0;
+    return n;
+}
+
+}
@@ -0,0 +1,203 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "iCub/eventdriven/vTrace.h"
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace ev {
+
+static const char *point_names[vTracer::N_POINTS] = {"received", "read", "written"};
+
+vTracer::vTracer()
+{
+    active = false;
+    next = 0;
+    users = 0;
+    for(int s = 0; s < max_stages; s++)
+        for(int p = 0; p < N_POINTS; p++)
+            for(int b = 0; b < n_buckets; b++)
+                ages[s][p][b] = 0;
+
+    const char *env_file = std::getenv("EV_TRACE");
+    if(env_file && *env_file) {
+        const char *env_size = std::getenv("EV_TRACE_SIZE");
+        unsigned int capacity = env_size ? std::atoi(env_size) : 0;
+        open(env_file, capacity ? capacity : 1 << 20);
+    }
+}
+
+//the static tracer is destroyed after the yarp Network: the trace is saved by
+//close()
+vTracer::~vTracer()
+{
+}
+
+vTracer &vTracer::get()
+{
+    static vTracer tracer;
+    return tracer;
+}
+
+bool vTracer::open(std::string filename, unsigned int capacity)
+{
+    if(active) return false;
+
+    //one file per process, as every module of a pipeline can be traced
+    std::ostringstream oss;
+    oss << filename << "." << getpid() << ".json";
+    this->filename = oss.str();
+    ring.resize(capacity ? capacity : 1);
+    next = 0;
+    active = true;
+    yInfo() << "Tracing packets to" << this->filename;
+    return true;
+}
+
+int vTracer::stage(std::string name)
+{
+    names_mutex.lock();
+    int s = -1;
+    for(size_t i = 0; i < names.size(); i++)
+        if(names[i] == name) s = i;
+    if(s < 0 && names.size() < (size_t)max_stages) {
+        names.push_back(name);
+        s = names.size() - 1;
+    }
+    users++;
+    names_mutex.unlock();
+    return s;
+}
+
+void vTracer::release()
+{
+    names_mutex.lock();
+    bool last = users > 0 && --users == 0;
+    names_mutex.unlock();
+    if(last) close();
+}
+
+void vTracer::close()
+{
+    if(!active.exchange(false)) return;
+    if(filename.size())
+        save();
+}
+
+void vTracer::push(int stage, point p, const yarp::os::Stamp &envelope,
+                   int events, int depth)
+{
+    record &r = ring[next.fetch_add(1) % ring.size()];
+    r.time = yarp::os::Time::now();
+    r.origin = envelope.isValid() ? envelope.getTime() : 0;
+    r.packet = envelope.getCount();
+    r.events = events;
+    r.depth = depth;
+    r.stage = stage;
+    r.point = p;
+
+    if(!r.origin) return;
+    double age = (r.time - r.origin) * 1e6;
+    int b = 0;
+    while(b < n_buckets - 1 && age >= (double)(2ull << b)) b++;
+    ages[stage][p][b]++;
+}
+
+bool vTracer::save(std::string filename)
+{
+    if(filename.empty()) filename = this->filename;
+    std::ofstream file(filename.c_str());
+    if(!file.is_open()) {
+        yError() << "Could not write trace to" << filename;
+        return false;
+    }
+
+    int pid = getpid();
+    file << "{\"traceEvents\":[\n";
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid
+         << ",\"args\":{\"name\":\"" << pid << "\"}}";
+
+    names_mutex.lock();
+    std::vector<std::string> stages = names;
+    names_mutex.unlock();
+    for(size_t s = 0; s < stages.size(); s++)
+        file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+             << ",\"tid\":" << s << ",\"args\":{\"name\":\"" << stages[s]
+             << "\"}}";
+
+    unsigned long n = next;
+    unsigned long first = n > ring.size() ? n - ring.size() : 0;
+    file.precision(3);
+    file << std::fixed;
+    for(unsigned long i = first; i < n; i++) {
+        const record &r = ring[i % ring.size()];
+        file << ",\n{\"name\":\"" << point_names[r.point]
+             << "\",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << r.time * 1e6
+             << ",\"pid\":" << pid << ",\"tid\":" << r.stage
+             << ",\"args\":{\"packet\":" << r.packet
+             << ",\"events\":" << r.events << ",\"depth\":" << r.depth;
+        if(r.origin)
+            file << ",\"age_ms\":" << (r.time - r.origin) * 1e3;
+        file << "}}";
+        if(r.point != WRITTEN)
+            file << ",\n{\"name\":\"depth\",\"ph\":\"C\",\"ts\":"
+                 << r.time * 1e6 << ",\"pid\":" << pid << ",\"args\":{\""
+                 << stages[r.stage] << "\":" << r.depth << "}}";
+    }
+    file << "\n]}\n";
+
+    yInfo() << "Saved" << n - first << "trace records to" << filename;
+    yInfo() << latencyStats();
+    return true;
+}
+
+std::string vTracer::latencyStats()
+{
+    std::ostringstream oss;
+    oss.precision(3);
+    oss << std::fixed;
+
+    names_mutex.lock();
+    for(size_t s = 0; s < names.size(); s++) {
+        for(int p = 0; p < N_POINTS; p++) {
+            unsigned long long total = 0;
+            for(int b = 0; b < n_buckets; b++)
+                total += ages[s][p][b];
+            if(!total) continue;
+
+            //the upper edge of the bucket holding the percentile
+            double median = 0, p99 = 0;
+            unsigned long long count = 0;
+            for(int b = 0; b < n_buckets; b++) {
+                count += ages[s][p][b];
+                if(!median && count * 2 >= total) median = (2ull << b) * 1e-3;
+                if(!p99 && count * 100 >= total * 99) p99 = (2ull << b) * 1e-3;
+            }
+            oss << names[s] << " " << point_names[p] << ": " << median
+                << " ms (median) " << p99 << " ms (99%) of " << total
+                << " packets\n";
+        }
+    }
+    names_mutex.unlock();
+
+    return oss.str();
+}
+
+}
@@ -18,24 +18,22 @@
 
 #include "iCub/eventdriven/vWindow_adv.h"
 #include <math.h>
+#include <climits>
 
 namespace ev {
 
-vSurface2::vSurface2(int width, int height)
+vSurface2::vSurface2(int width, int height) : profile("vSurface2")
 {
     this->width = width;
     this->height = height;
     this->count = 0;
 
-    spatial.resize(height);
-    for(int y = 0; y < height; y++) {
-        spatial[y].resize(width);
-    }
+    spatial.resize(width * height);
 }
 
 void vSurface2::fastAddEvent(event <> v, bool onlyAdd)
 {
-    auto c = as_event<AE>(v);
+    const AE *c = read_as<AE>(v);
     if(c->y >= height || c->x >= width) {
         return;
     }
@@ -45,10 +43,13 @@ void vSurface2::fastAddEvent(event <> v, bool onlyAdd)
 
     q.push_back(v);
 
-    if(!spatial[c->y][c->x])
+    event<> &here = cell(c->x, c->y);
+    if(!here)
         count++;
 
-    spatial[c->y][c->x] = c;
+    here = v;
+    stored(v);
+    profile.holds(q.size());
 
     return;
 
@@ -68,13 +69,15 @@ vQueue vSurface2::addEvent(event<> v)
     q.push_back(v);
     if(c) {
 
-        if(spatial[c->y][c->x])
-            removed.push_back(spatial[c->y][c->x]);
+        if(cell(c->x, c->y))
+            removed.push_back(cell(c->x, c->y));
         else
             count++;
 
-        spatial[c->y][c->x] = c;
+        cell(c->x, c->y) = c;
+        stored(v);
     }
+    profile.holds(q.size());
 
     return removed;
 
@@ -114,8 +117,9 @@ vQueue vSurface2::getSurf(int xl, int xh, int yl, int yh)
 
     for(int y = yl; y <= yh; y++)
         for(int x = xl; x <= xh; x++)
-            if(spatial[y][x]) qcopy.push_back(spatial[y][x]);
+            if(cell(x, y)) qcopy.push_back(cell(x, y));
 
+    EV_PROFILE_COPY(qcopy);
     return qcopy;
 
 }
@@ -129,7 +133,7 @@ void vSurface2::getSurfSorted(vQueue &fillq)
     vQueue::reverse_iterator rqit;
     for(rqit = q.rbegin(); rqit != q.rend(); rqit++) {
         event<AddressEvent> v = std::static_pointer_cast<AddressEvent>(*rqit);
-        if(v != spatial[v->y][v->x]) continue;
+        if(v != cell(v->x, v->y)) continue;
         fillq[i++] = v;
     }
 }
@@ -145,7 +149,7 @@ vQueue vSurface2::getSurf_Tlim(int dt)
 
         //check it is on the surface
         event<AddressEvent> v = std::static_pointer_cast<AddressEvent>(*rqit);
-        if(v != spatial[v->y][v->x]) continue;
+        if(v != cell(v->x, v->y)) continue;
 
         //check temporal constraint
         int vt = (*rqit)->stamp;
@@ -155,6 +159,7 @@ vQueue vSurface2::getSurf_Tlim(int dt)
         qcopy.push_back(v);
     }
 
+    EV_PROFILE_COPY(qcopy);
     return qcopy;
 }
 
@@ -189,7 +194,7 @@ vQueue vSurface2::getSurf_Tlim(int dt, int xl, int xh, int yl, int yh)
 
         //check it is on the surface
         event<AddressEvent> v = std::static_pointer_cast<AddressEvent>(*rqit);
-        if(v != spatial[v->y][v->x]) continue;
+        if(v != cell(v->x, v->y)) continue;
 
         //check temporal constraint
         int vt = (*rqit)->stamp;
@@ -204,6 +209,7 @@ vQueue vSurface2::getSurf_Tlim(int dt, int xl, int xh, int yl, int yh)
         }
     }
 
+    EV_PROFILE_COPY(qcopy);
     return qcopy;
 }
 
@@ -243,7 +249,7 @@ vQueue vSurface2::getSurf_Clim(int c, int xl, int xh, int yl, int yh)
 
     for(int y = yl; y <= yh; y++) {
         for(int x = xl; x <= xh; x++) {
-            if(spatial[y][x]) qcopy.push_back(spatial[y][x]);
+            if(cell(x, y)) qcopy.push_back(cell(x, y));
         }
     }
 
@@ -251,6 +257,7 @@ vQueue vSurface2::getSurf_Clim(int c, int xl, int xh, int yl, int yh)
     while(qcopy.size() > (unsigned int)c)
         qcopy.pop_front();
 
+    EV_PROFILE_COPY(qcopy);
     return qcopy;
 }
 
@@ -262,164 +269,29 @@ event<> vSurface2::getMostRecent()
 }
 
 /******************************************************************************/
-temporalSurface::temporalSurface(int width, int height, int duration) : vSurface2(width, height)
-{
-    //whichever is smaller 2 seconds or ~1/2 of the maximum window
-    this->duration = std::min(duration, (int)(vtsHelper::max_stamp * 0.45));
-}
-
 vQueue temporalSurface::removeEvents(event<> toAdd)
 {
     vQueue removed;
-
-    //calculate event window boundaries based on latest timestamp
-    int ctime = toAdd->stamp;
-    int upper = ctime + vtsHelper::max_stamp - duration;
-    int lower = ctime - duration;
-
-    //remove any events falling out the back of the window
-    while(q.size()) {
-
-        event<AddressEvent> v = std::static_pointer_cast<AddressEvent>(q.front());
-        if(v && v != spatial[v->y][v->x]) {
-            q.pop_front();
-            continue;
-        }
-
-        int vtime = q.front()->stamp;
-
-        if((vtime > ctime && vtime < upper) || vtime < lower) {
-            removed.push_back(q.front());
-            if(v) spatial[v->y][v->x] = NULL;
-            q.pop_front();
-            count--;
-        } else {
-            break;
-        }
-    }
-
-    while(q.size()) {
-
-        event<AddressEvent> v = std::static_pointer_cast<AddressEvent>(q.back());
-        if(v && v != spatial[v->y][v->x]) {
-            q.pop_back();
-            continue;
-        }
-
-        int vtime = q.back()->stamp;
-
-        if((vtime > ctime && vtime < upper) || vtime < lower) {
-            removed.push_back(q.back());
-            if(v) spatial[v->y][v->x] = NULL;
-            q.pop_back();
-            count--;
-        } else {
-            break;
-        }
-    }
-
+    expiry.remove<AddressEvent>(*this, toAdd, &removed);
     return removed;
 }
 
-/******************************************************************************/
 void temporalSurface::fastRemoveEvents(event<> toAdd)
 {
-
-    //calculate event window boundaries based on latest timestamp
-    int ctime = toAdd->stamp;
-    int upper = ctime + vtsHelper::max_stamp - duration;
-    int lower = ctime - duration;
-
-    //remove any events falling out the back of the window
-    while(q.size()) {
-
-        event<AddressEvent> v = std::static_pointer_cast<AddressEvent>(q.front());
-        if(v && v != spatial[v->y][v->x]) {
-            q.pop_front();
-            continue;
-        }
-
-        int vtime = v->stamp;
-
-        if((vtime > ctime && vtime < upper) || vtime < lower) {
-            if(v) spatial[v->y][v->x] = NULL;
-            q.pop_front();
-            count--;
-        } else {
-            break;
-        }
-    }
-
-//    while(q.size()) {
-
-//        event<AddressEvent> v = std::static_pointer_cast<AddressEvent>(q.back());
-//        if(v && v != spatial[v->y][v->x]) {
-//            q.pop_back();
-//            continue;
-//        }
-
-//        int vtime = v->stamp;
-
-//        if((vtime > ctime && vtime < upper) || vtime < lower) {
-//            if(v) spatial[v->y][v->x] = NULL;
-//            q.pop_back();
-//            count--;
-//        } else {
-//            break;
-//        }
-//    }
+    expiry.remove<AddressEvent>(*this, toAdd, nullptr);
 }
 
 /******************************************************************************/
 vQueue fixedSurface::removeEvents(event<> toAdd)
 {
-
     vQueue removed;
-
-    while(q.size()) {
-
-        event<AddressEvent> v = as_event<AddressEvent>(q.front());
-        if(v && v != spatial[v->y][v->x]) {
-            q.pop_front();
-        } else {
-            break;
-        }
-    }
-
-    if(count > qlength) {
-
-        removed.push_back(q.front());
-        event<AddressEvent> v = as_event<AddressEvent>(q.front());
-        if(v) spatial[v->y][v->x] = NULL;
-        q.pop_front();
-        count--;
-    }
-
+    expiry.remove<AddressEvent>(*this, toAdd, &removed);
     return removed;
-
 }
 
 void fixedSurface::fastRemoveEvents(event<> toAdd)
 {
-
-    while(q.size()) {
-
-        event<AddressEvent> v = as_event<AddressEvent>(q.front());
-        if(v && v != spatial[v->y][v->x]) {
-            q.pop_front();
-        } else {
-            break;
-        }
-    }
-
-    if(count > qlength) {
-
-        event<AddressEvent> v = as_event<AddressEvent>(q.front());
-        if(v) spatial[v->y][v->x] = NULL;
-        q.pop_front();
-        count--;
-    }
-
+    expiry.remove<AddressEvent>(*this, toAdd, nullptr);
 }
 
 /******************************************************************************/
@@ -431,77 +303,58 @@ vQueue lifetimeSurface::addEvent(event<> toAdd)
     return vSurface2::addEvent(v);
 }
 
-vQueue lifetimeSurface::removeEvents(event<> toAdd)
+void lifetimeSurface::fastAddEvent(event<> toAdd, bool onlyAdd)
 {
+    event<FlowEvent> v = as_event<FlowEvent>(toAdd);
+    if(!v) return;
+    vSurface2::fastAddEvent(v, onlyAdd);
+}
 
-    vQueue removed;
-    //this could be better if q is sorted by death.
-
-
-    //lifetime requires a flow event only
-    event<FlowEvent> toAddflow = as_event<FlowEvent>(toAdd);
-    if(!toAddflow)
-        return vQueue();
-
-    int cts = toAddflow->stamp;
-    int cx = toAddflow->x; int cy = toAddflow->y;
-
-
-    vQueue::iterator i = q.begin();
-    while(i != q.end()) {
-        event<FlowEvent> v = std::static_pointer_cast<FlowEvent>(*i);
-        int modts = cts;
-        if(cts < v->stamp) //we have wrapped
-            modts += vtsHelper::max_stamp;
-
-        bool samelocation = v->x == cx && v->y == cy;
-
-        if(modts > v->getDeath() || samelocation) {
-            //it could be dangerous if spatial gets more than 1 event per pixel
-            removed.push_back(*i);
-            spatial[v->y][v->x] = NULL;
-            i = q.erase(i);
-            count--;
-        } else {
-            i++;
-        }
-    }
+void lifetimeSurface::stored(event<> toAdd)
+{
+    expiry.stored(*this, toAdd);
+}
 
+vQueue lifetimeSurface::removeEvents(event<> toAdd)
+{
+    vQueue removed;
+    expiry.remove<AddressEvent>(*this, toAdd, &removed);
     return removed;
-
 }
 
 void lifetimeSurface::fastRemoveEvents(event<> toAdd)
 {
+    expiry.remove<AddressEvent>(*this, toAdd, nullptr);
+}
 
-    //lifetime requires a flow event only
-    event<FlowEvent> toAddflow = as_event<FlowEvent>(toAdd);
-    if(!toAddflow)
-        return;
-
-    int cts = toAddflow->stamp;
-    int cx = toAddflow->x; int cy = toAddflow->y;
-
-
-    vQueue::iterator i = q.begin();
-    while(i != q.end()) {
-        event<FlowEvent> v = std::static_pointer_cast<FlowEvent>(*i);
-        int modts = cts;
-        if(cts < v->stamp) //we have wrapped
-            modts += vtsHelper::max_stamp;
-
-        bool samelocation = v->x == cx && v->y == cy;
+/******************************************************************************/
+template <typename P>
+static vSurface2 *createSurface(int width, int height, const P &policy)
+{
+    if(width == 128 && height == 128)
+        return new staticSurface<P, 128, 128>(policy);
+    if(width == 304 && height == 240)
+        return new staticSurface<P, 304, 240>(policy);
+    if(width == 640 && height == 480)
+        return new staticSurface<P, 640, 480>(policy);
+    return 0;
+}
 
-        if(modts > v->getDeath() || samelocation) {
-            //it could be dangerous if spatial gets more than 1 event per pixel
-            spatial[v->y][v->x] = NULL;
-            i = q.erase(i);
-            count--;
-        } else {
-            i++;
-        }
+vSurface2 *createSurface(std::string type, int width, int height,
+                         int parameter)
+{
+    vSurface2 *surface = 0;
+    if(type == "temporal") {
+        surface = createSurface(width, height, temporalExpiry(parameter));
+        if(!surface) surface = new temporalSurface(width, height, parameter);
+    } else if(type == "fixed") {
+        surface = createSurface(width, height, fixedExpiry(parameter));
+        if(!surface) surface = new fixedSurface(parameter, width, height);
+    } else if(type == "lifetime") {
+        surface = createSurface(width, height, lifetimeExpiry(parameter));
+        if(!surface) surface = new lifetimeSurface(width, height, parameter);
     }
-
+    return surface;
 }
 
 bool vEdge::flowremove(vQueue &removed, event<FlowEvent> vf)
@@ -648,6 +501,7 @@ const vQueue vEdge::getSurf(int xl, int xh, int yl, int yh)
         }
     }
 
+    EV_PROFILE_COPY(subq);
     return subq;
 
 }
@@ -749,6 +603,7 @@ const vQueue vFuzzyEdge::getSURF(int xl, int xh, int yl, int yh)
         }
     }
 
+    EV_PROFILE_COPY(subq);
     return subq;
 }
 
@@ -780,6 +635,7 @@ vQueue historicalSurface::getSurface(int queryTime, int queryWindow)
             surface(v->x, v->y) = 1;
         }
     }
+    EV_PROFILE_COPY(qret);
     return qret;
 }
 
@@ -818,6 +674,7 @@ vQueue historicalSurface::getSurface(int queryTime, int queryWindow, int xl, int
                 qret.push_back(*qi);
         }
     }
+    EV_PROFILE_COPY(qret);
     return qret;
 }
 
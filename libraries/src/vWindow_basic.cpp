@@ -125,6 +125,7 @@ const vQueue vSurface::getSurf(int xl, int xh, int yl, int yh)
         }
     }
 
+    EV_PROFILE_COPY(subq);
     return subq;
 
 }
@@ -138,7 +139,7 @@ event<AE> vSurface::getMostRecent()
 
 /******************************************************************************/
 
-vTempWindow::vTempWindow()
+vTempWindow::vTempWindow() : profile("vTempWindow")
 {
     //whichever is smaller: 2 seconds or 1/2 of the max stamp
     tLower = std::min(vtsHelper::max_stamp * 0.45, vtsHelper::vtsscaler * 2.0);
@@ -171,6 +172,7 @@ void vTempWindow::addEvent(event<> v)
     }
 
     q.push_back(v);
+    profile.holds(q.size());
 }
 
 void vTempWindow::addEvents(const vQueue &events)
@@ -184,6 +186,7 @@ void vTempWindow::addEvents(const vQueue &events)
 
 vQueue vTempWindow::getWindow()
 {
+    EV_PROFILE_COPY(q);
     return q;
 }
 
@@ -0,0 +1,87 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// checks that a vStreamSync with one input that never sends keeps releasing
+// the slices of its live input: the dead input may delay the first slice by
+// the timeout, but not every slice after it.
+
+#include "iCub/eventdriven/vSync.h"
+#include <iostream>
+
+using namespace ev;
+
+static const int n_packets = 100;
+static const int period = 1000;
+static const double timeout = 0.05;
+
+int main()
+{
+    yarp::os::Network yarp;
+    yarp::os::Network::setLocalMode(true);
+
+    vStreamSync sync;
+    sync.setSlicing(period, timeout);
+    //"GAE" is never connected
+    if(!sync.open("/streamSyncTest", "AE") ||
+            !sync.open("/streamSyncTest", "GAE"))
+        return 1;
+
+    vWritePort out;
+    if(!out.open("/streamSyncTest/AE:o") ||
+            !yarp::os::Network::connect("/streamSyncTest/AE:o",
+                                        "/streamSyncTest/AE:i"))
+        return 1;
+
+    //one slice of events per packet
+    yarp::os::Stamp envelope;
+    for(int p = 0; p < n_packets; p++) {
+        vQueue q;
+        for(int k = 0; k < 10; k++) {
+            auto v = make_event<AddressEvent>();
+            v->stamp = p * period + k * period / 10;
+            q.push_back(v);
+        }
+        envelope.update();
+        out.write(q, envelope);
+    }
+
+    //the last slice never completes: its end is after the last event
+    int expected = (n_packets - 1) * 10;
+    int released = 0, slices = 0;
+    double start = yarp::os::Time::now();
+    std::map<std::string, vQueue> slice;
+    while(released < expected && yarp::os::Time::now() - start < 10.0) {
+        if(!sync.getSlice(slice)) break;
+        released += slice["AE"].size();
+        slices++;
+    }
+    double elapsed = yarp::os::Time::now() - start;
+
+    sync.close();
+    out.close();
+
+    std::cout << slices << " slices, " << released << " of " << expected
+              << " events in " << elapsed << "s" << std::endl;
+
+    //waiting the timeout for every slice would take n_packets * timeout
+    if(released != expected || elapsed > n_packets * timeout / 4) {
+        std::cerr << "the dead input held back the live one" << std::endl;
+        return 1;
+    }
+    return 0;
+}
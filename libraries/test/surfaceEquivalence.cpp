@@ -0,0 +1,129 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// checks that the staticSurfaces made by createSurface behave exactly as the
+// run-time surfaces (temporalSurface, fixedSurface and lifetimeSurface) when
+// used through a vSurface2 pointer: the same events are removed, counted and
+// returned by the queries, on a long random stream that wraps the timestamp.
+
+#include "iCub/eventdriven/vWindow_adv.h"
+#include <iostream>
+#include <memory>
+#include <random>
+#include <typeinfo>
+
+using namespace ev;
+
+static const int width = 304;
+static const int height = 240;
+static const int n_events = 1200000;
+
+static bool same(const vQueue &a, const vQueue &b)
+{
+    if(a.size() != b.size()) return false;
+    for(size_t i = 0; i < a.size(); i++)
+        if(a[i] != b[i]) return false;
+    return true;
+}
+
+static event<> randomEvent(std::mt19937 &rng, unsigned int &stamp, bool flow)
+{
+    stamp = (stamp + rng() % 200) % vtsHelper::max_stamp;
+
+    event<AE> v;
+    if(flow) {
+        auto f = make_event<FlowEvent>();
+        f->vx = (rng() % 2001) / 1000.0f - 1.0f;
+        f->vy = (rng() % 2001) / 1000.0f - 1.0f;
+        v = f;
+    } else {
+        v = make_event<AE>();
+    }
+    //some addresses are outside of the sensor
+    v->x = rng() % (width + 16);
+    v->y = rng() % (height + 16);
+    v->polarity = rng() % 2;
+    v->channel = 0;
+    v->stamp = stamp;
+    return v;
+}
+
+static bool compare(const std::string &type, int parameter, vSurface2 *reference,
+                    bool fast, bool flow)
+{
+    std::unique_ptr<vSurface2> runtime(reference);
+    std::unique_ptr<vSurface2> fixed(createSurface(type, width, height,
+                                                   parameter));
+    if(!fixed || typeid(*fixed) == typeid(*runtime)) {
+        std::cerr << type << ": no static surface was made" << std::endl;
+        return false;
+    }
+
+    std::mt19937 rng(1);
+    unsigned int stamp = 0;
+    for(int i = 0; i < n_events; i++) {
+
+        //lifetime surfaces are given a mix, of which they only keep flow
+        event<> v = randomEvent(rng, stamp, flow && (i % 4));
+
+        if(fast) {
+            runtime->fastAddEvent(v);
+            fixed->fastAddEvent(v);
+        } else if(!same(runtime->addEvent(v), fixed->addEvent(v))) {
+            std::cerr << type << ": removed events differ at " << i
+                      << std::endl;
+            return false;
+        }
+
+        if(runtime->getEventCount() != fixed->getEventCount()) {
+            std::cerr << type << ": counts differ at " << i << " ("
+                      << runtime->getEventCount() << " and "
+                      << fixed->getEventCount() << ")" << std::endl;
+            return false;
+        }
+
+        if(i % 997 == 0) {
+            int x = rng() % width, y = rng() % height, d = rng() % 20;
+            if(!same(runtime->getSurf(x, y, d), fixed->getSurf(x, y, d)) ||
+                    !same(runtime->getSurf(), fixed->getSurf())) {
+                std::cerr << type << ": queries differ at " << i << std::endl;
+                return false;
+            }
+        }
+    }
+
+    std::cout << type << (fast ? " (fast)" : "") << ": " << n_events
+              << " events, " << runtime->getEventCount() << " stored at the end"
+              << std::endl;
+    return true;
+}
+
+int main()
+{
+    int duration = 0.05 * vtsHelper::vtsscaler;
+    bool ok = true;
+    for(int fast = 0; fast < 2; fast++) {
+        ok &= compare("temporal", duration,
+                      new temporalSurface(width, height, duration), fast, false);
+        ok &= compare("fixed", 5000,
+                      new fixedSurface(5000, width, height), fast, false);
+        ok &= compare("lifetime", 10,
+                      new lifetimeSurface(width, height, 10), fast, true);
+    }
+    return ok ? 0 : 1;
+}
@@ -45,7 +45,9 @@ private:
     unsigned int vCount;
     double yRate;
     bool isReading;
-    ev::vQueue vQueue;
+
+    //centroid of the events of each channel, without keeping the events
+    ev::vMomentWindow moments;
 
 public:
 
@@ -61,7 +63,8 @@ public:
     unsigned long int popCount();
     double getEventRate() { return yRate; }
 
-    ev::vQueue getEvents() ;
+    void setWindow(double seconds);
+    void getMoments(ev::vMoments &left, ev::vMoments &right);
     bool start();
     bool stop();
 
@@ -112,7 +115,7 @@ private:
     void performSaccade();
     bool configDriver( int joint, double refSp, double refAcc );
     double computeEventRate();
-    bool computeCenterMass( yarp::sig::Vector &cmR, yarp::sig::Vector &cmL, ev::vQueue &q );
+    bool computeCenterMass( yarp::sig::Vector &cmR, yarp::sig::Vector &cmL );
     void home();
     bool openJointControlDriver();
     bool openGazeDriver();
@@ -66,6 +66,7 @@ bool AutoSaccadeModule::configure(ResourceFinder &rf){
 bool AutoSaccadeModule::openPorts() {
     bool check = true;
     check &= eventBottleManager.open( getName( "/vBottle:i" ) );
+    eventBottleManager.setWindow( timeout );
     check &= vRatePort.open( getName( "/vRate:o" ) );
     //check &= leftImgPort.open( getName( "/imgL:o" ) );
     //check &= rightImagePort.open( getName( "/imgR:o" ) );
@@ -233,7 +234,6 @@ bool AutoSaccadeModule::updateModule() {
 
     //ImageOf<PixelBgr> &leftImage = leftImgPort.prepare();
     //ImageOf<PixelBgr> &rightImage = rightImagePort.prepare();
-    ev::vQueue q = eventBottleManager.getEvents();
     //visualizeEvents( leftImage, rightImage, q );
 
     //Face straight (for simulation only)
@@ -253,12 +253,10 @@ bool AutoSaccadeModule::updateModule() {
         performSaccade();
     } else {
 
-        ev::vQueue q = eventBottleManager.getEvents();
-
         Vector cmL,cmR;
         gazeControl->restoreContext( context0 );
 
-        if (computeCenterMass( cmR, cmL, q )) {
+        if (computeCenterMass( cmR, cmL )) {
             if (cmL.size()) {  //left
                 if (cmR.size()) { //left + right
                     yarp::sig::Vector tp;
@@ -331,42 +329,24 @@ void AutoSaccadeModule::home() {
     Time::delay(1.0);
 }
 
-bool AutoSaccadeModule::computeCenterMass( Vector &cmR, Vector &cmL, ev::vQueue &q ) {
+bool AutoSaccadeModule::computeCenterMass( Vector &cmR, Vector &cmL ) {
+
+    ev::vMoments left, right;
+    eventBottleManager.getMoments(left, right);
 
-    if (q.empty()) {
-        cerr << "Could not compute center of mass: empty event queue" << endl;
+    int lSize = left.count();
+    int rSize = right.count();
+    if (lSize == 0 && rSize == 0) {
+        cerr << "Could not compute center of mass: no events" << endl;
         return false;
     }
 
-    int xl = 0, yl = 0;
-    int xr = 0, yr = 0;
-    int rSize = 0, lSize = 0;
+    double xl = 0, yl = 0;
+    double xr = 0, yr = 0;
+    left.centroid(xl, yl);
+    right.centroid(xr, yr);
     cmR.resize(2);
     cmL.resize(2);
-    for ( ev::vQueue::iterator i = q.begin(); i != q.end(); ++i ) {
-        auto aep = ev::is_event<ev::AE>( *i );
-        if (aep->channel) {
-            xr += aep->x;
-            yr += aep->y;
-            rSize++;
-        } else {
-            xl += aep->x;
-            yl += aep->y;
-            lSize++;
-        }
-    }
-
-    if (lSize == 0 && rSize == 0)
-        return false;
-
-    if (lSize != 0) {
-        xl /= lSize;
-        yl /= lSize;
-    }
-    if (rSize != 0) {
-        xr /= rSize;
-        yr /= rSize;
-    }
 
     std::cout << "lSize = " << lSize << std::endl;
     std::cout << "rSize = " << rSize << std::endl;
@@ -430,8 +410,8 @@ void EventBottleManager::onRead(ev::vBottle &bot) {
     }
 
     mutex.wait();
-    //append new events to queue
-    vQueue.insert(vQueue.end(), newQueue.begin(), newQueue.end());
+    //update the moments of the window
+    moments.add(newQueue);
     latestStamp = unwrapper(newQueue.back()->stamp);
     vCount += newQueue.size();
     mutex.post();
@@ -453,7 +433,7 @@ unsigned long int EventBottleManager::popCount() {
 
 bool EventBottleManager::start() {
     mutex.wait();
-    vQueue.clear();
+    moments.clear();
     isReading = true;
     yRate = yarp::os::Time::now();
     mutex.post();
@@ -470,14 +450,17 @@ bool EventBottleManager::stop() {
     return true;
 }
 
-ev::vQueue EventBottleManager::getEvents() {
+void EventBottleManager::setWindow(double seconds) {
+    mutex.wait();
+    moments.setTimeWindow(seconds * ev::vtsHelper::vtsscaler);
+    mutex.post();
+}
+
+void EventBottleManager::getMoments(ev::vMoments &left, ev::vMoments &right) {
     mutex.wait();
-    if (!&vQueue)
-        return ev::vQueue();
-    ev::vQueue outQueue = vQueue;
-    vQueue.clear();
+    left = moments.moments(0);
+    right = moments.moments(1);
     mutex.post();
-    return outQueue;
 }
 
 //empty line to make gcc happy
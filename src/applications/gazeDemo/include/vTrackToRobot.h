@@ -38,89 +38,6 @@
 
 using namespace ev;
 
-/*//////////////////////////////////////////////////////////////////////////////
-  VBOTTLE READER/PROCESSOR
-  ////////////////////////////////////////////////////////////////////////////*/
-
-class positionReader : public yarp::os::BufferedPort<ev::vBottle>
-{
-private:
-
-    yarp::sig::Vector leftTarget;
-    yarp::sig::Vector rightTarget;
-    Mutex m;
-
-public:
-
-    positionReader()
-    {
-        leftTarget.resize(4);
-        rightTarget.resize(4);
-        leftTarget[2] = -100;
-        rightTarget[2] = 100;
-        leftTarget[3] = 0;
-        rightTarget[3] = 0;
-        useCallback();
-        setStrict();
-    }
-
-    void onRead(vBottle &vBottleIn)
-    {
-
-        //get the Q
-        if(this->getPendingReads() > 1) {
-            yInfo() << "Backed up port:" << this->getPendingReads();
-        }
-        vQueue q = vBottleIn.get<GaussianAE>();
-        if(q.empty()) {
-            yWarning() << "q empty in callback function?";
-            return;
-        }
-
-        m.lock();
-        //update our current best position of the ball in both cameras
-        bool leftupdated = false, rightupdated = false;
-        vQueue::reverse_iterator qi = q.rbegin();
-        while((!leftupdated || !rightupdated) && qi != q.rend()) {
-            auto v = is_event<GaussianAE>(*qi);
-            if(v->channel == VRIGHT && !rightupdated) {
-                rightupdated = true;
-                if(v->polarity == 0) {
-                    rightTarget[3] = 0;
-                } else {
-                    rightTarget[0] = v->x;
-                    rightTarget[1] = v->y;
-                    rightTarget[2] = v->sigx; //radius
-                    rightTarget[3] = 1;
-                }
-            } else if(v->channel == VLEFT && !leftupdated) {
-                leftupdated = true;
-                if(v->polarity == 0) {
-                    leftTarget[3] = 0;
-                } else {
-                    leftTarget[0] = v->x;
-                    leftTarget[1] = v->y;
-                    leftTarget[2] = v->sigx; //radius
-                    leftTarget[3] = 1;
-                }
-            }
-            qi++;
-        }
-        m.unlock();
-
-    }
-
-    void getTargets(yarp::sig::Vector &left, yarp::sig::Vector &right)
-    {
-        m.lock();
-        left = leftTarget;
-        right = rightTarget;
-        m.unlock();
-    }
-
-
-};
-
 /*//////////////////////////////////////////////////////////////////////////////
   VELOCITY CONTROL (WITHOUT GAZECONTROLLER)
   ////////////////////////////////////////////////////////////////////////////*/
@@ -351,9 +268,10 @@ class vTrackToRobotModule : public yarp::os::RFModule
 private:
 
     ev::resolution res;
-    //the event bottle input and output handler
-    //positionReader inputPort;
+    //the latest target of each camera from a tracker (or a 6-vector input)
+    ev::vTargetReader targetPort;
     yarp::os::BufferedPort<yarp::sig::Vector> inputPort;
+    double maxTargetAge;
     yarp::os::BufferedPort<yarp::os::Bottle> cartOutPort;
     yarp::os::BufferedPort<yarp::sig::Vector> debugOutPort;
     yarp::sig::Vector arm_target_position;
@@ -386,6 +304,7 @@ private:
     bool controlArm(yarp::sig::Vector ltarget, yarp::sig::Vector rtarget);
     bool controlVelocity(yarp::sig::Vector ltarget, yarp::sig::Vector rtarget);
     bool controlExternal(yarp::sig::Vector ltarget, yarp::sig::Vector rtarget);
+    void latestTargets(yarp::sig::Vector &ltarget, yarp::sig::Vector &rtarget);
 
 public:
 
@@ -59,6 +59,7 @@ bool vTrackToRobotModule::configure(yarp::os::ResourceFinder &rf)
     yThresh = rf.check("yThresh", yarp::os::Value(20)).asDouble();
     rThresh = rf.check("rThresh", yarp::os::Value(5)).asDouble();
     period = rf.check("period", yarp::os::Value(0.01)).asDouble();
+    maxTargetAge = rf.check("max_age", yarp::os::Value(0.5)).asDouble();
     gazingActive = rf.check("start", yarp::os::Value(false)).asBool();
     useDemoRedBall = rf.check("grasp", yarp::os::Value(false)).asBool();
     velocityControl = rf.check("velocity", yarp::os::Value(false)).asBool();
@@ -79,6 +80,10 @@ bool vTrackToRobotModule::configure(yarp::os::ResourceFinder &rf)
     if(!inputPort.open(getName() + "/vBottle:i"))
         return false;
 
+    targetPort.setTargetCount(rf.check("targets", yarp::os::Value(16)).asInt());
+    if(!targetPort.open(getName() + "/target:i"))
+        return false;
+
     if(!cartOutPort.open(getName() + "/cart:o"))
         return false;
 
@@ -425,14 +430,19 @@ bool vTrackToRobotModule::updateModule()
 
     //get the targets from the input ports
     yarp::sig::Vector leftTarget, rightTarget;
-    Vector *dataIn = inputPort.read();
+    if(targetPort.getInputCount()) {
+        //the newest state, without waiting for (or queueing) updates
+        latestTargets(leftTarget, rightTarget);
+    } else {
+        Vector *dataIn = inputPort.read();
 
-    //yInfo() << dataIn->toString();
+        //yInfo() << dataIn->toString();
 
-    leftTarget = dataIn->subVector(0, 2);
-    leftTarget.push_back(!(leftTarget[0] == -1.0));
-    rightTarget = dataIn->subVector(3, 5);
-    rightTarget.push_back(!(rightTarget[0] == -1.0));
+        leftTarget = dataIn->subVector(0, 2);
+        leftTarget.push_back(!(leftTarget[0] == -1.0));
+        rightTarget = dataIn->subVector(3, 5);
+        rightTarget.push_back(!(rightTarget[0] == -1.0));
+    }
 
     //perform the type of control as specified
     bool gazePerformed = false;
@@ -510,6 +520,22 @@ bool vTrackToRobotModule::respond(const yarp::os::Bottle &command,
 
 }
 
+void vTrackToRobotModule::latestTargets(yarp::sig::Vector &ltarget,
+                                        yarp::sig::Vector &rtarget)
+{
+    //(x y r present) where targets older than max_age are not present
+    yarp::sig::Vector *targets[2] = {&ltarget, &rtarget};
+    for(int c = 0; c < 2; c++) {
+        yarp::sig::Vector &v = *targets[c];
+        v.resize(4, 0.0);
+        ev::vTarget t;
+        double age;
+        if(!targetPort.newest(c, t, age)) continue;
+        v[0] = t.x; v[1] = t.y; v[2] = t.r;
+        v[3] = t.present && age < maxTargetAge;
+    }
+}
+
 bool vTrackToRobotModule::interruptModule()
 {
 
@@ -519,6 +545,7 @@ bool vTrackToRobotModule::interruptModule()
     }
 
     inputPort.interrupt();
+    targetPort.interrupt();
     return yarp::os::RFModule::interruptModule();
 }
 
@@ -538,6 +565,7 @@ bool vTrackToRobotModule::close()
 
 
     inputPort.close();
+    targetPort.close();
     return yarp::os::RFModule::close();
 }
 
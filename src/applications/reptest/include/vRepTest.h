@@ -29,10 +29,35 @@
 #include <iCub/eventdriven/all.h>
 #include <iCub/eventdriven/deprecated.h>
 
+/// \brief the cost of a representation accumulated over a dataset
+class repCost
+{
+public:
+
+    std::string name;
+    unsigned long packets;
+    unsigned long added;
+    double addtime;
+    unsigned long queries;
+    std::vector<double> querytime;
+    std::vector<double> returned;
+    double retained;
+    int maxretained;
+    double maxbytes;
+
+    repCost(std::string name = "", int nrois = 0) : name(name), packets(0),
+        added(0), addtime(0), queries(0), querytime(nrois, 0.0),
+        returned(nrois, 0.0), retained(0), maxretained(0), maxbytes(0) {}
+
+};
+
 class vRepTest : public yarp::os::BufferedPort<ev::vBottle>
 {
 private:
 
+    enum { TEMPORAL = 0, FIXED = 1, LIFETIME = 2, EDGE = 3, FUZZYEDGE = 4,
+           NREPS = 5 };
+
     //output port for the vBottle with the new events computed by the module
     yarp::os::BufferedPort<yarp::os::Bottle> dumper;
     yarp::os::BufferedPort<ev::vBottle> eventsOut;
@@ -42,23 +67,44 @@ private:
     ev::vtsHelper unwrapper;
     double ytime;
 
-    ev::vEdge edge;
-    ev::temporalSurface tWindow;
-    ev::fixedSurface fWindow;
-    ev::lifetimeSurface lWindow;
-    ev::vFuzzyEdge fedge;
+    int width;
+    int height;
+    ev::vEdge *edge;
+    ev::temporalSurface *tWindow;
+    ev::fixedSurface *fWindow;
+    ev::lifetimeSurface *lWindow;
+    ev::vFuzzyEdge *fedge;
+
+    //benchmarking
+    bool benchmarking;
+    std::string tablefile;
+    std::vector<int> rois;
+    std::vector<repCost> costs;
 
     std::string vistype;
     void drawDebug(yarp::sig::ImageOf<yarp::sig::PixelBgr> &image,
                    const ev::vQueue &q, int xoff, int yoff);
 
+    void addTo(int rep, const ev::vQueue &q);
+    ev::vQueue query(int rep, int x, int y, int d);
+    int retainedBy(int rep);
+    double bytesOf(int rep);
+
 public:
 
     vRepTest();
-    void setTemporalWindow(int dt) {tWindow.setTemporalSize(dt);}
-    void setFixedWindow(int N) {fWindow.setFixedWindowSize(N);}
+    ~vRepTest();
+    void setResolution(int width, int height);
+    void setTemporalWindow(int dt) {tWindow->setTemporalSize(dt);}
+    void setFixedWindow(int N) {fWindow->setFixedWindowSize(N);}
     void setVisType(std::string vis) {this->vistype = vis;}
 
+    /// \brief measure the cost of adding events to each representation and
+    /// of querying an ROI of each half-size in rois around the latest event.
+    /// The results are written to tablefile (if not empty) on close.
+    void setBenchmark(std::vector<int> rois, std::string tablefile);
+    std::string benchmarkTable();
+
     bool    open(const std::string &name, bool strict = false);
     void    close();
     void    interrupt();
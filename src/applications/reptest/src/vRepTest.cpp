@@ -17,6 +17,9 @@
  */
 
 #include "vRepTest.h"
+#include <fstream>
+#include <iomanip>
+#include <sstream>
 
 using namespace ev;
 
@@ -34,10 +37,28 @@ bool vRepTestHandler::configure(yarp::os::ResourceFinder &rf)
             rf.check("strict", yarp::os::Value(true)).asBool();
 
 
+    reptest.setResolution(rf.check("width", yarp::os::Value(128)).asInt(),
+                          rf.check("height", yarp::os::Value(128)).asInt());
     reptest.setVisType(vis);
     //reptest.setTemporalWindow(rf.check("tWin", yarp::os::Value(125000)).asInt());
     reptest.setFixedWindow(rf.check("fWin", yarp::os::Value(1000)).asInt());
 
+    if(rf.check("benchmark") &&
+            rf.check("benchmark", yarp::os::Value(true)).asBool()) {
+        std::vector<int> rois;
+        yarp::os::Bottle *roilist = rf.find("rois").asList();
+        if(roilist) {
+            for(int i = 0; i < (int)roilist->size(); i++)
+                rois.push_back(roilist->get(i).asInt());
+        } else {
+            rois = {5, 10, 20, 40};
+        }
+        reptest.setBenchmark(rois, rf.check("table",
+                             yarp::os::Value("")).asString());
+        //every packet of the dataset should be measured
+        strict = true;
+    }
+
     /* create the thread and pass pointers to the module parameters */
     return reptest.open(moduleName, strict);
 
@@ -75,14 +96,177 @@ double vRepTestHandler::getPeriod()
 /**********************************************************/
 vRepTest::vRepTest()
 {
-    edge.track();
-    fWindow.setFixedWindowSize(1000);
-    tWindow.setTemporalSize(125000);
-    edge.setThickness(1);
+    edge = 0; tWindow = 0; fWindow = 0; lWindow = 0; fedge = 0;
+    benchmarking = false;
+    setResolution(128, 128);
     ytime = 0;
     //here we should initialise the module
 
 }
+
+/**********************************************************/
+vRepTest::~vRepTest()
+{
+    delete edge;
+    delete tWindow;
+    delete fWindow;
+    delete lWindow;
+    delete fedge;
+}
+
+/**********************************************************/
+void vRepTest::setResolution(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+
+    delete edge; delete tWindow; delete fWindow; delete lWindow; delete fedge;
+    edge = new ev::vEdge(width, height);
+    tWindow = new ev::temporalSurface(width, height, 125000);
+    fWindow = new ev::fixedSurface(1000, width, height);
+    lWindow = new ev::lifetimeSurface(width, height);
+    fedge = new ev::vFuzzyEdge(width, height);
+
+    edge->track();
+    fedge->track();
+    edge->setThickness(1);
+}
+
+/**********************************************************/
+void vRepTest::setBenchmark(std::vector<int> rois, std::string tablefile)
+{
+    static const char *names[NREPS] =
+        {"temporal", "fixed", "lifetime", "edge", "fuzzyedge"};
+
+    benchmarking = true;
+    this->rois = rois;
+    this->tablefile = tablefile;
+    costs.clear();
+    for(int r = 0; r < NREPS; r++)
+        costs.push_back(repCost(names[r], rois.size()));
+}
+
+/**********************************************************/
+void vRepTest::addTo(int rep, const ev::vQueue &q)
+{
+    switch(rep) {
+    case TEMPORAL:
+        for(unsigned int i = 0; i < q.size(); i++) tWindow->addEvent(q[i]);
+        break;
+    case FIXED:
+        for(unsigned int i = 0; i < q.size(); i++) fWindow->addEvent(q[i]);
+        break;
+    case LIFETIME:
+        for(unsigned int i = 0; i < q.size(); i++) lWindow->addEvent(q[i]);
+        break;
+    case EDGE:
+        for(unsigned int i = 0; i < q.size(); i++)
+            edge->addEventToEdge(as_event<AE>(q[i]));
+        break;
+    case FUZZYEDGE:
+        for(unsigned int i = 0; i < q.size(); i++)
+            fedge->addEventToEdge(as_event<AE>(q[i]));
+        break;
+    }
+}
+
+/**********************************************************/
+ev::vQueue vRepTest::query(int rep, int x, int y, int d)
+{
+    switch(rep) {
+    case TEMPORAL:
+        return tWindow->getSurf(x, y, d);
+    case FIXED:
+        return fWindow->getSurf(x, y, d);
+    case LIFETIME:
+        return lWindow->getSurf(x, y, d);
+    case EDGE:
+        return edge->getSurf(x - d, x + d, y - d, y + d);
+    case FUZZYEDGE:
+        return fedge->getSURF(x - d, x + d, y - d, y + d);
+    }
+    return ev::vQueue();
+}
+
+/**********************************************************/
+int vRepTest::retainedBy(int rep)
+{
+    switch(rep) {
+    case TEMPORAL: return tWindow->getEventCount();
+    case FIXED: return fWindow->getEventCount();
+    case LIFETIME: return lWindow->getEventCount();
+    case EDGE: return edge->getEventCount();
+    case FUZZYEDGE: return fedge->getEventCount();
+    }
+    return 0;
+}
+
+/**********************************************************/
+double vRepTest::bytesOf(int rep)
+{
+    //an estimate from the containers: the surfaces keep a pixel map and a
+    //queue of the events retained, the edges only a pixel map (and the fuzzy
+    //edge a score per pixel). Each retained event is counted as its own
+    //allocation, although the representations share them in this module.
+    double pixels = (double)width * height;
+    double retained = retainedBy(rep);
+    double pointer = sizeof(ev::event<>);
+    double object = sizeof(ev::AddressEvent);
+
+    switch(rep) {
+    case TEMPORAL:
+    case FIXED:
+        return pixels * pointer + retained * (2 * pointer + object);
+    case LIFETIME:
+        //also a time of death and a pointer in a bucket for each event
+        return pixels * pointer +
+                retained * (3 * pointer + sizeof(unsigned long) +
+                            sizeof(ev::FlowEvent));
+    case EDGE:
+        return pixels * pointer + retained * (pointer + object);
+    case FUZZYEDGE:
+        return pixels * (pointer + sizeof(double)) +
+                retained * (pointer + object);
+    }
+    return 0;
+}
+
+/**********************************************************/
+std::string vRepTest::benchmarkTable()
+{
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(3);
+
+    oss << std::left << std::setw(12) << "#rep" << std::right
+        << std::setw(10) << "packets" << std::setw(12) << "events"
+        << std::setw(12) << "add_us/ev" << std::setw(12) << "retained"
+        << std::setw(12) << "max_ret" << std::setw(12) << "max_kB";
+    for(unsigned int i = 0; i < rois.size(); i++) {
+        std::ostringstream col; col << "_d" << rois[i];
+        oss << std::setw(14) << "query_us" + col.str()
+            << std::setw(14) << "events" + col.str();
+    }
+    oss << "\n";
+
+    for(unsigned int r = 0; r < costs.size(); r++) {
+        const repCost &c = costs[r];
+        double packets = c.packets ? c.packets : 1;
+        double queries = c.queries ? c.queries : 1;
+        oss << std::left << std::setw(12) << c.name << std::right
+            << std::setw(10) << c.packets << std::setw(12) << c.added
+            << std::setw(12) << (c.added ? 1e6 * c.addtime / c.added : 0.0)
+            << std::setw(12) << c.retained / packets
+            << std::setw(12) << c.maxretained
+            << std::setw(12) << c.maxbytes / 1024.0;
+        for(unsigned int i = 0; i < rois.size(); i++)
+            oss << std::setw(14) << 1e6 * c.querytime[i] / queries
+                << std::setw(14) << c.returned[i] / queries;
+        oss << "\n";
+    }
+
+    return oss.str();
+}
+
 /**********************************************************/
 bool vRepTest::open(const std::string &name, bool strict)
 {
@@ -107,6 +291,19 @@ void vRepTest::close()
     dumper.close();
     yarp::os::BufferedPort<ev::vBottle>::close();
 
+    if(benchmarking) {
+        std::string table = benchmarkTable();
+        yInfo() << "Representation benchmark (" << width << "x" << height
+                << "):\n" << table;
+        if(tablefile.size()) {
+            std::ofstream file(tablefile.c_str());
+            if(file.is_open())
+                file << table;
+            else
+                yError() << "Could not write benchmark to" << tablefile;
+        }
+    }
+
     //remember to also deallocate any memory allocated by this class
 
 
@@ -131,20 +328,49 @@ void vRepTest::onRead(ev::vBottle &inBottle)
     //create event queue
     ev::vQueue q = inBottle.getAll();
     ev::qsort(q, true);
+
+    //the events that fit in the representations
+    ev::vQueue valid;
     for(ev::vQueue::iterator qi = q.begin(); qi != q.end(); qi++)
     {
         auto ae = as_event<AE>(*qi);
         if(!ae || ae->getChannel()) continue;
-        //the following is a hack until all hard-coded values can be removed
-        //from the module
-        if(ae->x > 127 || ae->y > 127) continue;
+        if(ae->x >= width || ae->y >= height) continue;
 
         unwts = unwrapper((*qi)->stamp);
-        tWindow.addEvent(*qi);
-        fWindow.addEvent(*qi);
-        lWindow.addEvent(*qi);
-        edge.addEventToEdge(ae);
-        fedge.addEventToEdge(ae);
+        valid.push_back(*qi);
+    }
+
+    //each representation takes the whole packet in turn, so the cost of
+    //each is measured separately
+    for(int r = 0; r < NREPS; r++) {
+        if(!benchmarking) {
+            addTo(r, valid);
+            continue;
+        }
+
+        repCost &c = costs[r];
+        double tic = yarp::os::Time::now();
+        addTo(r, valid);
+        c.addtime += yarp::os::Time::now() - tic;
+        c.added += valid.size();
+        c.packets++;
+
+        int n = retainedBy(r);
+        c.retained += n;
+        c.maxretained = std::max(c.maxretained, n);
+        c.maxbytes = std::max(c.maxbytes, bytesOf(r));
+
+        //query around the latest event, as a tracker would
+        if(valid.empty()) continue;
+        auto last = as_event<AE>(valid.back());
+        for(unsigned int i = 0; i < rois.size(); i++) {
+            tic = yarp::os::Time::now();
+            ev::vQueue roi = query(r, last->x, last->y, rois[i]);
+            c.querytime[i] += yarp::os::Time::now() - tic;
+            c.returned[i] += roi.size();
+        }
+        c.queries++;
     }
 
     //dump modified dataset
@@ -155,7 +381,7 @@ void vRepTest::onRead(ev::vBottle &inBottle)
         for(ev::vQueue::iterator qi = q.begin(); qi != q.end(); qi++)
         {
             auto v = as_event<AE>(*qi);
-            if(v && v->x < 128)
+            if(v && v->x < width)
                 outBottle.addEvent(*qi);
         }
 
@@ -168,10 +394,10 @@ void vRepTest::onRead(ev::vBottle &inBottle)
         yarp::os::Bottle &outBottle = dumper.prepare();
         outBottle.clear();
         outBottle.addInt64(unwts);
-        outBottle.addInt(tWindow.getEventCount());
-        outBottle.addInt(fWindow.getEventCount());
-        outBottle.addInt(lWindow.getEventCount());
-        outBottle.addInt(edge.getEventCount());
+        outBottle.addInt(tWindow->getEventCount());
+        outBottle.addInt(fWindow->getEventCount());
+        outBottle.addInt(lWindow->getEventCount());
+        outBottle.addInt(edge->getEventCount());
 
         dumper.setEnvelope(yts);
         dumper.writeStrict();
@@ -185,29 +411,31 @@ void vRepTest::onRead(ev::vBottle &inBottle)
         ytime += 0.01;
         yarp::sig::ImageOf<yarp::sig::PixelBgr> &image = imPort.prepare();
 
+        //the panels are drawn transposed
+        int pw = height, ph = width;
         if(vistype == "all") {
-            image.resize(128 * 3 + 20, 128 * 2 + 15);
+            image.resize(pw * 3 + 20, ph * 2 + 15);
             image.zero();
-            drawDebug(image, tWindow.getSurf(), 5, 5);
-            drawDebug(image, fWindow.getSurf(), 5, 127 + 10);
-            drawDebug(image, lWindow.getSurf(), 127 + 10, 5);
-            drawDebug(image, edge.getSurf(0, 127, 0, 127), 127+10, 127+10);
-            drawDebug(image, fedge.getSURF(0, 127, 0, 127), 127+127+15, 127+10);
+            drawDebug(image, tWindow->getSurf(), 5, 5);
+            drawDebug(image, fWindow->getSurf(), 5, ph + 9);
+            drawDebug(image, lWindow->getSurf(), pw + 9, 5);
+            drawDebug(image, edge->getSurf(0, width-1, 0, height-1), pw+9, ph+9);
+            drawDebug(image, fedge->getSURF(0, width-1, 0, height-1), 2*pw+13, ph+9);
         } else {
-            image.resize(128, 128);
+            image.resize(pw, ph);
             image.zero();
         }
 
         if(vistype == "time")
-            drawDebug(image, tWindow.getSurf(), 0, 0);
+            drawDebug(image, tWindow->getSurf(), 0, 0);
         else if(vistype == "fixed")
-            drawDebug(image, fWindow.getSurf(), 0, 0);
+            drawDebug(image, fWindow->getSurf(), 0, 0);
         else if(vistype == "life")
-            drawDebug(image, lWindow.getSurf(), 0, 0);
+            drawDebug(image, lWindow->getSurf(), 0, 0);
         else if(vistype == "edge")
-            drawDebug(image, edge.getSurf(0, 127, 0, 127), 0, 0);
+            drawDebug(image, edge->getSurf(0, width-1, 0, height-1), 0, 0);
         else if(vistype == "fedge")
-            drawDebug(image, fedge.getSURF(0, 127, 0, 127), 0, 0);
+            drawDebug(image, fedge->getSURF(0, width-1, 0, height-1), 0, 0);
 
         imPort.setEnvelope(yts);
         imPort.writeStrict();
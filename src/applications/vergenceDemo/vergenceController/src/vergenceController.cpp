@@ -176,8 +176,8 @@ vVergenceManager::vVergenceManager(int width, int height, int nEvents, int numbe
     }
 
     //create the surface representations
-    fifoLeft = new ev::fixedSurface(nEvents, width, height);
-    fifoRight = new ev::fixedSurface(nEvents, width, height);
+    fifoLeft = ev::createSurface("fixed", width, height, nEvents);
+    fifoRight = ev::createSurface("fixed", width, height, nEvents);
 
     gazecontrol = 0;
     enccontrol = 0;
@@ -57,6 +57,8 @@ class chronocamGrabberModule : public yarp::os::RFModule {
 
     //HANDLES READING WRITING TO DATA DEVICE AND YARP
     device2yarp D2Y; // ratethread that reads the device and writes to yarp vBottle
+    evtSource *source = nullptr; //the camera or a synthetic event generator
+    bool synthetic = false;
 
 public:
 
@@ -0,0 +1,227 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *           chiara.bartolozzi@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __EVTDECODER__
+#define __EVTDECODER__
+
+#include <yarp/os/Time.h>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+/******************************************************************************/
+//decodeEVT
+/******************************************************************************/
+
+/// \brief converts a block of EVT words (see atis_events_stream.h) into the AE
+/// wire format [TS, AE] pairs. Only LEFT_TD events are output, EVT_TIME_HIGH
+/// words update time_high and other words are skipped. The loop has no
+/// data-dependent branches: every word is decoded and written, and the output
+/// pointer only advances for TD events. target must have room for
+/// 2 * n_words ints.
+/// \returns the number of events written
+inline long decodeEVT(const uint32_t *words, long n_words, int32_t *target,
+                      uint32_t &time_high, int width, int height)
+{
+    int32_t *out = target;
+    uint32_t th = time_high;
+    for(long i = 0; i < n_words; i++) {
+        uint32_t w = words[i];
+        uint32_t type = w >> 28;
+        uint32_t ts = (th + ((w >> 17) & 0x7FF)) & 0x00FFFFFF;
+        uint32_t x = width - 1 - ((w >> 8) & 0x1FF);
+        uint32_t y = height - 1 - (w & 0xFF);
+        out[0] = ts;
+        out[1] = (y << 10) | (x << 1) | (type & 0x01);
+        out += (type <= 0x01) << 1; //LEFT_TD_LOW or LEFT_TD_HIGH
+        th = type == 0x08 ? (w & 0x0FFFFFFF) << 11 : th; //EVT_TIME_HIGH
+    }
+    time_high = th;
+    return (out - target) / 2;
+}
+
+/******************************************************************************/
+//evtSource
+/******************************************************************************/
+
+/// \brief a source of blocks of EVT words
+class evtSource {
+public:
+    virtual ~evtSource() {}
+    /// \brief true if a new block is available
+    virtual bool poll() = 0;
+    /// \brief get the block made available by poll()
+    virtual const uint32_t *decode(long &n_words) = 0;
+};
+
+/// \brief generates uniformly random TD events at a given rate (events per
+/// second) without a camera. A rate of 0 generates blocks as fast as they
+/// are read, to benchmark the grabber.
+class syntheticEVTSource : public evtSource {
+
+private:
+
+    std::vector<uint32_t> block;
+    double rate;
+    double tprev;
+    double owed;
+    double sim_time;
+    uint32_t time_high;
+    uint32_t seed;
+    long n_block;
+
+    uint32_t random()
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    }
+
+public:
+
+    syntheticEVTSource(double rate = 0, unsigned int block_size = 4096)
+    {
+        this->rate = rate;
+        block.resize(block_size);
+        tprev = yarp::os::Time::now();
+        owed = 0;
+        sim_time = 0;
+        time_high = 0xFFFFFFFF;
+        seed = 2463534242u;
+        n_block = 0;
+    }
+
+    virtual bool poll()
+    {
+        long n_events = block.size() / 2;
+        if(rate > 0) {
+            double tnow = yarp::os::Time::now();
+            owed += (tnow - tprev) * rate;
+            tprev = tnow;
+            if(owed < 1.0) return false;
+            if(owed < n_events) n_events = owed;
+            owed -= n_events;
+        }
+
+        double dt = rate > 0 ? 1e6 / rate : 1.0;
+        n_block = 0;
+        for(long i = 0; i < n_events; i++) {
+            sim_time += dt;
+            uint64_t t = sim_time;
+            uint32_t th = (t >> 11) & 0x0FFFFFFF;
+            if(th != time_high) {
+                time_high = th;
+                block[n_block++] = (0x08u << 28) | th;
+            }
+            uint32_t r = random();
+            block[n_block++] = ((r & 0x01) << 28) |
+                    ((uint32_t)(t & 0x7FF) << 17) |
+                    (((r >> 1) % 304) << 8) | ((r >> 10) % 240);
+        }
+
+        return n_block > 0;
+    }
+
+    virtual const uint32_t *decode(long &n_words)
+    {
+        n_words = n_block;
+        n_block = 0;
+        return block.data();
+    }
+
+};
+
+/******************************************************************************/
+//vEventBufferPool
+/******************************************************************************/
+
+/// \brief a fixed ring of event buffers passed from a single reader thread to
+/// a single publisher thread without locks. The reader fills the buffer at
+/// writeSlot() and publish()es it, the publisher reads the buffer at
+/// readSlot() and release()s it. Each buffer carries the number of events
+/// that were discarded because no buffer was free before it was filled.
+class vEventBufferPool {
+
+public:
+
+    struct slot {
+        std::vector<int32_t> data;
+        unsigned int n_events;
+        unsigned int n_lost;
+    };
+
+private:
+
+    std::vector<slot> slots;
+    std::atomic<unsigned long> produced;
+    std::atomic<unsigned long> consumed;
+
+public:
+
+    vEventBufferPool() : produced(0), consumed(0) {}
+
+    void initialise(unsigned int n_buffers, unsigned int events_per_buffer)
+    {
+        if(n_buffers < 2) n_buffers = 2;
+        slots.resize(n_buffers);
+        for(auto &s : slots) {
+            s.data.resize(events_per_buffer * 2);
+            s.n_events = 0;
+            s.n_lost = 0;
+        }
+        produced = 0;
+        consumed = 0;
+    }
+
+    unsigned int capacity() { return slots.empty() ? 0 : slots[0].data.size() / 2; }
+
+    /// \brief (reader) the buffer to fill, or nullptr if all are in use
+    slot *writeSlot()
+    {
+        unsigned long p = produced.load(std::memory_order_relaxed);
+        if(p - consumed.load(std::memory_order_acquire) >= slots.size())
+            return nullptr;
+        return &slots[p % slots.size()];
+    }
+
+    /// \brief (reader) hand the buffer from writeSlot() to the publisher
+    void publish()
+    {
+        produced.fetch_add(1, std::memory_order_release);
+    }
+
+    /// \brief (publisher) the next filled buffer, or nullptr if none
+    slot *readSlot()
+    {
+        unsigned long c = consumed.load(std::memory_order_relaxed);
+        if(c == produced.load(std::memory_order_acquire))
+            return nullptr;
+        return &slots[c % slots.size()];
+    }
+
+    /// \brief (publisher) return the buffer from readSlot() to the reader
+    void release()
+    {
+        consumed.fetch_add(1, std::memory_order_release);
+    }
+
+};
+
+#endif
@@ -24,11 +24,39 @@
 
 
 #include "i_events_stream.h"
+#include "evtDecoder.h"
 
 #include <yarp/os/all.h>
 #include <iCub/eventdriven/all.h>
 #include <string>
 
+/******************************************************************************/
+//ccamEVTSource
+/******************************************************************************/
+
+/// \brief reads blocks of EVT words from the chronocam SDK stream
+class ccamEVTSource : public evtSource {
+
+private:
+
+    Chronocam::I_EventsStream *stream;
+
+public:
+
+    ccamEVTSource(Chronocam::I_EventsStream &stream) : stream(&stream) {}
+
+    virtual bool poll()
+    {
+        return stream->poll_buffer();
+    }
+
+    virtual const uint32_t *decode(long &n_words)
+    {
+        return (const uint32_t *)stream->decode_buffer(n_words);
+    }
+
+};
+
 /******************************************************************************/
 //vDevReadBuffer
 /******************************************************************************/
@@ -36,49 +64,32 @@ class vDevReadBuffer : public yarp::os::Thread {
 
 private:
 
-    //parameters
-    unsigned int bufferSize;
-    unsigned int readSize;
-    long n_events;
-
-    unsigned int last_timestamp=0;
     const int width = 304;
     const int height = 240;
 
     //internal variables/storage
-    unsigned int readCount;
-    unsigned int lossCount;
-    unsigned int bytesperevent;
-    bool msgflag;
-
-    std::vector<unsigned char> *readBuffer;
-    std::vector<unsigned char> *accessBuffer;
-    std::vector<unsigned char> buffer1;
-    std::vector<unsigned char> buffer2;
-    std::vector<unsigned char> discardbuffer;
-    
-    uint32_t *ev_buffer;
-
-    yarp::os::Semaphore safety;
-    yarp::os::Semaphore signal;
-    bool bufferedreadwaiting;
+    evtSource *source;
+    vEventBufferPool *pool;
+    uint32_t time_high;
+    const uint32_t *words;
+    long n_words;
+    unsigned int pendingLoss;
+    std::vector<int32_t> discardbuffer;
 
-    Chronocam::I_EventsStream * stream = nullptr;
+    bool nextBlock();
 
 public:
 
     vDevReadBuffer();
 
-    bool initialise(Chronocam::I_EventsStream &stream,
-		            unsigned int bufferSize = 0,
+    bool initialise(evtSource &source, vEventBufferPool &pool,
                     unsigned int readSize = 0);
 
-    virtual long getEventChunk(unsigned char *target);
-    //virtual bool threadInit();      //run before thread starts
+    /// \brief decode up to max_events events from the current block of EVT
+    /// words into target
+    long getEventChunk(int32_t *target, long max_events);
     virtual void run();             //main function
-    //virtual void onStop();          //run when stop() is called (first)
     virtual void threadRelease();   //run after thread stops (second)
-    std::vector<unsigned char>& getBuffer(unsigned int &nBytesRead, unsigned int &nBytesLost);
 
 };
 
@@ -110,19 +121,21 @@ private:
     ev::vNoiseFilter vfilter;
 
     //data buffer thread
+    vEventBufferPool pool;
     vDevReadBuffer deviceReader;
 
-    int applysaltandpepperfilter(std::vector<unsigned char> &data, int nBytesRead);
-    void tsjumpcheck(std::vector<unsigned char> &data, int nBytesRead);
+    int applysaltandpepperfilter(int32_t *data, int nBytesRead);
+    void tsjumpcheck(int32_t *data, int nBytesRead);
 
 
 public:
 
     device2yarp();
-    bool initialise(Chronocam::I_EventsStream &stream,
+    bool initialise(evtSource &source,
                     std::string moduleName = "", bool check = false,
                     unsigned int bufferSize = 800000,
-                    unsigned int readSize = 1024, unsigned int chunkSize = 40960);
+                    unsigned int readSize = 1024, unsigned int chunkSize = 40960,
+                    unsigned int bufferCount = 4);
     void initialiseFilter(bool applyfilter, int width, int height, int temporalsize, int spatialSize)
     {
         this->applyfilter = applyfilter;
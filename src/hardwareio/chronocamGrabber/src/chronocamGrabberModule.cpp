@@ -54,49 +54,64 @@ bool chronocamGrabberModule::configure(yarp::os::ResourceFinder &rf) {
     bool jumpcheck = rf.check("jumpcheck") && rf.check("jumpcheck", yarp::os::Value(true)).asBool();
 
 
-    vsctrlMng = vDevCtrl();
+    //generate events without a camera (e.g. for benchmarking)
+    synthetic = rf.check("synthetic");
+    if(synthetic) {
+        double rate = rf.check("synthetic", yarp::os::Value(0.0)).asDouble();
+        yInfo() << "Generating synthetic events at" << rate << "v/s (0 = max)";
+        source = new syntheticEVTSource(rate);
+        if(!yarp::os::Network::checkNetwork()) {
+            yError() << "Could not connect to YARP network";
+            return false;
+        }
+    } else {
 
-    //bias values
-    yarp::os::Bottle biaslist = rf.findGroup("ATIS_BIAS");
+        vsctrlMng = vDevCtrl();
 
-    bool con_success = false;
+        //bias values
+        yarp::os::Bottle biaslist = rf.findGroup("ATIS_BIAS");
 
-    if(!vsctrlMng.setBias(biaslist)) {
-        std::cerr << "Bias file required to run chronocamGrabber" << std::endl;
-        return false;
-    }
-    std::cout << std::endl;
-    if(!vsctrlMng.connect())
-        std::cerr << "Could not connect to vision controller" << std::endl;
-    else
-        if(!vsctrlMng.configure(verbose)) {
-            std::cerr << "Could not configure camera" << std::endl;
-        } else {
-            con_success = true;
+        bool con_success = false;
+
+        if(!vsctrlMng.setBias(biaslist)) {
+            std::cerr << "Bias file required to run chronocamGrabber" << std::endl;
+            return false;
         }
+        std::cout << std::endl;
+        if(!vsctrlMng.connect())
+            std::cerr << "Could not connect to vision controller" << std::endl;
+        else
+            if(!vsctrlMng.configure(verbose)) {
+                std::cerr << "Could not configure camera" << std::endl;
+            } else {
+                con_success = true;
+            }
 
 
-    if(!con_success) {
-        std::cerr << "A configuration device was specified but could not be connected" << std::endl;
-        return false;
-    }
+        if(!con_success) {
+            std::cerr << "A configuration device was specified but could not be connected" << std::endl;
+            return false;
+        }
 
-    bool yarppresent = yarp::os::Network::checkNetwork();
-    if(!yarppresent)
-        yError() << "Could not connect to YARP network";
+        bool yarppresent = yarp::os::Network::checkNetwork();
+        if(!yarppresent)
+            yError() << "Could not connect to YARP network";
 
-    if(!yarppresent || biaswrite) {
-        vsctrlMng.disconnect(true);
-        std::cout << "Camera off" << std::endl;
-        return false;
-    }
+        if(!yarppresent || biaswrite) {
+            vsctrlMng.disconnect(true);
+            std::cout << "Camera off" << std::endl;
+            return false;
+        }
 
+        source = new ccamEVTSource(vsctrlMng.getStream());
+    }
 
     int readPacketSize = 8 * rf.check("readPacketSize", yarp::os::Value("512")).asInt();
     int bufferSize     = 8 * rf.check("bufferSize", yarp::os::Value("5120")).asInt();
     int maxBottleSize  = 8 * rf.check("maxBottleSize", yarp::os::Value("5120")).asInt();
+    int bufferCount    = rf.check("bufferCount", yarp::os::Value(4)).asInt();
 
-    if(!D2Y.initialise(vsctrlMng.getStream(), moduleName, errorcheck, bufferSize, readPacketSize, maxBottleSize)) {
+    if(!D2Y.initialise(*source, moduleName, errorcheck, bufferSize, readPacketSize, maxBottleSize, bufferCount)) {
         std::cout << "A data device was specified but could not be initialised" << std::endl;
         return false;
     } else {
@@ -140,13 +155,15 @@ bool chronocamGrabberModule::interruptModule() {
     std::cout << "done" << std::endl;
 
     std::cout << "closing device drivers.. ";
-    vsctrlMng.disconnect(true);
+    if(!synthetic) vsctrlMng.disconnect(true);
     std::cout << "done" << std::endl;
     return true;
 }
 
 bool chronocamGrabberModule::close() {
 
+    delete source;
+    source = nullptr;
     return true;
 }
 
@@ -185,7 +202,16 @@ bool chronocamGrabberModule::respond(const yarp::os::Bottle& command,
         reply.addString("ok");
     }
 
-    switch (command.get(0).asVocab()) {
+    //there is no device to configure when generating synthetic events
+    int vocab = command.get(0).asVocab();
+    if(synthetic && (vocab == COMMAND_VOCAB_PROG || vocab == COMMAND_VOCAB_PWROFF ||
+                     vocab == COMMAND_VOCAB_PWRON)) {
+        reply.addString("no device");
+        reply.addVocab(COMMAND_VOCAB_FAILED);
+        return true;
+    }
+
+    switch (vocab) {
     case COMMAND_VOCAB_HELP:
         rec = true;
     {
@@ -28,6 +28,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <algorithm>
 
 
 /******************************************************************************/
@@ -35,158 +36,81 @@
 /******************************************************************************/
 vDevReadBuffer::vDevReadBuffer()
 {
-    //parameters
-    bufferSize = 800000;  //bytes
-    readSize = 1024;      //bytes
-
-    //internal variables/storage
-    readCount = 0;
-    lossCount = 0;
-
-    bufferedreadwaiting = false;
-
+    source = nullptr;
+    pool = nullptr;
+    time_high = 0;
+    words = nullptr;
+    n_words = 0;
+    pendingLoss = 0;
+    discardbuffer.resize(1024);
 }
 
-
-
-long vDevReadBuffer::getEventChunk(unsigned char* target)
+bool vDevReadBuffer::initialise(evtSource &source, vEventBufferPool &pool,
+                                unsigned int readSize)
 {
-    long n_TD = 0;
-    uint64_t *target64 = (uint64_t*) target;
-    uint32_t ts = 0;
-    //std::cout << "n_events:" << n_events << std::endl;
-    while (n_TD<512) {
-        if (n_events == 0) {
-            if (!stream->poll_buffer()) {
-        //usleep(1);
-                break;
-            }
-            ev_buffer = (uint32_t*)stream->decode_buffer(n_events);
-        }
-        EventBase * evbase = reinterpret_cast<EventBase*>(ev_buffer);
-        if(static_cast<Event_Types_underlying>(Event_Types::EVT_TIME_HIGH) == evbase->type) {
-            Event_EVT_TIME_HIGH ev = *reinterpret_cast<Event_EVT_TIME_HIGH*>(ev_buffer);
-        last_timestamp = ((uint64_t) ev.timestamp)<<11;
-        } else if(static_cast<Event_Types_underlying>(Event_Types::LEFT_TD_LOW) == evbase->type) {
-            Event_EVENT2D ev = *reinterpret_cast<Event_EVENT2D*>(ev_buffer);
-        ts = ((last_timestamp + (uint32_t) ev.timestamp)%(1<<24));
-        uint64_t encoded = ((uint64_t) ts)|((uint64_t)(this->height-1-ev.y)<<42)|((uint64_t)(this->width-1-ev.x)<<33)|0UL<<32;
-        *target64++ = encoded;
-            ++n_TD;
-        } else if(static_cast<Event_Types_underlying>(Event_Types::LEFT_TD_HIGH) == evbase->type) {
-            Event_EVENT2D ev = *reinterpret_cast<Event_EVENT2D*>(ev_buffer);
-        ts = ((last_timestamp + (uint32_t) ev.timestamp)%(1<<24));
-        uint64_t encoded = ((uint64_t) ts)|((uint64_t)(this->height-1-ev.y)<<42)|((uint64_t)(this->width-1-ev.x)<<33)|1UL<<32;
-        *target64++ = encoded;
-            ++n_TD;
-        }
-    ev_buffer++;
-    n_events--;
-    }
-
-
-    //std::cout << "sending " << n_TD << " events" << std::endl;
-    return n_TD*8;
+    this->source = &source;
+    this->pool = &pool;
+    if(readSize > 0) discardbuffer.resize(readSize / 4);
+    return true;
 }
 
-
-bool vDevReadBuffer::initialise(Chronocam::I_EventsStream &stream,
-                                unsigned int bufferSize,
-                                unsigned int readSize)
+bool vDevReadBuffer::nextBlock()
 {
+    if(!source->poll())
+        return false;
+    words = source->decode(n_words);
+    return n_words > 0;
+}
 
-
-    this->stream = &stream;
-    if(bufferSize > 0) this->bufferSize = bufferSize;
-    if(readSize > 0) this->readSize = readSize;
-
-    buffer1.resize(this->bufferSize);
-    buffer2.resize(this->bufferSize);
-    discardbuffer.resize(this->readSize);
-
-    readBuffer = &buffer1;
-    accessBuffer = &buffer2;
-
-    return true;
-
-    }
+long vDevReadBuffer::getEventChunk(int32_t *target, long max_events)
+{
+    //each word produces at most one event
+    long n = std::min(n_words, max_events);
+    long n_events = decodeEVT(words, n, target, time_high, width, height);
+    words += n;
+    n_words -= n;
+    return n_events;
+}
 
 void vDevReadBuffer::run()
-    {
-
-
-        signal.check();
-
-        while(!isStopping()) {
-
-        safety.wait();
-
-        int r = 0;
-        if(readCount >= bufferSize) {
-            //we have reached maximum software buffer - read from the HW but
-            //just discard the result.
-            //TODO: read events!
-            //r = read(fd, discardbuffer.data(), readSize);
-            r = getEventChunk(discardbuffer.data());
-            //std::cout << "discarded " << r << " events" << std::endl;
-            if(r > 0) lossCount += r;
-        } else {
-            //we read and fill up the buffer
-            //TODO: read events!
-            //r = read(fd, readBuffer->data() + readCount, std::min(bufferSize - readCount, readSize));
-            r = getEventChunk(readBuffer->data() + readCount);
-            //if (r>0) std::cout << "read " << r << " events" << std::endl;
-            if(r > 0) readCount += r;
-        }
+{
+    ev::vMetrics::get().registerThread("chronocamGrabber/read");
+    unsigned int capacity = pool->capacity();
 
-        if(r < 0 && errno != EAGAIN) {
-            perror("Error reading events: ");
-        }
+    while(!isStopping()) {
 
-        safety.post();
-        if(bufferedreadwaiting) {
-            //the other thread is read to read
-            signal.wait(); //wait for it to do the read
-        }
+        vEventBufferPool::slot *buffer = pool->writeSlot();
 
+        if(!buffer) {
+            //all buffers are waiting to be published - read from the device
+            //but just discard the result.
+            if(n_words || nextBlock())
+                pendingLoss += getEventChunk(discardbuffer.data(),
+                                             discardbuffer.size() / 2);
+            continue;
         }
 
+        //decode whole blocks until the buffer is full or the device is empty
+        buffer->n_events = 0;
+        while(buffer->n_events < capacity && (n_words || nextBlock()))
+            buffer->n_events += getEventChunk(buffer->data.data() + 2 * buffer->n_events,
+                                              capacity - buffer->n_events);
 
-    }
-
-    void vDevReadBuffer::threadRelease()
-    {
-        //close
-    }
-
-    std::vector<unsigned char>& vDevReadBuffer::getBuffer(unsigned int &nBytesRead, unsigned int &nBytesLost)
-    {
-
-        //safely copy the data into the accessBuffer and reset the readCount
-        bufferedreadwaiting = true;
-        safety.wait();
-        bufferedreadwaiting = false;
-
-        //switch the buffer the read into
-        std::vector<unsigned char> *temp;
-        temp = readBuffer;
-        readBuffer = accessBuffer;
-        accessBuffer = temp;
+        if(!buffer->n_events)
+            continue;
 
-        //reset the filling position
-        nBytesRead = readCount;
-        nBytesLost = lossCount;
-        readCount = 0;
-        lossCount = 0;
+        buffer->n_lost = pendingLoss;
+        pendingLoss = 0;
+        pool->publish();
 
-        //send the correct signals to restart the grabbing thread
-        safety.post();
-        signal.check();
-        signal.post(); //tell the other thread we are done
+    }
 
-        return *accessBuffer;
+}
 
-    }
+void vDevReadBuffer::threadRelease()
+{
+    //close
+}
 
     /******************************************************************************/
 
@@ -204,15 +128,19 @@ void vDevReadBuffer::run()
     }
 
 
-bool device2yarp::initialise(Chronocam::I_EventsStream &stream,
+bool device2yarp::initialise(evtSource &source,
                              std::string moduleName, bool check,
                              unsigned int bufferSize,
-                             unsigned int readSize, unsigned int chunkSize)
+                             unsigned int readSize, unsigned int chunkSize,
+                             unsigned int bufferCount)
 {
 
     this->chunksize = chunkSize;
-    if(!deviceReader.initialise(stream, bufferSize, readSize))
+    pool.initialise(bufferCount, bufferSize / 8);
+    if(!deviceReader.initialise(source, pool, readSize))
         return false;
+    yInfo() << "Reading events into" << bufferCount << "buffers of"
+            << bufferSize / 8 << "events";
 
     this->errorchecking = check;
     yInfo() << "yarp::os::Port used - which is always strict";
@@ -230,11 +158,11 @@ void device2yarp::afterStart(bool success)
     if(success) deviceReader.start();
 }
 
-void device2yarp::tsjumpcheck(std::vector<unsigned char> &data, int nBytesRead)
+void device2yarp::tsjumpcheck(int32_t *data, int nBytesRead)
 {
-    int pTS = *((int *)(data.data() + 0)) & 0x7FFFFFFF;
-    for(int i = 0; i < nBytesRead; i+=8) {
-        int TS =  *((int *)(data.data() + i)) & 0x7FFFFFFF;
+    int pTS = data[0] & 0x7FFFFFFF;
+    for(int i = 0; i < nBytesRead / 4; i+=2) {
+        int TS =  data[i] & 0x7FFFFFFF;
         int dt = TS - pTS;
         if(dt < 0) {
             yError() << "stamp jump" << pTS << " " << TS;
@@ -243,34 +171,25 @@ void device2yarp::tsjumpcheck(std::vector<unsigned char> &data, int nBytesRead)
     }
 }
 
-int device2yarp::applysaltandpepperfilter(std::vector<unsigned char> &data, int nBytesRead)
+int device2yarp::applysaltandpepperfilter(int32_t *data, int nBytesRead)
 {
-    int k = 0;
-    for(int i = 0; i < nBytesRead; i+=8) {
-        int *TS =  (int *)(data.data() + i);
-
-        int *AE =  (int *)(data.data() + i + 4);
-
-        int p = (*AE)&0x01;
-        int x = ((*AE)>>1)&0x1FF;
-        int y = ((*AE)>>10)&0xFF;
-        int c = ((*AE)>>20)&0x01;
-        int ts = (*TS) & 0x00FFFFFF;
-
-        if(vfilter.check(x, y, p, c, ts)) {
-            for(int j = i; j < i+8; j++) {
-                data[k++] = data[j];
-            }
-        }
-
-    }
-
-    return k;
-
+    auto decode = [](const int32_t *pair, int &x, int &y, int &p, int &c,
+                     int &ts) {
+        int AE = pair[1];
+        p = AE&0x01;
+        x = (AE>>1)&0x1FF;
+        y = (AE>>10)&0xFF;
+        c = (AE>>20)&0x01;
+        ts = pair[0] & 0x00FFFFFF;
+    };
+
+    return vfilter.filter(data, nBytesRead / 8, decode) * 8;
 }
 
 void  device2yarp::run() {
 
+    ev::vMetrics::get().registerThread("chronocamGrabber/device2yarp");
+
     ev::vPortableInterface external_storage;
     external_storage.setHeader(ev::AE::tag);
 
@@ -287,12 +206,18 @@ void  device2yarp::run() {
             prevAEs = countAEs;
         }
 
-        //get the data from the device read thread
-        unsigned int nBytesRead, nBytesLost;
-        std::vector<unsigned char> &data = deviceReader.getBuffer(nBytesRead, nBytesLost);
-        countAEs += nBytesRead / 8;
-        countLoss += nBytesLost / 8;
-        if (nBytesRead <= 0) continue;
+        //get the next buffer filled by the device read thread
+        vEventBufferPool::slot *buffer = pool.readSlot();
+        if(!buffer) {
+            yarp::os::Time::delay(0.0001);
+            continue;
+        }
+
+        unsigned int nBytesRead = buffer->n_events * 8;
+        int32_t *data_ints = buffer->data.data();
+        const char *data = (const char *)data_ints;
+        countAEs += buffer->n_events;
+        countLoss += buffer->n_lost;
 
         bool dataError = false;
 
@@ -303,10 +228,10 @@ void  device2yarp::run() {
         }
 
         if(applyfilter)
-            nBytesRead = applysaltandpepperfilter(data, nBytesRead);
+            nBytesRead = applysaltandpepperfilter(data_ints, nBytesRead);
 
         if(jumpcheck)
-            tsjumpcheck(data, nBytesRead);
+            tsjumpcheck(data_ints, nBytesRead);
 
         if(portEventCount.getOutputCount() && nBytesRead) {
             yarp::os::Bottle &ecb = portEventCount.prepare();
@@ -316,10 +241,11 @@ void  device2yarp::run() {
         }
 
         //if we don't want or have nothing to send or there is an error finish here.
-        if(!portvBottle.getOutputCount() || nBytesRead < 8)
+        if(!portvBottle.getOutputCount() || nBytesRead < 8) {
+            pool.release();
             continue;
+        }
 
-    //std::cout << *(int*)data.data() << std::endl;
         //typical ZYNQ behaviour to skip error checking
         unsigned int i = 0;
         i = 0;
@@ -328,7 +254,7 @@ void  device2yarp::run() {
             while((i+1) * chunksize < nBytesRead) {
 
                 //ev::vBottleMimic &vbm = portvBottle.prepare();
-                external_storage.setExternalData((const char *)data.data() + i*chunksize, chunksize);
+                external_storage.setExternalData(data + i*chunksize, chunksize);
                 vStamp.update();
                 portvBottle.setEnvelope(vStamp);
                 portvBottle.write(external_storage);
@@ -339,13 +265,14 @@ void  device2yarp::run() {
             }
 
             //ev::vBottleMimic &vbm = portvBottle.prepare();
-            external_storage.setExternalData((const char *)data.data() + i*chunksize, nBytesRead - i*chunksize);
+            external_storage.setExternalData(data + i*chunksize, nBytesRead - i*chunksize);
             vStamp.update();
             portvBottle.setEnvelope(vStamp);
             portvBottle.write(external_storage);
             //portvBottle.write(strict);
             //portvBottle.waitForWrite();
 
+            pool.release();
             continue;						//return here.
         }
 
@@ -356,8 +283,8 @@ void  device2yarp::run() {
         while(bend < (int)nBytesRead - 7) {
 
             //check validity
-            int *TS =  (int *)(data.data() + bend);
-            int *AE =  (int *)(data.data() + bend + 4);
+            int *TS =  (int *)(data + bend);
+            int *AE =  (int *)(data + bend + 4);
             bool BITMISMATCH = !(*TS & 0x80000000) || (*AE & 0xFBE00000);
 
             if(BITMISMATCH) {
@@ -367,7 +294,7 @@ void  device2yarp::run() {
                     std::cerr << *TS << " " << *AE << std::endl;
 
                     //ev::vBottleMimic &vbm = portvBottle.prepare();
-                    external_storage.setExternalData((const char *)data.data()+bstart, bend-bstart);
+                    external_storage.setExternalData(data+bstart, bend-bstart);
                     countAEs += (bend - bstart) / 8;
                     vStamp.update();
                     portvBottle.setEnvelope(vStamp);
@@ -387,7 +314,7 @@ void  device2yarp::run() {
 
         if(nBytesRead - bstart > 7) {
             //ev::vBottleMimic &vbm = portvBottle.prepare();
-            external_storage.setExternalData((const char *)data.data()+bstart, 8*((nBytesRead-bstart)/8));
+            external_storage.setExternalData(data+bstart, 8*((nBytesRead-bstart)/8));
             countAEs += (nBytesRead - bstart) / 8;
             vStamp.update();
             portvBottle.setEnvelope(vStamp);
@@ -395,6 +322,8 @@ void  device2yarp::run() {
             //if(strict) portvBottle.writeStrict();
             //else portvBottle.write();
         }
+
+        pool.release();
     }
 
 }
@@ -24,6 +24,7 @@
 #include <iCub/eventdriven/all.h>
 #include <string>
 #include <vector>
+#include <atomic>
 
 using namespace yarp::os;
 using namespace ev;
@@ -37,22 +38,57 @@ class device2yarp : public yarp::os::Thread {
 
 private:
 
+    //sends filled buffers so that the next device read overlaps the write
+    class packetSender : public yarp::os::Thread {
+    private:
+        device2yarp *source;
+    public:
+        packetSender() : source(nullptr) {}
+        void setSource(device2yarp *source) { this->source = source; }
+        void run()
+        {
+            ev::vMetrics::get().registerThread("zynqGrabber/sender");
+            source->sendPackets();
+        }
+        void onStop() { source->full_buffers.post(); }
+    };
+
     //data buffer thread
     int fd;
-    std::vector<unsigned char> data;
+    bool replay;
+    std::vector< std::vector<unsigned char> > buffers;
+    std::vector<unsigned int> buffer_bytes;
+    std::vector<Stamp> buffer_stamps;
+    yarp::os::Semaphore free_buffers;
+    yarp::os::Semaphore full_buffers;
+    packetSender sender;
     yarp::os::Port output_port;
-    Stamp yarp_stamp;
+    vSharedRing shared;
 
     //parameters
     unsigned int max_dma_pool_size;
     unsigned int max_packet_size;
+    double max_packet_latency;
+
+    //statistics
+    unsigned int read_stalls;
+    std::atomic<unsigned long> events_read;
+
+    unsigned int readPacket(unsigned char *buffer);
+    void sendPackets();
 
 public:
 
     device2yarp();
     bool open(string module_name, int fd, unsigned int pool_size,
-              unsigned int packet_size);
+              unsigned int packet_size, unsigned int buffer_count = 1,
+              double packet_latency = 0.0, bool replay = false);
+    bool enableSharedMemory();
 
+    /// \brief the total number of events read from the device
+    unsigned long getEventCount() { return events_read; }
+
+    bool threadInit();
     void run();
     void onStop();
 
@@ -94,6 +130,7 @@ private:
     yarp2device Y2D;
 
     int pool_size;
+    bool replay;
     bool read_thread_open;
     bool write_thread_open;
 
@@ -103,11 +140,17 @@ public:
 
     bool configureDevice(string device_name, bool spinnaker = false,
                          bool loopback = false);
-    bool openReadPort(string module_name, unsigned int packet_size);
+    bool openReadPort(string module_name, unsigned int packet_size,
+                      unsigned int buffer_count = 1,
+                      double packet_latency = 0.0,
+                      bool shared_output = false);
     bool openWritePort(string module_name);
     void start();
     void stop();
 
+    /// \brief the total number of events read from the device
+    unsigned long getEventCount();
+
 };
 
 #endif
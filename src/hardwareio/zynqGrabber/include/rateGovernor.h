@@ -0,0 +1,148 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *           chiara.bartolozzi@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RATEGOVERNOR__
+#define __RATEGOVERNOR__
+
+#include <yarp/os/all.h>
+#include <string>
+#include <vector>
+
+class vVisionCtrl;
+
+/******************************************************************************/
+//simulatedSensor
+/******************************************************************************/
+
+/// \brief a model of the event rate of a sensor given its biases, to try the
+/// governor without hardware. The scene activity varies sinusoidally around
+/// a base rate, and each step a bias is moved from its nominal value scales
+/// the rate by a constant gain.
+class simulatedSensor {
+
+private:
+
+    double base_rate;
+    double variation;
+    double period;
+    double gain;
+    double start;
+    double count;
+    double prev_time;
+
+public:
+
+    simulatedSensor();
+    void configure(double base_rate, double variation, double period,
+                   double gain);
+
+    /// \brief advance the model to now, given the number of steps the biases
+    /// are away from nominal (positive lowers the rate)
+    /// \returns the total number of events generated
+    unsigned long update(double steps);
+
+};
+
+/******************************************************************************/
+//rateGovernor
+/******************************************************************************/
+
+/// \brief closed-loop control of the ATIS biases to keep the event rate
+/// under a budget. Each period the rate measured by the device reader and
+/// the delay reported by downstream modules are compared to the budget: if
+/// either is over, one bias is moved one step in the direction that lowers
+/// the rate (the biases are tried in the order given, up to their safe
+/// limit); if both are well under, the last bias moved is stepped back
+/// towards its nominal value. Biases are never moved past nominal when
+/// relaxing or past their limit when tightening, and at most one change is
+/// made per settle time, as reprogramming the biases disturbs the rate.
+class rateGovernor {
+
+private:
+
+    struct rule {
+        std::string name;
+        int nominal;
+        int value;
+        int limit;
+        int step;
+    };
+
+    yarp::os::Mutex m;
+    yarp::os::Mutex *bias_mutex;
+    std::vector<rule> rules;
+    std::vector<vVisionCtrl *> cameras;
+    yarp::os::BufferedPort<yarp::os::Bottle> delay_port;
+    std::string logfile;
+
+    //parameters
+    bool enabled;
+    double target_rate;
+    double relax_fraction;
+    double max_delay;
+    double settle_time;
+
+    //state
+    unsigned long prev_count;
+    double prev_time;
+    double rate;
+    double delay;
+    double delay_time;
+    double change_time;
+    int changes;
+
+    bool simulate;
+    simulatedSensor sensor;
+
+    bool move(rule &r, int value);
+    void log(const std::string &message);
+    int stepsFromNominal();
+
+public:
+
+    rateGovernor();
+
+    /// \brief read the parameters of the RATE_GOVERNOR group. The nominal
+    /// bias values are taken from biases (a bias group of the ini file) and
+    /// changes are programmed in each of the cameras given, holding
+    /// bias_mutex as the rpc programs the same cameras.
+    bool configure(yarp::os::Bottle &params, yarp::os::Bottle &biases,
+                   std::vector<vVisionCtrl *> cameras,
+                   yarp::os::Mutex *bias_mutex,
+                   std::string module_name, std::string logfile);
+
+    /// \brief measure the rate from the total event count and adjust the
+    /// biases if needed (in simulation the count is ignored)
+    void update(unsigned long event_count);
+
+    void enable(bool enabled = true);
+    bool setTarget(double target_rate);
+
+    /// \brief reset every bias to its nominal value
+    void reset();
+
+    /// \brief the controller state as (name value) pairs
+    yarp::os::Bottle state();
+
+    bool isSimulated() { return simulate; }
+    void close();
+
+};
+
+#endif
@@ -38,6 +38,7 @@
 #define COMMAND_VOCAB_PWRON   createVocab('o','n')
 #define COMMAND_VOCAB_RST     createVocab('r','s','t')
 #define COMMAND_VOCAB_SETSKIN createVocab('s','s','e','t') // set regName regValue
+#define COMMAND_VOCAB_GOV     createVocab('g','o','v') // gov <on|off|target <rate>|reset>
 
 
 
@@ -54,6 +55,7 @@
 #include "hpuInterface.h"
 #include "visionController.h"
 #include "skinController.h"
+#include "rateGovernor.h"
 
 class zynqGrabberModule : public yarp::os::RFModule {
 
@@ -63,9 +65,15 @@ class zynqGrabberModule : public yarp::os::RFModule {
     vVisionCtrl vsctrlMngLeft;
     vVisionCtrl vsctrlMngRight;
     vSkinCtrl   skctrlMng;
+    //the rpc and the rate governor both program the cameras
+    yarp::os::Mutex bias_mutex;
 
     hpuInterface hpu;
 
+    //keeps the event rate under a budget by adjusting the biases
+    rateGovernor governor;
+    bool governed;
+
 public:
 
     bool configure(yarp::os::ResourceFinder &rf); // configure all the module parameters and return true if successful
@@ -22,11 +22,13 @@
 
 #include <sys/ioctl.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <errno.h>
 #include <iostream>
 #include <iomanip>
 #include <cstring>
+#include <algorithm>
 
 /******************************************************************************/
 //device2yarp
@@ -35,14 +37,24 @@
 device2yarp::device2yarp()
 {
     fd = -1;
+    replay = false;
     max_dma_pool_size = 0;
     max_packet_size = 0;
+    max_packet_latency = 0.0;
+    read_stalls = 0;
+    events_read = 0;
+    sender.setSource(this);
+
+    free_buffers.wait(); //init counters to 0
+    full_buffers.wait();
 }
 
 bool device2yarp::open(string module_name, int fd, unsigned int pool_size,
-                       unsigned int packet_size)
+                       unsigned int packet_size, unsigned int buffer_count,
+                       double packet_latency, bool replay)
 {
     this->fd = fd;
+    this->replay = replay;
 
     if(pool_size > packet_size) {
         packet_size = pool_size;
@@ -50,51 +62,132 @@ bool device2yarp::open(string module_name, int fd, unsigned int pool_size,
     }
     this->max_packet_size = packet_size;
     this->max_dma_pool_size = pool_size;
+    this->max_packet_latency = packet_latency;
 
-    data.resize(max_packet_size);
+    if(buffer_count < 1) buffer_count = 1;
+    buffers.resize(buffer_count);
+    for(unsigned int i = 0; i < buffer_count; i++)
+        buffers[i].resize(max_packet_size);
+    buffer_bytes.resize(buffer_count, 0);
+    buffer_stamps.resize(buffer_count);
 
     return output_port.open(module_name + "/AE:o");
 }
 
+bool device2yarp::enableSharedMemory()
+{
+    //room for at least a few hundred maximum size packets
+    return shared.create(output_port.getName(),
+                         std::max(16777216u, 256 * max_packet_size));
+}
+
+bool device2yarp::threadInit()
+{
+    //all buffers start empty and available to the reader
+    for(unsigned int i = 0; i < buffers.size(); i++)
+        free_buffers.post();
+
+    return sender.start();
+}
+
+unsigned int device2yarp::readPacket(unsigned char *buffer)
+{
+    unsigned int n_bytes_read = 0;
+    double deadline = 0.0;
+
+    while(n_bytes_read < max_packet_size) {
+
+        int r = read(fd, buffer + n_bytes_read, max_packet_size - n_bytes_read);
+        if(r < 0) {
+            yInfo() << "[READ ]" << std::strerror(errno);
+            break;
+        } else if(r == 0 && replay) {
+            //loop the recorded file
+            lseek(fd, 0, SEEK_SET);
+        } else {
+            n_bytes_read += r;
+        }
+
+        if(max_packet_latency <= 0.0) {
+            //no deadline - send as soon as the driver has no full pool ready
+            if(r < (int)max_dma_pool_size) break;
+        } else {
+            //deadline - keep filling the packet until the first event read
+            //is max_packet_latency old
+            if(n_bytes_read && deadline == 0.0)
+                deadline = yarp::os::Time::now() + max_packet_latency;
+            if(deadline > 0.0 && yarp::os::Time::now() >= deadline) break;
+        }
+    }
+
+    return n_bytes_read;
+}
+
+void device2yarp::sendPackets()
+{
+    vPortableInterface external_storage;
+    external_storage.setHeader(AE::tag);
+
+    unsigned int i = 0;
+    while(true) {
+
+        full_buffers.wait();
+        if(sender.isStopping()) break;
+
+        external_storage.setExternalData((const char *)buffers[i].data(),
+                                         buffer_bytes[i]);
+        if(shared.isOpen())
+            external_storage.writeShared(shared, buffer_stamps[i]);
+        if(!shared.isOpen() || output_port.getOutputCount()) {
+            output_port.setEnvelope(buffer_stamps[i]);
+            output_port.write(external_storage);
+        }
+
+        free_buffers.post();
+        i = (i + 1) % buffers.size();
+    }
+}
+
 void  device2yarp::run() {
 
+    ev::vMetrics::get().registerThread("zynqGrabber/device2yarp");
+
     if(fd < 0) {
         yError() << "HPU reading device not open";
         return;
     }
 
-    vPortableInterface external_storage;
-    external_storage.setHeader(AE::tag);
-
     unsigned int event_count = 0;
     unsigned int prev_ts = 0;
+    unsigned int i = 0;
 
     while(!isStopping()) {
 
-        int r = max_dma_pool_size;
-        unsigned int n_bytes_read = 0;
-        while(r >= (int)max_dma_pool_size && n_bytes_read < max_packet_size) {
-            r = read(fd, data.data() + n_bytes_read, max_packet_size - n_bytes_read);
-            if(r < 0)
-                yInfo() << "[READ ]" << std::strerror(errno);
-            else
-                n_bytes_read += r;
+        //if all buffers are still being sent we have to wait for a free one
+        if(!free_buffers.check()) {
+            read_stalls++;
+            free_buffers.wait();
         }
+        if(isStopping()) break;
 
-        if(n_bytes_read == 0) continue;
-        
-        unsigned int first_ts = *(unsigned int *)data.data();
-        if(prev_ts > first_ts)
+        unsigned int n_bytes_read = readPacket(buffers[i].data());
+        if(n_bytes_read == 0) {
+            free_buffers.post();
+            continue;
+        }
+
+        unsigned int first_ts = *(unsigned int *)buffers[i].data();
+        if(prev_ts > first_ts && !replay)
             yWarning() << prev_ts << "->" << first_ts;
         prev_ts = first_ts;
-        
 
-        external_storage.setExternalData((const char *)data.data(), n_bytes_read);
-        yarp_stamp.update();
-        output_port.setEnvelope(yarp_stamp);
-        output_port.write(external_storage);
+        buffer_bytes[i] = n_bytes_read;
+        buffer_stamps[i].update();
+        full_buffers.post();
+        i = (i + 1) % buffers.size();
 
         event_count += n_bytes_read / 8;
+        events_read += n_bytes_read / 8;
 
         static double prev_ts = yarp::os::Time::now();
         double update_period = yarp::os::Time::now() - prev_ts;
@@ -102,10 +195,11 @@ void  device2yarp::run() {
 
             yInfo() << "[READ ]"
                     << (int)(event_count/(1000.0*update_period))
-                    << "kV/s";
+                    << "kV/s" << read_stalls << "reads waited for a free buffer";
 
             prev_ts += update_period;
             event_count = 0;
+            read_stalls = 0;
         }
     }
 
@@ -113,7 +207,11 @@ void  device2yarp::run() {
 
 void device2yarp::onStop()
 {
+    output_port.interrupt();
+    sender.stop();
+    free_buffers.post();
     output_port.close();
+    shared.close();
 }
 
 /******************************************************************************/
@@ -140,6 +238,7 @@ void yarp2device::onStop()
 
 void yarp2device::run()
 {
+    ev::vMetrics::get().registerThread("zynqGrabber/yarp2device");
 
     while(true) {
 
@@ -210,6 +309,8 @@ void yarp2device::run()
 hpuInterface::hpuInterface()
 {
     fd = -1;
+    pool_size = 0;
+    replay = false;
     read_thread_open = false;
     write_thread_open = false;
 }
@@ -229,6 +330,16 @@ bool hpuInterface::configureDevice(string device_name, bool spinnaker, bool loop
         }
     }
 
+    //a recorded file in place of the device can be replayed for benchmarking
+    //without hardware. There are no registers to configure.
+    struct stat device_stat;
+    if(fstat(fd, &device_stat) == 0 && S_ISREG(device_stat.st_mode)) {
+        replay = true;
+        pool_size = 4096;
+        yWarning() << device_name << "is a file: replaying recorded HPU data";
+        return true;
+    }
+
 
     //READ ID
     unsigned int version = 0;
@@ -368,18 +479,31 @@ bool hpuInterface::configureDevice(string device_name, bool spinnaker, bool loop
     return true;
 }
 
-bool hpuInterface::openReadPort(string module_name, unsigned int packet_size)
+bool hpuInterface::openReadPort(string module_name, unsigned int packet_size,
+                                unsigned int buffer_count,
+                                double packet_latency, bool shared_output)
 {
-    if(fd < 0 || !D2Y.open(module_name, fd, pool_size, packet_size))
+    if(fd < 0 || !D2Y.open(module_name, fd, pool_size, packet_size,
+                           buffer_count, packet_latency, replay))
+        return false;
+    if(shared_output && !D2Y.enableSharedMemory())
         return false;
 
     yInfo() << "Maximum packet size:" << packet_size;
+    yInfo() << "Read buffers:" << buffer_count;
+    if(packet_latency > 0.0)
+        yInfo() << "Packet latency deadline:" << packet_latency << "s";
     read_thread_open = true;
     return true;
 }
 
 bool hpuInterface::openWritePort(string module_name)
 {
+    if(replay) {
+        yError() << "Cannot write events when replaying a recorded file";
+        return false;
+    }
+
     if(fd < 0 || !Y2D.open(module_name, fd))
         return false;
 
@@ -396,6 +520,11 @@ void hpuInterface::start()
         Y2D.start();
 }
 
+unsigned long hpuInterface::getEventCount()
+{
+    return D2Y.getEventCount();
+}
+
 void hpuInterface::stop()
 {
     if(read_thread_open) {
@@ -407,6 +536,11 @@ void hpuInterface::stop()
         write_thread_open = false;
     }
 
+    if(replay) {
+        close(fd); fd = -1;
+        return;
+    }
+
     //READ Raw Status Register
     hpu_regs_t hpu_regs = {0x18, 0, 0};
     if (-1 == ioctl(fd, HPU_GEN_REG, &hpu_regs)){
@@ -0,0 +1,310 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *           chiara.bartolozzi@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "rateGovernor.h"
+#include "visionController.h"
+
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+using namespace yarp::os;
+
+/******************************************************************************/
+//simulatedSensor
+/******************************************************************************/
+
+simulatedSensor::simulatedSensor()
+{
+    configure(2e6, 0.5, 20.0, 0.85);
+}
+
+void simulatedSensor::configure(double base_rate, double variation,
+                                double period, double gain)
+{
+    this->base_rate = base_rate;
+    this->variation = variation;
+    this->period = period > 0 ? period : 1.0;
+    this->gain = gain;
+    start = Time::now();
+    prev_time = start;
+    count = 0;
+}
+
+unsigned long simulatedSensor::update(double steps)
+{
+    double now = Time::now();
+    double activity = 1.0 + variation *
+            std::sin(2.0 * M_PI * (now - start) / period);
+    double noise = 1.0 + 0.05 * (2.0 * std::rand() / RAND_MAX - 1.0);
+    double rate = base_rate * activity * noise * std::pow(gain, steps);
+
+    count += rate * (now - prev_time);
+    prev_time = now;
+    return count;
+}
+
+/******************************************************************************/
+//rateGovernor
+/******************************************************************************/
+
+rateGovernor::rateGovernor()
+{
+    enabled = false;
+    target_rate = 1e6;
+    relax_fraction = 0.6;
+    max_delay = 0.0;
+    settle_time = 2.0;
+
+    prev_count = 0;
+    prev_time = 0.0;
+    rate = 0.0;
+    delay = 0.0;
+    delay_time = 0.0;
+    change_time = 0.0;
+    changes = 0;
+    simulate = false;
+    bias_mutex = nullptr;
+}
+
+bool rateGovernor::configure(Bottle &params, Bottle &biases,
+                             std::vector<vVisionCtrl *> cameras,
+                             Mutex *bias_mutex,
+                             std::string module_name, std::string logfile)
+{
+    this->cameras = cameras;
+    this->bias_mutex = bias_mutex;
+    this->logfile = logfile;
+
+    target_rate = params.check("target_rate", Value(1e6)).asDouble();
+    relax_fraction = params.check("relax_fraction", Value(0.6)).asDouble();
+    max_delay = params.check("max_delay", Value(0.0)).asDouble();
+    settle_time = params.check("settle_time", Value(2.0)).asDouble();
+    enabled = !params.check("enabled") ||
+            params.check("enabled", Value(true)).asBool();
+    simulate = params.check("simulate") &&
+            params.check("simulate", Value(true)).asBool();
+
+    //(name limit step) where limit is the safe value in the direction
+    //that lowers the rate
+    Bottle *list = params.find("biases").asList();
+    if(!list || !list->size()) {
+        yError() << "The rate governor needs a list of biases";
+        return false;
+    }
+    rules.clear();
+    for(int i = 0; i < (int)list->size(); i++) {
+        Bottle *b = list->get(i).asList();
+        if(!b || b->size() < 3) {
+            yError() << "Governor biases are (name limit step):"
+                     << list->get(i).toString();
+            return false;
+        }
+        rule r;
+        r.name = b->get(0).asString();
+        r.limit = b->get(1).asInt();
+        r.step = std::abs(b->get(2).asInt());
+        Bottle &vals = biases.findGroup(r.name);
+        if(vals.isNull() || !r.step) {
+            yError() << "Governor bias" << r.name << "unknown or zero step";
+            return false;
+        }
+        r.nominal = r.value = vals.get(3).asInt();
+        rules.push_back(r);
+    }
+
+    if(simulate) {
+        sensor.configure(params.check("sim_rate", Value(2e6)).asDouble(),
+                         params.check("sim_variation", Value(0.5)).asDouble(),
+                         params.check("sim_period", Value(20.0)).asDouble(),
+                         params.check("sim_gain", Value(0.85)).asDouble());
+        yInfo() << "Rate governor is simulating the sensor, biases will not be"
+                   " programmed";
+    }
+
+    if(!delay_port.open(module_name + "/governor/delay:i"))
+        return false;
+
+    yInfo() << "Rate governor: target" << target_rate << "ev/s, max delay"
+            << max_delay << "s," << rules.size() << "biases";
+    return true;
+}
+
+void rateGovernor::log(const std::string &message)
+{
+    yInfo() << "[GOVERNOR]" << message;
+    if(logfile.empty()) return;
+    std::ofstream writer(logfile.c_str(), std::ios_base::app);
+    if(writer.is_open())
+        writer << "GOVERNOR " << (long)Time::now() << " " << message
+               << std::endl;
+}
+
+bool rateGovernor::move(rule &r, int value)
+{
+    std::ostringstream oss;
+    oss << (int)(rate / 1000.0) << " kV/s, " << delay << " s delay: "
+        << r.name << " " << r.value << " -> " << value;
+    log(oss.str());
+
+    r.value = value;
+    change_time = Time::now();
+    changes++;
+    if(simulate) return true;
+
+    bool ok = true;
+    if(bias_mutex) bias_mutex->lock();
+    for(size_t i = 0; i < cameras.size(); i++) {
+        ok = cameras[i]->setBias(r.name, value) && ok;
+        ok = cameras[i]->configureBiases() && ok;
+    }
+    if(bias_mutex) bias_mutex->unlock();
+    if(!ok)
+        yError() << "[GOVERNOR] Could not program" << r.name;
+    return ok;
+}
+
+int rateGovernor::stepsFromNominal()
+{
+    int steps = 0;
+    for(size_t i = 0; i < rules.size(); i++)
+        steps += std::abs(rules[i].value - rules[i].nominal) / rules[i].step;
+    return steps;
+}
+
+void rateGovernor::update(unsigned long event_count)
+{
+    m.lock();
+
+    double now = Time::now();
+    if(simulate)
+        event_count = sensor.update(stepsFromNominal());
+    if(prev_time > 0.0 && now > prev_time)
+        rate = (event_count - prev_count) / (now - prev_time);
+    prev_count = event_count;
+    prev_time = now;
+
+    //downstream modules report their delay (s) as the first value
+    Bottle *report = delay_port.read(false);
+    if(report && report->size()) {
+        delay = report->get(0).asDouble();
+        delay_time = now;
+    } else if(now - delay_time > 5.0) {
+        delay = 0.0;
+    }
+
+    if(!enabled || now - change_time < settle_time) {
+        m.unlock();
+        return;
+    }
+
+    bool over = rate > target_rate || (max_delay > 0 && delay > max_delay);
+    bool under = rate < relax_fraction * target_rate &&
+            (max_delay <= 0 || delay < relax_fraction * max_delay);
+
+    if(over) {
+        //tighten the first bias that is not at its limit
+        for(size_t i = 0; i < rules.size(); i++) {
+            rule &r = rules[i];
+            if(r.value == r.limit) continue;
+            int value = r.limit > r.value ? std::min(r.value + r.step, r.limit)
+                                          : std::max(r.value - r.step, r.limit);
+            move(r, value);
+            break;
+        }
+    } else if(under) {
+        //relax the last bias that is not at nominal
+        for(int i = rules.size() - 1; i >= 0; i--) {
+            rule &r = rules[i];
+            if(r.value == r.nominal) continue;
+            int value = r.nominal > r.value
+                    ? std::min(r.value + r.step, r.nominal)
+                    : std::max(r.value - r.step, r.nominal);
+            move(r, value);
+            break;
+        }
+    }
+
+    m.unlock();
+}
+
+void rateGovernor::enable(bool enabled)
+{
+    m.lock();
+    this->enabled = enabled;
+    log(enabled ? "enabled" : "disabled");
+    m.unlock();
+}
+
+bool rateGovernor::setTarget(double target_rate)
+{
+    if(target_rate <= 0) return false;
+    m.lock();
+    this->target_rate = target_rate;
+    std::ostringstream oss;
+    oss << "target rate " << target_rate << " ev/s";
+    log(oss.str());
+    m.unlock();
+    return true;
+}
+
+void rateGovernor::reset()
+{
+    m.lock();
+    for(size_t i = 0; i < rules.size(); i++)
+        if(rules[i].value != rules[i].nominal)
+            move(rules[i], rules[i].nominal);
+    m.unlock();
+}
+
+Bottle rateGovernor::state()
+{
+    m.lock();
+    Bottle b;
+    Bottle &e = b.addList();
+    e.addString("enabled"); e.addInt(enabled);
+    Bottle &s = b.addList();
+    s.addString("simulated"); s.addInt(simulate);
+    Bottle &r = b.addList();
+    r.addString("rate"); r.addDouble(rate);
+    Bottle &t = b.addList();
+    t.addString("target_rate"); t.addDouble(target_rate);
+    Bottle &d = b.addList();
+    d.addString("delay"); d.addDouble(delay);
+    Bottle &md = b.addList();
+    md.addString("max_delay"); md.addDouble(max_delay);
+    Bottle &c = b.addList();
+    c.addString("changes"); c.addInt(changes);
+    for(size_t i = 0; i < rules.size(); i++) {
+        Bottle &v = b.addList();
+        v.addString(rules[i].name);
+        v.addInt(rules[i].value);
+        v.addInt(rules[i].nominal);
+        v.addInt(rules[i].limit);
+    }
+    m.unlock();
+    return b;
+}
+
+void rateGovernor::close()
+{
+    delay_port.close();
+}
@@ -54,6 +54,7 @@ bool zynqGrabberModule::configure(yarp::os::ResourceFinder &rf) {
 
     std::string moduleName = rf.check("name", yarp::os::Value("/zynqGrabber")).asString();
     setName(moduleName.c_str());
+    governed = false;
     bool verbose = rf.check("verbose") && rf.check("verbose", yarp::os::Value(true)).asBool();
     bool biaswrite = rf.check("biaswrite") && rf.check("biaswrite", yarp::os::Value(true)).asBool();
     bool iBias = rf.check("iBias") && rf.check("iBias", yarp::os::Value(true)).asBool();
@@ -196,9 +197,14 @@ bool zynqGrabberModule::configure(yarp::os::ResourceFinder &rf) {
         bool write_flag = rf.check("hpu_write") &&
                 rf.check("hpu_write", yarp::os::Value(true)).asBool();
         int packet_size = 8 * rf.check("packet_size", yarp::os::Value("5120")).asInt();
+        int buffer_count = rf.check("hpu_buffers", yarp::os::Value(1)).asInt();
+        double packet_latency = rf.check("packet_latency", yarp::os::Value(0.0)).asDouble();
+        bool shared_output = rf.check("shared_output") &&
+                rf.check("shared_output", yarp::os::Value(true)).asBool();
 
         if(read_flag)
-            if(!hpu.openReadPort(moduleName, packet_size))
+            if(!hpu.openReadPort(moduleName, packet_size, buffer_count,
+                                 packet_latency, shared_output))
                 return false;
 
         if(write_flag)
@@ -209,6 +215,21 @@ bool zynqGrabberModule::configure(yarp::os::ResourceFinder &rf) {
         hpu.start();
     }
 
+    //the governor tunes the biases of the cameras that were configured
+    governed = rf.check("rate_governor") &&
+            rf.check("rate_governor", yarp::os::Value(true)).asBool();
+    if(governed) {
+        std::vector<vVisionCtrl *> cameras;
+        if(rf.check("visCtrlLeft")) cameras.push_back(&vsctrlMngLeft);
+        if(rf.check("visCtrlRight")) cameras.push_back(&vsctrlMngRight);
+        yarp::os::Bottle &params = rf.findGroup("RATE_GOVERNOR");
+        yarp::os::Bottle &biases = rf.findGroup(rf.check("visCtrlLeft") ||
+                !rf.check("visCtrlRight") ? "ATIS_BIAS_LEFT" : "ATIS_BIAS_RIGHT");
+        if(!governor.configure(params, biases, cameras, &bias_mutex,
+                               moduleName, logfile))
+            return false;
+    }
+
     if (!handlerPort.open(moduleName)) {
         std::cout << "Unable to open RPC port @ /" << moduleName << std::endl;
         return false;
@@ -233,6 +254,8 @@ bool zynqGrabberModule::interruptModule() {
 
 bool zynqGrabberModule::close() {
 
+    if(governed)
+        governor.close();
 
     return true;
 }
@@ -240,6 +263,9 @@ bool zynqGrabberModule::close() {
 /* Called periodically every getPeriod() seconds */
 bool zynqGrabberModule::updateModule() {
 
+    if(governed)
+        governor.update(hpu.getEventCount());
+
     return !isStopping();
 }
 
@@ -259,7 +285,8 @@ bool zynqGrabberModule::respond(const yarp::os::Bottle& command,
             "help \n" +
             "quit \n" +
             "set thr <n> ... set the threshold \n" +
-            "(where <n> is an integer number) \n";
+            "(where <n> is an integer number) \n" +
+            "gov [on|off|reset|target <ev/s>] ... rate governor state \n";
 
     reply.clear();
 
@@ -272,6 +299,10 @@ bool zynqGrabberModule::respond(const yarp::os::Bottle& command,
         reply.addString("ok");
     }
 
+    //the governor commands take the lock themselves when they program a bias
+    bool programs = command.get(0).asVocab() != COMMAND_VOCAB_GOV;
+    if(programs) bias_mutex.lock();
+
     switch (command.get(0).asVocab()) {
     case COMMAND_VOCAB_HELP:
         rec = true;
@@ -479,6 +510,31 @@ bool zynqGrabberModule::respond(const yarp::os::Bottle& command,
 //    }
 //        break;
 
+    case COMMAND_VOCAB_GOV:
+        rec = true;
+    {
+        std::string action = command.get(1).asString();
+        if(!governed) {
+            reply.addString("rate governor not running");
+            ok = false;
+        } else if(action == "on" || action == "off") {
+            governor.enable(action == "on");
+            ok = true;
+        } else if(action == "target") {
+            ok = governor.setTarget(command.get(2).asDouble());
+        } else if(action == "reset") {
+            governor.reset();
+            ok = true;
+        } else if(action == "") {
+            reply.append(governor.state());
+            ok = true;
+        } else {
+            std::cout << "unrecognised governor command" << std::endl;
+            ok = false;
+        }
+    }
+        break;
+
     case COMMAND_VOCAB_SETSKIN:
         rec = true;
     {
@@ -493,6 +549,8 @@ bool zynqGrabberModule::respond(const yarp::os::Bottle& command,
         break;
 
 }
+    if(programs) bias_mutex.unlock();
+
     if (!rec)
         ok = RFModule::respond(command,reply);
 
@@ -33,6 +33,8 @@ private:
     yarp::os::Semaphore mutex;
     ev::vQueue vLeftQueue;
     ev::vQueue vRightQueue;
+    yarp::os::Stamp envelope;
+    bool enveloped{ false };
     bool isReading{ false };
 
 public:
@@ -45,6 +47,7 @@ public:
     void clearQueues();
     void onRead(ev::vBottle &bot);
     ev::vQueue getEventsFromChannel(int channel);
+    yarp::os::Stamp takeEnvelope();
 };
 
 class ImagePort : public yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelBgr> > {
@@ -71,6 +74,7 @@ public:
     void close() { vPort.close();}
     void interrupt() {vPort.interrupt(); }
     ev::vQueue getEventsFromChannel(int channel){return vPort.getEventsFromChannel(channel);}
+    yarp::os::Stamp takeEnvelope() {return vPort.takeEnvelope();}
     void run(){}
     void clearQueues() {vPort.clearQueues();}
     void startReading() {vPort.startReading();}
@@ -123,6 +127,17 @@ private :
     int rightXOffset;
     int rightYOffset;
 
+    //per-pixel look-up tables of the homography (including canvas offsets)
+    cv::Mat leftMap;
+    cv::Mat rightMap;
+
+    //the images with the remapped events are only a preview
+    bool preview;
+    double previewPeriod;
+    double previewTime;
+    ev::vQueue leftPreviewQueue;
+    ev::vQueue rightPreviewQueue;
+
 
 public :
 
@@ -143,8 +158,13 @@ public :
     bool readConfigFile( const yarp::os::ResourceFinder &rf, std::string groupName
                          , yarp::sig::Matrix &homography ) const;
 
-    void transform( yarp::sig::ImageOf<yarp::sig::PixelBgr> &img, const ev::vQueue &vQueue
-                    , const yarp::sig::Matrix &homography, int xOffset, int yOffset ) ;
+    void computeRemap( const yarp::sig::Matrix &homography, int xOffset, int yOffset, cv::Mat &map ) const;
+
+    void remap( const ev::vQueue &vQueue, const cv::Mat &map, ev::vQueue &outQueue ) const;
+
+    void drawPreview( yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelBgr> > &port
+                      , ImageCollector &imageCollector, const ev::vQueue &vQueue
+                      , int canvasWidth, int canvasHeight, int xOffset, int yOffset );
 
     void getCanvasSize( const yarp::sig::Matrix &homography, int &canvasWidth, int &canvasHeight, int &xOffset
                             , int &yOffset ) const;
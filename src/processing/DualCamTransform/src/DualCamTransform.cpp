@@ -101,45 +101,52 @@ bool DualCamTransformModule::updateModule() {
             getCanvasSize( leftH, leftCanvasWidth, leftCanvasHeight, leftXOffset, leftYOffset );
             getCanvasSize( rightH, rightCanvasWidth, rightCanvasHeight, rightXOffset, rightYOffset );
         }
+        computeRemap( leftH, leftXOffset, leftYOffset, leftMap );
+        computeRemap( rightH, rightXOffset, rightYOffset, rightMap );
     }
 
+    //Remap the events of both channels into a new bottle
+    yarp::os::Stamp envelope = eventCollector.takeEnvelope();
+    ev::vQueue vLeftQueue = eventCollector.getEventsFromChannel(0);
+    ev::vQueue vRightQueue = eventCollector.getEventsFromChannel(1);
+    if (vLeftQueue.empty() && vRightQueue.empty()) {
+        yarp::os::Time::delay(0.001);
+    } else {
+        ev::vQueue outQueue;
+        remap( vLeftQueue, leftMap, outQueue );
+        std::size_t nLeft = outQueue.size();
+        remap( vRightQueue, rightMap, outQueue );
+
+        if (!outQueue.empty()) {
+            ev::vBottle &outBottle = vPortOut.prepare();
+            outBottle.clear();
+            for ( auto &v : outQueue )
+                outBottle.addEvent( v );
+            vPortOut.setEnvelope( envelope );
+            vPortOut.write();
+        }
 
-
-    //If image is ready transform and draw events on it
-    if (leftImageCollector.isImageReady()){
-        yarp::sig::ImageOf<yarp::sig::PixelBgr> &leftCanvas = leftImagePortOut.prepare();
-        yarp::sig::ImageOf<yarp::sig::PixelBgr > leftImg = leftImageCollector.getImage();
-
-      leftCanvas.resize(std::max(leftCanvasWidth, (int)(leftXOffset + leftImg.width())),
-                          std::max(leftCanvasHeight, (int)(leftYOffset + leftImg.height())));
-
-        leftCanvas.zero();
-        for ( int x = 0; x < (int)leftImg.width(); ++x ) {
-            for ( int y = 0; y < (int)leftImg.height(); ++y ) {
-                leftCanvas(x + leftXOffset, y + leftYOffset) = leftImg(x,y);
-            }
+        if (preview) {
+            leftPreviewQueue.insert( leftPreviewQueue.end(), outQueue.begin(), outQueue.begin() + nLeft );
+            rightPreviewQueue.insert( rightPreviewQueue.end(), outQueue.begin() + nLeft, outQueue.end() );
         }
-        ev::vQueue vLeftQueue = eventCollector.getEventsFromChannel(0);
-        transform( leftCanvas, vLeftQueue, leftH, leftXOffset, leftYOffset );
-        leftImagePortOut.write();
     }
 
-    if (rightImageCollector.isImageReady()){
-        yarp::sig::ImageOf<yarp::sig::PixelBgr> &rightCanvas = rightImagePortOut.prepare();
-        yarp::sig::ImageOf<yarp::sig::PixelBgr > rightImg = rightImageCollector.getImage();
-
-      rightCanvas.resize(std::max(rightCanvasWidth, (int)(rightXOffset + rightImg.width())),
-                          std::max(rightCanvasHeight,(int)(rightYOffset + rightImg.height())));
-
-        rightCanvas.zero();
-        for ( int x = 0; x < (int)rightImg.width(); ++x ) {
-            for ( int y = 0; y < (int)rightImg.height(); ++y ) {
-                rightCanvas(x + rightXOffset, y + rightYOffset) = rightImg(x,y);
-            }
+    //If images are ready, and it is time to, draw the remapped events on them.
+    //The events of a period are dropped whether or not they were drawn, so
+    //the queues cannot grow while no image arrives
+    if (preview && yarp::os::Time::now() - previewTime >= previewPeriod) {
+        if (leftImageCollector.isImageReady()) {
+            drawPreview( leftImagePortOut, leftImageCollector, leftPreviewQueue,
+                         leftCanvasWidth, leftCanvasHeight, leftXOffset, leftYOffset );
+        }
+        if (rightImageCollector.isImageReady()) {
+            drawPreview( rightImagePortOut, rightImageCollector, rightPreviewQueue,
+                         rightCanvasWidth, rightCanvasHeight, rightXOffset, rightYOffset );
         }
-        ev::vQueue vRightQueue = eventCollector.getEventsFromChannel(1);
-        transform( rightCanvas, vRightQueue, rightH, rightXOffset, rightYOffset );
-        rightImagePortOut.write();
+        leftPreviewQueue.clear();
+        rightPreviewQueue.clear();
+        previewTime = yarp::os::Time::now();
     }
 
     return true;
@@ -147,46 +154,71 @@ bool DualCamTransformModule::updateModule() {
 
 }
 
-void DualCamTransformModule::transform( yarp::sig::ImageOf<yarp::sig::PixelBgr> &img, const vQueue &vQueue
-                                        , const yarp::sig::Matrix &homography, int xOffset, int yOffset ) {
-    ev::vBottle &outBottle = vPortOut.prepare();
-    outBottle.clear();
+void DualCamTransformModule::computeRemap( const yarp::sig::Matrix &homography, int xOffset, int yOffset
+                                           , cv::Mat &map ) const {
+    map = cv::Mat( height, width, CV_32SC2 );
+    for ( int y = 0; y < height; ++y ) {
+        for ( int x = 0; x < width; ++x ) {
+            yarp::sig::Vector evCoord( 3 );
+
+            //Converting to homogeneous coordinates
+            evCoord[0] = x;
+            evCoord[1] = y;
+            evCoord[2] = 1;
+
+            //Applying trasformation
+            evCoord *= homography;
+
+            //Converting back from homogenous coordinates
+            map.at<cv::Vec2i>( y, x ) = cv::Vec2i( (evCoord[0] / evCoord[2]) + xOffset + 1,
+                                                   (evCoord[1] / evCoord[2]) + yOffset + 1 );
+        }
+    }
+}
+
+void DualCamTransformModule::remap( const vQueue &vQueue, const cv::Mat &map, ev::vQueue &outQueue ) const {
     for ( auto &it : vQueue ) {
 
         auto v = is_event<AE >( it );
+        if ( v->x >= width || v->y >= height )
+            continue;
 
-        double x = v->x;
-        double y = v->y;
-        yarp::sig::Vector evCoord( 3 );
+        const cv::Vec2i &mapPix = map.at<cv::Vec2i>( v->y, v->x );
 
-        //Converting to homogeneous coordinates
-        evCoord[0] = x;
-        evCoord[1] = y;
-        evCoord[2] = 1;
+        //only keep events that can be encoded
+        if ( mapPix[0] < 0 || mapPix[0] > 511 || mapPix[1] < 0 || mapPix[1] > 255 )
+            continue;
 
-        //Applying trasformation
-        evCoord *= homography;
+        auto vOut = make_event<AE>( v );
+        vOut->x = mapPix[0];
+        vOut->y = mapPix[1];
+        outQueue.push_back( vOut );
+    }
+}
 
-        //Converting back from homogenous coordinates
-        x = (evCoord[0] / evCoord[2]) + xOffset + 1;
-        y = (evCoord[1] / evCoord[2]) + yOffset + 1;
+void DualCamTransformModule::drawPreview( yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelBgr> > &port
+                                          , ImageCollector &imageCollector, const ev::vQueue &vQueue
+                                          , int canvasWidth, int canvasHeight, int xOffset, int yOffset ) {
+    yarp::sig::ImageOf<yarp::sig::PixelBgr> &canvas = port.prepare();
+    yarp::sig::ImageOf<yarp::sig::PixelBgr > img = imageCollector.getImage();
 
-        //Drawing event on img
-        bool inBound = x >= 0 && x < img.width() && y >= 0 && y < img.height();
-        if (inBound){
-            img( x, y ) = yarp::sig::PixelBgr( 255, 255, 255 );
-        }
+    canvas.resize(std::max(canvasWidth, (int)(xOffset + img.width())),
+                  std::max(canvasHeight, (int)(yOffset + img.height())));
 
-        if (y <= 255) {
-            outBottle.addEvent( v );
-            v->x = x;
-            v->y = y;
+    canvas.zero();
+    for ( int x = 0; x < (int)img.width(); ++x ) {
+        for ( int y = 0; y < (int)img.height(); ++y ) {
+            canvas(x + xOffset, y + yOffset) = img(x,y);
         }
     }
-    if (outBottle.size() > 0) {
-//        vPortOut.setEnvelope(vQueue.back()->stamp);
-        vPortOut.write();
+
+    //Drawing events on canvas
+    for ( auto &it : vQueue ) {
+        auto v = is_event<AE >( it );
+        if ( v->x < (int)canvas.width() && v->y < (int)canvas.height() )
+            canvas( v->x, v->y ) = yarp::sig::PixelBgr( 255, 255, 255 );
     }
+    port.write();
 }
 
 void DualCamTransformModule::finalizeCalibration( yarp::sig::Matrix &homography, std::string groupName) {
@@ -373,6 +405,10 @@ bool DualCamTransformModule::configure( yarp::os::ResourceFinder &rf ) {
     height = rf.check("height", yarp::os::Value(240)).asInt();
     width = rf.check("width", yarp::os::Value(304)).asInt();
 
+    preview = rf.check("preview", yarp::os::Value(true)).asBool();
+    previewPeriod = 1.0 / rf.check("previewRate", yarp::os::Value(30.0)).asDouble();
+    previewTime = 0.0;
+
     this -> confFileName = rf.getHomeContextPath().c_str();
     confFileName += "/DualCamTransform.ini";
 
@@ -495,6 +531,12 @@ void EventPort::onRead(ev::vBottle &bot) {
     }
 
     mutex.wait();
+    //keep the envelope of the oldest packet not yet taken
+    if (!enveloped) {
+        getEnvelope(envelope);
+        enveloped = true;
+    }
+
     //append new events to queue
 
     for ( auto &it : newQueue ) {
@@ -522,10 +564,19 @@ ev::vQueue EventPort::getEventsFromChannel( int channel ) {
     return outQueue;
 }
 
+yarp::os::Stamp EventPort::takeEnvelope() {
+    mutex.wait();
+    yarp::os::Stamp stamp = envelope;
+    enveloped = false;
+    mutex.post();
+    return stamp;
+}
+
 void EventPort::clearQueues() {
     mutex.wait();
     vLeftQueue.clear();
     vRightQueue.clear();
+    enveloped = false;
     mutex.post();
 }
 
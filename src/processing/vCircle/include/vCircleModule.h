@@ -42,6 +42,8 @@ private:
     yarp::os::BufferedPort<yarp::os::Bottle> scopeOut;
     yarp::os::BufferedPort<yarp::sig::ImageOf <yarp::sig::PixelBgr> > houghOut;
     yarp::os::BufferedPort<yarp::os::Bottle> dumpOut;
+    //the latest circle of each camera, for control loops
+    ev::vTargetWriter targetOut;
 
     ev::vtsHelper unwrap;
     double pTS;
@@ -163,6 +163,7 @@ bool vCircleReader::open(const std::string &name, bool strictness)
     bool state4 = houghOut.open(houghPortName);
 
     if(!dumpOut.open("/" + name + "/dump:o")) return false;
+    if(!targetOut.open("/" + name + "/target:o")) return false;
 
     return state1 && state2 && state3 && state4;
 }
@@ -177,6 +178,7 @@ void vCircleReader::close()
     scopeOut.close();
     houghOut.close();
     dumpOut.close();
+    targetOut.close();
     yarp::os::BufferedPort<ev::vBottle>::close();
 
 }
@@ -189,6 +191,7 @@ void vCircleReader::interrupt()
     scopeOut.interrupt();
     houghOut.interrupt();
     dumpOut.interrupt();
+    targetOut.interrupt();
     yarp::os::BufferedPort<ev::vBottle>::interrupt();
 
 
@@ -321,6 +324,12 @@ void vCircleReader::onRead(ev::vBottle &inBot)
     if(strictness) outPort.writeStrict();
     else outPort.write();
 
+    targetOut.publish(0, 0, bestxL, bestyL, bestrL,
+                      bestScoreL > inlierThreshold, q.back()->stamp);
+    targetOut.publish(0, 1, bestxR, bestyR, bestrR,
+                      bestScoreR > inlierThreshold, q.back()->stamp);
+    targetOut.flush(&st);
+
     // ///////////////////
     // scope and debug images
     // ///////////////////
@@ -193,6 +193,7 @@ void vCircleThread::performHough()
 
 void vCircleThread::run()
 {
+    ev::vMetrics::get().registerThread("vCircle/observer");
 
     while(!isStopping()) {
 
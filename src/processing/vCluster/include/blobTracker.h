@@ -42,6 +42,8 @@ protected:
     bool fixed_shape_;
     double activity_;
     unsigned long int ts_last_update_;
+    //the time activity_ was last decayed to
+    unsigned long int ts_decay_;
 
 public:
 
@@ -59,7 +61,10 @@ public:
     //update with new event
     bool addActivity(int x, int y, unsigned long int ts,
                      double Tact, double Tevent);
-    bool decayActivity(int dt, double tau, double Tinact, double Tfree);
+    void decayTo(unsigned long int ts, double tau);
+    bool decayActivity(unsigned long int ts, double tau, double Tinact,
+                       double Tfree);
+    unsigned long int nextTransition(double tau, double Tinact, double Tfree);
     void clusterSpiked();
 
     //updating and getting state
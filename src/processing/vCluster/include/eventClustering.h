@@ -36,6 +36,7 @@ class EventBottleManager : public yarp::os::BufferedPort<ev::vBottle>
     private:
 
         yarp::os::BufferedPort<ev::vBottle>     outPort;            //output port for the eventBottle with the new events computed by the module
+        ev::vTargetWriter                       targetPort;         //the latest state of each cluster for control loops
 
         //create trackers, left and right
         TrackerPool tracker_pool_left;
@@ -32,8 +32,25 @@ protected:
     //we will store trackers in a vector
     std::vector<BlobTracker> trackers_;
 
+    //trackers that are not free, hashed by the cell of their centre. Cells
+    //are maxDist wide so only the 3x3 cells around an event are searched
+    static const int grid_bits = 6;
+    int cell_size_;
+    std::vector< std::vector<int> > grid_;
+    std::vector<int> cells_;
+
+    //free trackers
+    std::vector<int> free_;
+
+    //the next state transition of each tracker that is not free, on a
+    //timing wheel of wheel_slots ticks
+    static const int wheel_slots = 256;
+    std::vector< std::vector<int> > wheel_;
+    std::vector<int> due_;
+    unsigned long int tick_, now_tick_;
+    bool started_;
+
     int nb_ev_regulate_, count_;
-    unsigned long int  ts_last_reg_;
     double decay_tau;
     double Tact, Tinact, Tfree, Tevent;
     double max_dist;
@@ -43,6 +60,12 @@ protected:
     double clusterLimit;
 
     int getNewTracker();
+    int cellOf(int x, int y);
+    void place(int i);
+    void remove(int i);
+    void schedule(int i);
+    void advance(unsigned long int ts, int stamp,
+                 std::vector<ev::event<ev::GaussianAE> > &clEvts);
     ev::event<ev::GaussianAE> makeEvent(int i, int ts);
     ev::vtsHelper unwrap;
 
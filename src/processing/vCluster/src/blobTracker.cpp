@@ -45,6 +45,7 @@ BlobTracker::BlobTracker()
     vx_ = 0;
     vy_ = 0;
     ts_last_update_ = 0;
+    ts_decay_ = 0;
 
 }
 
@@ -127,10 +128,19 @@ bool BlobTracker::addActivity(int x, int y, unsigned long int ts,
     return false;
 }
 
-bool BlobTracker::decayActivity(int dt, double tau, double Tinact, double Tfree)
+void BlobTracker::decayTo(unsigned long int ts, double tau)
+{
+    //the decay is exponential, so it can be applied in one step
+    if(ts > ts_decay_)
+        activity_ *= exp(-(double)(ts - ts_decay_) / tau);
+    ts_decay_ = ts;
+}
+
+bool BlobTracker::decayActivity(unsigned long int ts, double tau,
+                                double Tinact, double Tfree)
 {
     State prev_state = state_;
-    activity_ *= exp(-dt/tau);
+    decayTo(ts, tau);
 
     if(activity_ < Tfree){
         state_ = Free;
@@ -142,6 +152,16 @@ bool BlobTracker::decayActivity(int dt, double tau, double Tinact, double Tfree)
     return prev_state != state_;
 }
 
+unsigned long int BlobTracker::nextTransition(double tau, double Tinact,
+                                              double Tfree)
+{
+    //the time the activity decays below the threshold of the current state
+    double threshold = is_active() ? Tinact : Tfree;
+    if(activity_ <= threshold)
+        return ts_decay_;
+    return ts_decay_ + (unsigned long int)(tau * log(activity_ / threshold)) + 1;
+}
+
 void BlobTracker::clusterSpiked()
 {
     vLastX = cen_x_;
@@ -163,18 +163,22 @@ bool EventBottleManager::open(std::string moduleName)
     std::string outPortName = "/" + moduleName + "/vBottle:o";
     bool success2 = outPort.open(outPortName);
 
-    if(!success1 || !success2) {
+    bool success3 = targetPort.open("/" + moduleName + "/target:o");
+
+    if(!success1 || !success2 || !success3) {
         yarp::os::BufferedPort< ev::vBottle >::close();
         outPort.close();
+        targetPort.close();
     }
 
-    return success1 && success2;
+    return success1 && success2 && success3;
 }
 
 /******************************************************************************/
 void EventBottleManager::close()
 {
     outPort.close();
+    targetPort.close();
     BufferedPort<ev::vBottle >::close();
 }
 
@@ -182,6 +186,7 @@ void EventBottleManager::close()
 void EventBottleManager::interrupt()
 {
     outPort.interrupt();
+    targetPort.interrupt();
     BufferedPort< ev::vBottle >::interrupt();
 }
 
@@ -229,6 +234,9 @@ void EventBottleManager::onRead(ev::vBottle &bot)
             for(ceit = clEvts.begin(); ceit != clEvts.end(); ceit++) {
                 (*ceit)->setChannel(0);
                 evtCluster.addEvent(*ceit);
+                targetPort.publish((*ceit)->ID, 0, (*ceit)->x, (*ceit)->y,
+                                   (*ceit)->sigx, (*ceit)->polarity,
+                                   (*ceit)->stamp);
             }
 
         }
@@ -251,6 +259,9 @@ void EventBottleManager::onRead(ev::vBottle &bot)
             for(ceit = clEvts.begin(); ceit != clEvts.end(); ceit++) {
                 (*ceit)->setChannel(1);
                 evtCluster.addEvent(*ceit);
+                targetPort.publish((*ceit)->ID, 1, (*ceit)->x, (*ceit)->y,
+                                   (*ceit)->sigx, (*ceit)->polarity,
+                                   (*ceit)->stamp);
 
             }
 
@@ -259,6 +270,7 @@ void EventBottleManager::onRead(ev::vBottle &bot)
 
 
     outPort.write();
+    targetPort.flush();
 }
 
 //empty line to make gcc happy
@@ -18,6 +18,8 @@
  */
 
 #include "trackerPool.h"
+#include <algorithm>
+#include <cmath>
 
 TrackerPool::TrackerPool()
 {
@@ -29,10 +31,16 @@ TrackerPool::TrackerPool()
     alpha_shape = 0.01;
 
     decay_tau = 10000;
-    ts_last_reg_ = -1;
     nb_ev_regulate_ = 50;
     count_ = 0;
 
+    grid_.resize(1 << (2 * grid_bits));
+    cell_size_ = 10;
+    wheel_.resize(wheel_slots);
+    tick_ = decay_tau / 16;
+    now_tick_ = 0;
+    started_ = false;
+
     Tact = 50;
     Tinact = 20;
     Tfree = 10;
@@ -63,11 +71,14 @@ void TrackerPool::setDecayParams(double decay_tau, double Tact, double Tinact,
     this->Tfree = Tfree;
     this->Tevent = Tevent;
     this->nb_ev_regulate_ = rate;
+    //a tick of the timing wheel is a fraction of the decay
+    tick_ = std::max(decay_tau / 16, 1.0);
 }
 
 void TrackerPool::setComparisonParams(double max_dist)
 {
     this->max_dist = max_dist;
+    cell_size_ = std::max((int)std::ceil(max_dist), 1);
 }
 
 void TrackerPool::setClusterLimit(int limit)
@@ -86,17 +97,28 @@ int TrackerPool::update(ev::event<ev::AE> v,
     double max_p = 0;
     int trackId = -1;
 
-    //the first event sets the beginning of the regulation cycle
-    if(ts_last_reg_ < 0) ts_last_reg_ = ev_t;
-
-    // We look for the tracker with the biggest p
-    for(unsigned int ii=0; ii<trackers_.size(); ii++){
-        // only among the Active and Inactive clusters
-        if(trackers_[ii].is_on() && trackers_[ii].dist2event(ev_x, ev_y) < max_dist){
-            double p = trackers_[ii].compute_p(ev_x, ev_y);
-            if(p>max_p || trackId ==-1){
-                max_p = p;
-                trackId = ii;
+    //the first event sets the beginning of the timing wheel
+    if(!started_) {
+        now_tick_ = ev_t / tick_;
+        started_ = true;
+    }
+
+    // We look for the tracker with the biggest p among the Active and
+    // Inactive clusters in the cells around the event
+    int cx = ev_x / cell_size_, cy = ev_y / cell_size_;
+    int mask = (1 << grid_bits) - 1;
+    for(int dy = -1; dy <= 1; dy++) {
+        for(int dx = -1; dx <= 1; dx++) {
+            const std::vector<int> &cell =
+                    grid_[(((cy + dy) & mask) << grid_bits) | ((cx + dx) & mask)];
+            for(size_t c = 0; c < cell.size(); c++) {
+                int ii = cell[c];
+                if(trackers_[ii].dist2event(ev_x, ev_y) >= max_dist) continue;
+                double p = trackers_[ii].compute_p(ev_x, ev_y);
+                if(p>max_p || trackId ==-1){
+                    max_p = p;
+                    trackId = ii;
+                }
             }
         }
     }
@@ -111,46 +133,111 @@ int TrackerPool::update(ev::event<ev::AE> v,
             trackers_[trackId].initialisePosition(ev_x, ev_y);
             trackers_[trackId].clusterSpiked();
             trackers_[trackId].isNoLongerFree();
+            trackers_[trackId].decayTo(ev_t, decay_tau);
+            place(trackId);
+            schedule(trackId);
         }
     }
 
     // Otherwise, we update the one with the highest probability
     else{
+        trackers_[trackId].decayTo(ev_t, decay_tau);
         bool spiked = trackers_[trackId].addActivity(ev_x, ev_y, ev_t, Tact,
                                                      Tevent);
         if(spiked) {
             clEvts.push_back(makeEvent(trackId, v->stamp));
         }
+        place(trackId);
     }
 
     //regulate the pool only each nb_ev_regulate_ events
     if(++count_ < nb_ev_regulate_) return trackId;
-
-    //do the regulation
-    int dt = ev_t - ts_last_reg_;
-    ts_last_reg_ = ev_t;
     count_ = 0;
+    advance(ev_t, v->stamp, clEvts);
+
+    return trackId;
+}
 
-    for(unsigned int i = 0; i < trackers_.size(); i++){
-        // We update the activity of each Active tracker
-        if(!(trackers_[i].is_on())) continue;
-        bool spiked = trackers_[i].decayActivity(dt, decay_tau,
-                                                 Tinact, Tfree);
-        if(spiked) clEvts.push_back(makeEvent(i, v->stamp));
+void TrackerPool::advance(unsigned long int ts, int stamp,
+                          std::vector<ev::event<ev::GaussianAE> > &clEvts)
+{
+    unsigned long int target = ts / tick_;
+    if(target <= now_tick_) return;
+
+    //after a long gap every slot is due, so each is visited once
+    unsigned long int from = now_tick_;
+    unsigned long int n = std::min(target - from, (unsigned long int)wheel_slots);
+    now_tick_ = target;
+
+    for(unsigned long int k = 1; k <= n; k++) {
+        due_.clear();
+        due_.swap(wheel_[(from + k) % wheel_slots]);
+        for(size_t d = 0; d < due_.size(); d++) {
+            int i = due_[d];
+            //decay the tracker to now. It is rescheduled if events have
+            //kept it above its threshold.
+            if(trackers_[i].decayActivity(ts, decay_tau, Tinact, Tfree))
+                clEvts.push_back(makeEvent(i, stamp));
+            if(trackers_[i].isFree()) {
+                remove(i);
+                free_.push_back(i);
+            } else {
+                schedule(i);
+            }
+        }
     }
+}
 
-    return trackId;
+void TrackerPool::schedule(int i)
+{
+    unsigned long int tick = trackers_[i].nextTransition(decay_tau, Tinact,
+                                                         Tfree) / tick_ + 1;
+    if(tick <= now_tick_)
+        tick = now_tick_ + 1;
+    //transitions beyond the wheel are rescheduled when their slot comes round
+    if(tick - now_tick_ >= (unsigned long int)wheel_slots)
+        tick = now_tick_ + wheel_slots - 1;
+    wheel_[tick % wheel_slots].push_back(i);
+}
+
+int TrackerPool::cellOf(int x, int y)
+{
+    int mask = (1 << grid_bits) - 1;
+    return (((y / cell_size_) & mask) << grid_bits) | ((x / cell_size_) & mask);
+}
+
+void TrackerPool::place(int i)
+{
+    int c = cellOf(trackers_[i].get_x(), trackers_[i].get_y());
+    if(cells_[i] == c) return;
+    remove(i);
+    grid_[c].push_back(i);
+    cells_[i] = c;
+}
+
+void TrackerPool::remove(int i)
+{
+    if(cells_[i] < 0) return;
+    std::vector<int> &cell = grid_[cells_[i]];
+    for(size_t c = 0; c < cell.size(); c++) {
+        if(cell[c] == i) {
+            cell[c] = cell.back();
+            cell.pop_back();
+            break;
+        }
+    }
+    cells_[i] = -1;
 }
 
 int TrackerPool::getNewTracker()
 {
     //check to see if there is a free tracker already created
-    for(unsigned int i = 0; i < trackers_.size(); i++) {
-        if(trackers_[i].isFree()) {
-            trackers_[i].initialiseShape(sig_x2_, sig_y2_, sig_xy_, alpha_pos,
-                                        alpha_shape, fixed_shape_);
-            return i;
-        }
+    if(free_.size()) {
+        int i = free_.back();
+        free_.pop_back();
+        trackers_[i].initialiseShape(sig_x2_, sig_y2_, sig_xy_, alpha_pos,
+                                     alpha_shape, fixed_shape_);
+        return i;
     }
 
     //else no free trackers
@@ -161,6 +248,7 @@ int TrackerPool::getNewTracker()
         newtracker.initialiseShape(sig_x2_, sig_y2_, sig_xy_,
                                    alpha_pos, alpha_shape, fixed_shape_);
         trackers_.push_back(newtracker);
+        cells_.push_back(-1);
 
         return trackers_.size()  - 1;
     }
@@ -46,8 +46,8 @@ private:
     yarp::os::BufferedPort<yarp::os::Bottle> debugPort;
 
     //data structures
-    ev::temporalSurface *surfaceleft;
-    ev::temporalSurface *surfaceright;
+    ev::vSurface2 *surfaceleft;
+    ev::vSurface2 *surfaceright;
 
     //parameters
     int height;
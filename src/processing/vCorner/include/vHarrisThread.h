@@ -46,7 +46,7 @@ private:
     filters convolution;
     ev::collectorPort *outthread;
     yarp::os::Stamp *ystamp_p;
-    ev::temporalSurface *cSurf_p;
+    ev::vSurface2 *cSurf_p;
 
     yarp::os::Semaphore *semaphore;
 
@@ -63,7 +63,7 @@ public:
 
     vComputeHarrisThread(int sobelsize, int windowRad, double sigma, double thresh, unsigned int qlen, ev::collectorPort *outthread,
                     yarp::os::Mutex *mutex_writer, yarp::os::Mutex *mutex_reader, int *readcount);
-    void assignTask(ev::event<ev::AddressEvent> ae, ev::temporalSurface *cSurf, yarp::os::Stamp *ystamp);
+    void assignTask(ev::event<ev::AddressEvent> ae, ev::vSurface2 *cSurf, yarp::os::Stamp *ystamp);
     void suspend();
     void wakeup();
     bool available();
@@ -82,8 +82,8 @@ private:
     ev::queueAllocator inputPort;
 
     //data structures
-    ev::temporalSurface *surfaceleft;
-    ev::temporalSurface *surfaceright;
+    ev::vSurface2 *surfaceleft;
+    ev::vSurface2 *surfaceright;
 
     //port for debugging
     yarp::os::BufferedPort<yarp::os::Bottle> debugPort;
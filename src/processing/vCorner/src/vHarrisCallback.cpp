@@ -51,8 +51,8 @@ vHarrisCallback::vHarrisCallback(int height, int width, double temporalsize, int
 
     //create surface representations
     std::cout << "Creating surfaces..." << std::endl;
-    surfaceleft = new temporalSurface(width, height, this->temporalsize);
-    surfaceright = new temporalSurface(width, height, this->temporalsize);
+    surfaceleft = createSurface("temporal", width, height, this->temporalsize);
+    surfaceright = createSurface("temporal", width, height, this->temporalsize);
 
     this->tout = 0;
 
@@ -115,7 +115,7 @@ void vHarrisCallback::onRead(ev::vBottle &bot)
     for(ev::vQueue::iterator qi = q.begin(); qi != q.end(); qi++)
     {
         auto ae = is_event<AE>(*qi);
-        ev::temporalSurface *cSurf;
+        ev::vSurface2 *cSurf;
         if(ae->getChannel() == 0)
             cSurf = surfaceleft;
         else
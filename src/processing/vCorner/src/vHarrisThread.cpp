@@ -43,8 +43,8 @@ vHarrisThread::vHarrisThread(unsigned int height, unsigned int width, std::strin
     std::cout << "and a " << 2*windowRad + 1 << "x" << 2*windowRad + 1 << " spatial window" << std::endl;
 
     //data structure
-    surfaceleft  = new temporalSurface(width, height, this->temporalsize);
-    surfaceright = new temporalSurface(width, height, this->temporalsize);
+    surfaceleft  = createSurface("temporal", width, height, this->temporalsize);
+    surfaceright = createSurface("temporal", width, height, this->temporalsize);
 
     //mutex to protect the writing
     mutex_writer = new yarp::os::Mutex();
@@ -108,6 +108,7 @@ void vHarrisThread::onStop()
 
 void vHarrisThread::run()
 {
+    ev::vMetrics::get().registerThread("vCorner");
     int maxV = 10000;
     //int minAcceptableDelay =  51200;
     while(!isStopping()) {
@@ -149,7 +150,7 @@ void vHarrisThread::run()
 
             //get current event and add it to the surface
             auto ae = ev::is_event<ev::AE>(*qi);
-            ev::temporalSurface *cSurf;
+            ev::vSurface2 *cSurf;
             if(ae->getChannel() == 0)
                 cSurf = surfaceleft;
             else
@@ -222,7 +223,7 @@ vComputeHarrisThread::vComputeHarrisThread(int sobelsize, int windowRad, double
 
 }
 
-void vComputeHarrisThread::assignTask(ev::event<AddressEvent> ae, ev::temporalSurface *cSurf, yarp::os::Stamp *ystamp)
+void vComputeHarrisThread::assignTask(ev::event<AddressEvent> ae, ev::vSurface2 *cSurf, yarp::os::Stamp *ystamp)
 {
     cSurf_p = cSurf;
     ystamp_p = ystamp;
@@ -248,6 +249,7 @@ bool vComputeHarrisThread::available()
 
 void vComputeHarrisThread::run()
 {
+    ev::vMetrics::get().registerThread("vCorner/compute");
     while(!isStopping()) {
 
         //if no task is assigned, wait
@@ -37,6 +37,7 @@ public:
     unsigned int n;
     yarp::sig::Vector roi;
     bool use_TW;
+    int channel;
 
     roiq();
     void setSize(unsigned int value);
@@ -45,6 +46,29 @@ public:
 
 };
 
+/*////////////////////////////////////////////////////////////////////////////*/
+// TARGET
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/// \brief the particle filter, ROI and state of one tracked circle
+class target
+{
+public:
+
+    int id;
+    roiq qROI;
+    vParticlefilter vpf;
+    double avgx, avgy, avgr;
+    double dx, dy, dr;
+    double stagnantstart;
+    unsigned int targetproc;
+    unsigned int added;
+
+    target(int id) : id(id), avgx(0), avgy(0), avgr(0), dx(0), dy(0), dr(0),
+        stagnantstart(0), targetproc(0), added(0) {}
+
+};
+
 /*////////////////////////////////////////////////////////////////////////////*/
 // DELAYCONTROL
 /*////////////////////////////////////////////////////////////////////////////*/
@@ -56,13 +80,13 @@ private:
     //data structures and ports
     vReadPort<vQueue> inputPort;
     vWritePort outputPort;
-    roiq qROI;
-    vParticlefilter vpf;
+    vTargetWriter targetPort;
+    std::vector<target *> targets;
+    vParticlePool pool;
     //yarp::os::BufferedPort<vBottle> outputPort;
 
     //variables
     resolution res;
-    double avgx, avgy, avgr;
     int maxRawLikelihood;
     double gain;
     double minEvents;
@@ -73,24 +97,29 @@ private:
     //diagnostics
     double filterPeriod;
     unsigned int targetproc;
-    double dx;
-    double dy;
-    double dr;
-    ev::benchmark cpuusage;
+    //process cpu time (vMetrics) at the previous getTrackingStats()
+    double prev_cpu;
+    double prev_cpu_time;
 
     yarp::os::BufferedPort< yarp::sig::ImageOf< yarp::sig::PixelBgr> > debugPort;
 
 
 public:
 
-    delayControl() {}
+    delayControl() : prev_cpu(-1), prev_cpu_time(0) {}
+    ~delayControl();
 
-    bool open(std::string name, unsigned int qlimit = 0);
+    bool open(std::string name, unsigned int qlimit = 0,
+              std::string shared_input = "");
     void initFilter(int width, int height, int nparticles,
                     int bins, bool adaptive, int nthreads,
-                    double minlikelihood, double inlierThresh, double randoms, double negativeBias);
-    void performReset();
-    void setFilterInitialState(int x, int y, int r);
+                    double minlikelihood, double inlierThresh, double randoms,
+                    double negativeBias, int ntargets = 1);
+    int numberOfTargets() { return targets.size(); }
+    void performReset(int id = -1);
+    void setFilterInitialState(int x, int y, int r, int id = 0);
+    void setRadiusRange(int rmin, int rmax, int id = 0);
+    void setTargetChannel(int channel, int id = 0);
 
     void setMinRawLikelihood(double value);
     void setMaxRawLikelihood(int value);
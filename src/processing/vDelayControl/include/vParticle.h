@@ -21,6 +21,7 @@
 
 #include <iCub/eventdriven/all.h>
 #include <yarp/sig/all.h>
+#include <atomic>
 
 using namespace ev;
 
@@ -342,14 +343,73 @@ public:
     void setInlierParameter(double value);
     void setNegativeBias(double value);
     void setAdaptive(bool value = true);
+    void setRadiusRange(int rmin, int rmax);
 
     void performObservation(const vQueue &q);
+    double observe(const vQueue &q, int pStart, int pEnd);
+    void concludeObservation(double normval);
     void extractTargetPosition(double &x, double &y, double &r);
     void extractTargetWindow(double &tw);
     void performResample();
     void performPrediction(double sigma);
 
     std::vector<vParticle> getps();
+    int size() { return nparticles; }
+
+};
+
+/*////////////////////////////////////////////////////////////////////////////*/
+//VPARTICLEPOOL
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/// \brief computes the observation of several particle filters on one set of
+/// worker threads. Each filter is split into chunks of particles that are
+/// handed out to whichever thread is free, so a filter with many events in
+/// its ROI does not hold the others back. The calling thread also works, so
+/// a pool of 1 thread has no workers.
+class vParticlePool
+{
+private:
+
+    struct job {
+        vParticlefilter *pf;
+        const vQueue *q;
+        int pStart;
+        int pEnd;
+        double normval;
+    };
+
+    class worker : public yarp::os::Thread
+    {
+    public:
+        vParticlePool *pool;
+        yarp::os::Semaphore go;
+        worker(vParticlePool *pool) : pool(pool), go(0) {}
+        void onStop() { go.post(); }
+        void run();
+    };
+
+    std::vector<worker *> workers;
+    std::vector<job> jobs;
+    std::atomic<unsigned int> next;
+    yarp::os::Semaphore finished;
+    int nthreads;
+
+    void work();
+
+public:
+
+    vParticlePool() : next(0), finished(0), nthreads(1) {}
+    ~vParticlePool() { stop(); }
+
+    bool start(int nthreads);
+    void stop();
+
+    /// \brief queue the observation of the events q by the filter pf
+    void add(vParticlefilter *pf, const vQueue *q);
+
+    /// \brief compute the queued observations and conclude each filter
+    void process();
 
 };
 
@@ -74,6 +74,8 @@ bool module::configure(yarp::os::ResourceFinder &rf)
     double nRandResample = rf.check("randoms", yarp::os::Value(0.0)).asDouble();
 
     yarp::os::Bottle * seed = rf.find("seed").asList();
+    yarp::os::Bottle * targets = rf.find("targets").asList();
+    int ntargets = targets && targets->size() ? targets->size() : 1;
 
     //observation parameters
     double minlikelihood = rf.check("obsthresh", yarp::os::Value(0.2)).asDouble();
@@ -92,16 +94,33 @@ bool module::configure(yarp::os::ResourceFinder &rf)
     //delaycontrol.setMinRawLikelihood(minlikelihood);
 
     delaycontrol.initFilter(width, height, particles, bins, adaptivesampling,
-                            nthread, minlikelihood, inlierParameter, nRandResample, negativeBias);
+                            nthread, minlikelihood, inlierParameter, nRandResample,
+                            negativeBias, ntargets);
     if(seed && seed->size() == 3) {
         yInfo() << "Setting initial seed state:" << seed->toString();
         delaycontrol.setFilterInitialState(seed->get(0).asDouble(), seed->get(1).asDouble(), seed->get(2).asDouble());
     }
+
+    //each target is (x y r [rmin rmax [channel]])
+    for(int i = 0; targets && i < (int)targets->size(); i++) {
+        yarp::os::Bottle *t = targets->get(i).asList();
+        if(!t || (t->size() != 3 && t->size() != 5 && t->size() != 6)) {
+            yError() << "targets should be a list of (x y r [rmin rmax [channel]])";
+            return false;
+        }
+        yInfo() << "Target" << i << ":" << t->toString();
+        if(t->size() >= 5)
+            delaycontrol.setRadiusRange(t->get(3).asInt(), t->get(4).asInt(), i);
+        if(t->size() == 6)
+            delaycontrol.setTargetChannel(t->get(5).asInt(), i);
+        delaycontrol.setFilterInitialState(t->get(0).asDouble(), t->get(1).asDouble(), t->get(2).asDouble(), i);
+    }
     if(!scopePort.open(getName() + "/scope:o")) {
         yError() << "Could not open scope port";
         return false;
     }
-    if(!delaycontrol.open(getName(), qlimit))
+    if(!delaycontrol.open(getName(), qlimit,
+                          rf.check("shared_input", yarp::os::Value("")).asString()))
         return false;
     return delaycontrol.start();
 
@@ -167,6 +186,7 @@ bool module::respond(const yarp::os::Bottle& command,
         reply.addString("motionVar [0 inf]");
         reply.addString("inlierParam [0 inf]");
         reply.addString("adaptive [true false]");
+        reply.addString("Reset the particles with | reset [target] |");
         break;
     }
     case CMD_SET:
@@ -225,8 +245,13 @@ bool module::respond(const yarp::os::Bottle& command,
     }
     case CMD_RESET:
     {
-        reply.addString("resetting particle positions");
-        delaycontrol.performReset();
+        if(command.size() > 1) {
+            reply.addString("resetting particle positions of a target");
+            delaycontrol.performReset(command.get(1).asInt());
+        } else {
+            reply.addString("resetting particle positions");
+            delaycontrol.performReset();
+        }
         break;
     }
     default:
@@ -17,17 +17,33 @@
  */
 
 #include "vControlLoopDelay.h"
+#include <unistd.h>
+#include <algorithm>
 
 /*////////////////////////////////////////////////////////////////////////////*/
 // DELAYCONTROL
 /*////////////////////////////////////////////////////////////////////////////*/
 
+delayControl::~delayControl()
+{
+    for(size_t i = 0; i < targets.size(); i++)
+        delete targets[i];
+}
+
 void delayControl::initFilter(int width, int height, int nparticles, int bins,
                               bool adaptive, int nthreads, double minlikelihood,
-                              double inlierThresh, double randoms, double negativeBias)
+                              double inlierThresh, double randoms,
+                              double negativeBias, int ntargets)
 {
-    vpf.initialise(width, height, nparticles, bins, adaptive, nthreads,
-                   minlikelihood, inlierThresh, randoms, negativeBias);
+    //each filter observes on a single thread, the pool shares the threads
+    //between the filters
+    for(int i = 0; i < ntargets; i++) {
+        targets.push_back(new target(i));
+        targets.back()->vpf.initialise(width, height, nparticles, bins,
+                                       adaptive, 1, minlikelihood, inlierThresh,
+                                       randoms, negativeBias);
+    }
+    pool.start(nthreads);
 
     res.height = height;
     res.width = width;
@@ -36,14 +52,28 @@ void delayControl::initFilter(int width, int height, int nparticles, int bins,
 void delayControl::setMinRawLikelihood(double value)
 {
     if(value > 0) {
-        vpf.setMinLikelihood(value);
+        for(size_t i = 0; i < targets.size(); i++)
+            targets[i]->vpf.setMinLikelihood(value);
     }
 }
 
-void delayControl::setFilterInitialState(int x, int y, int r)
+void delayControl::setFilterInitialState(int x, int y, int r, int id)
+{
+    if(id < 0 || id >= (int)targets.size()) return;
+    targets[id]->vpf.setSeed(x, y, r);
+    targets[id]->vpf.resetToSeed();
+}
+
+void delayControl::setRadiusRange(int rmin, int rmax, int id)
 {
-    vpf.setSeed(x, y, r);
-    vpf.resetToSeed();
+    if(id < 0 || id >= (int)targets.size()) return;
+    targets[id]->vpf.setRadiusRange(rmin, rmax);
+}
+
+void delayControl::setTargetChannel(int channel, int id)
+{
+    if(id < 0 || id >= (int)targets.size()) return;
+    targets[id]->qROI.channel = channel;
 }
 
 void delayControl::setMaxRawLikelihood(int value)
@@ -53,12 +83,14 @@ void delayControl::setMaxRawLikelihood(int value)
 
 void delayControl::setNegativeBias(int value)
 {
-    vpf.setNegativeBias(value);
+    for(size_t i = 0; i < targets.size(); i++)
+        targets[i]->vpf.setNegativeBias(value);
 }
 
 void delayControl::setInlierParameter(int value)
 {
-    vpf.setInlierParameter(value);
+    for(size_t i = 0; i < targets.size(); i++)
+        targets[i]->vpf.setInlierParameter(value);
 }
 
 void delayControl::setMotionVariance(double value)
@@ -73,7 +105,8 @@ void delayControl::setTrueThreshold(double value)
 
 void delayControl::setAdaptive(double value)
 {
-    vpf.setAdaptive(value);
+    for(size_t i = 0; i < targets.size(); i++)
+        targets[i]->vpf.setAdaptive(value);
 }
 
 void delayControl::setGain(double value)
@@ -91,38 +124,52 @@ void delayControl::setResetTimeout(double value)
     resetTimeout = value;
 }
 
-void delayControl::performReset()
+void delayControl::performReset(int id)
 {
-    vpf.resetToSeed();
+    for(size_t i = 0; i < targets.size(); i++)
+        if(id < 0 || id == (int)i)
+            targets[i]->vpf.resetToSeed();
 }
 
 yarp::sig::Vector delayControl::getTrackingStats()
 {
     yarp::sig::Vector stats(10);
+    target &t = *targets.front();
 
     stats[0] = 1000*inputPort.queryDelayT();
     stats[1] = 1.0/filterPeriod;
     stats[2] = targetproc;
     stats[3] = inputPort.queryRate() / 1000.0;
-    stats[4] = dx;
-    stats[5] = dy;
-    stats[6] = dr;
-    stats[7] = vpf.maxlikelihood / (double)maxRawLikelihood;
-    stats[8] = 100.0*cpuusage.getProcessorUsage();
-    stats[9] = qROI.n;
+    stats[4] = t.dx;
+    stats[5] = t.dy;
+    stats[6] = t.dr;
+    stats[7] = t.vpf.maxlikelihood / (double)maxRawLikelihood;
+    //the share of the machine used by the process since the last call
+    static const double cores = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+    double cpu = ev::vMetrics::get().cpuSeconds();
+    double now = yarp::os::Time::now();
+    stats[8] = 0;
+    if(prev_cpu >= 0 && cpu >= 0 && now > prev_cpu_time)
+        stats[8] = 100.0 * (cpu - prev_cpu) / (now - prev_cpu_time) / cores;
+    prev_cpu = cpu;
+    prev_cpu_time = now;
+    stats[9] = t.qROI.n;
 
     return stats;
 }
 
 
-bool delayControl::open(std::string name, unsigned int qlimit)
+bool delayControl::open(std::string name, unsigned int qlimit,
+                        std::string shared_input)
 {
     inputPort.setQLimit(qlimit);
-    if(!inputPort.open(name + "/vBottle:i"))
+    if(!inputPort.open(name + "/vBottle:i", shared_input))
         return false;
     outputPort.setWriteType(GaussianAE::tag);
     if(!outputPort.open(name + "/vBottle:o"))
         return false;
+    if(!targetPort.open(name + "/target:o"))
+        return false;
 //    if(!scopePort.open(name + "/scope:o"))
 //        return false;
     if(!debugPort.open(name + "/debug:o"))
@@ -135,6 +182,7 @@ void delayControl::onStop()
 {
     inputPort.close();
     outputPort.close();
+    targetPort.close();
     //scopePort.close();
     debugPort.close();
     //inputPort.releaseDataLock();
@@ -142,6 +190,7 @@ void delayControl::onStop()
 
 void delayControl::run()
 {
+    ev::vMetrics::get().registerThread("vDelayControl");
 
     double Tresample = 0;
     double Tpredict = 0;
@@ -151,14 +200,17 @@ void delayControl::run()
     targetproc = 0;
     unsigned int i = 0;
     yarp::os::Stamp ystamp;
-    double stagnantstart = 0;
     int channel;
-    qROI.setSize(50.0);
+    for(size_t k = 0; k < targets.size(); k++)
+        targets[k]->qROI.setSize(50.0);
 
     //START HERE!!
     const vQueue *q = inputPort.read(ystamp);
     if(!q || isStopping()) return;
-    vpf.extractTargetPosition(avgx, avgy, avgr);
+    for(size_t k = 0; k < targets.size(); k++) {
+        target &t = *targets[k];
+        t.vpf.extractTargetPosition(t.avgx, t.avgy, t.avgr);
+    }
 
     channel = q->front()->getChannel();
 
@@ -167,21 +219,30 @@ void delayControl::run()
         //calculate error
         double delay = inputPort.queryDelayT();
         unsigned int unprocdqs = inputPort.queryunprocessed();
-        targetproc = M_PI * avgr;
-        if(unprocdqs > 1 && delay > gain)
-            targetproc *= (delay / gain);
+        targetproc = 0;
+        for(size_t k = 0; k < targets.size(); k++) {
+            target &t = *targets[k];
+            t.targetproc = M_PI * t.avgr;
+            if(unprocdqs > 1 && delay > gain)
+                t.targetproc *= (delay / gain);
+            if(!t.targetproc) t.targetproc = 1;
+            t.added = 0;
+            targetproc += t.targetproc;
+        }
 
         //targetproc = minEvents + (int)(delay * gain);
         //targetproc = M_PI * avgr * minEvents + (int)(delay * gain);
 
-        //update the ROI with enough events
+        //update the ROIs with enough events. A single pass over the input
+        //gives each event to every target whose ROI contains it.
         Tgetwindow = yarp::os::Time::now();
-        unsigned int addEvents = 0;
-        unsigned int testedEvents = 0;
-        while(addEvents < targetproc) {
+        unsigned int waiting = targets.size();
+        while(waiting) {
 
-            //if we ran out of events get a new queue
+            //if we ran out of events get a new queue, unless a target is
+            //ready and the others are only waiting for events in their ROI
             if(i >= q->size()) {
+                if(waiting < targets.size()) break;
                 //if(inputPort.queryunprocessed() < 3) break;
                 //inputPort.scrapQ();
                 i = 0;
@@ -190,10 +251,11 @@ void delayControl::run()
             }
 
             auto v = is_event<AE>((*q)[i]);
-            addEvents += qROI.add(v);
-            //if(breakOnAdded) testedEvents = addEvents;
-            //else testedEvents++;
-            testedEvents++;
+            for(size_t k = 0; k < targets.size(); k++) {
+                target &t = *targets[k];
+                if(t.qROI.add(v) && ++t.added == t.targetproc)
+                    waiting--;
+            }
             i++;
         }
         Tgetwindow = yarp::os::Time::now() - Tgetwindow;
@@ -205,76 +267,95 @@ void delayControl::run()
         else
             currentstamp = (*q)[i]->stamp;
 
-        //do our update!!
+        //do our update!! (all targets share the observation threads)
         //yarp::os::Time::delay(0.005);
         Tlikelihood = yarp::os::Time::now();
-        vpf.performObservation(qROI.q);
+        for(size_t k = 0; k < targets.size(); k++)
+            if(targets[k]->added)
+                pool.add(&targets[k]->vpf, &targets[k]->qROI.q);
+        pool.process();
         Tlikelihood = yarp::os::Time::now() - Tlikelihood;
 
-        //set our new position
-        dx = avgx, dy = avgy, dr = avgr;
-        vpf.extractTargetPosition(avgx, avgy, avgr);
-        dx = avgx - dx; dy = avgy - dy; dr = avgr - dr;
-        double roisize = avgr + 10;
-        qROI.setROI(avgx - roisize, avgx + roisize, avgy - roisize, avgy + roisize);
-
-        //set our new window #events
-        qROI.setSize(512);
-//        double nw; vpf.extractTargetWindow(nw);
-//        if(qROI.q.size() - nw > 30)
-//            qROI.setSize(std::max(nw, 50.0));
-//        if(qROI.q.size() > 3000)
-//            qROI.setSize(3000);
-
-        //calculate the temporal window of the q
-        double tw = qROI.q.front()->stamp - qROI.q.back()->stamp;
-        if(tw < 0) tw += vtsHelper::max_stamp;
-
-        Tresample = yarp::os::Time::now();
-        vpf.performResample();
-        Tresample = yarp::os::Time::now() - Tresample;
-
-        Tpredict = yarp::os::Time::now();
-        //vpf.performPrediction(std::max(addEvents / (5.0 * avgr), 0.7));
-        vpf.performPrediction(motionVariance);
-        Tpredict = yarp::os::Time::now() - Tpredict;
-
-        //check for stagnancy
-        if(vpf.maxlikelihood < detectionThreshold) {
-
-            if(!stagnantstart) {
-                stagnantstart = yarp::os::Time::now();
-            } else {
-                if(yarp::os::Time::now() - stagnantstart > resetTimeout) {
-                    vpf.resetToSeed();
-                    stagnantstart = 0;
+        vQueue outq;
+        for(size_t k = 0; k < targets.size(); k++) {
+
+            target &t = *targets[k];
+            if(!t.added) continue;
+
+            //set our new position
+            t.dx = t.avgx, t.dy = t.avgy, t.dr = t.avgr;
+            t.vpf.extractTargetPosition(t.avgx, t.avgy, t.avgr);
+            t.dx = t.avgx - t.dx; t.dy = t.avgy - t.dy; t.dr = t.avgr - t.dr;
+            double roisize = t.avgr + 10;
+            t.qROI.setROI(t.avgx - roisize, t.avgx + roisize,
+                          t.avgy - roisize, t.avgy + roisize);
+
+            //set our new window #events
+            t.qROI.setSize(512);
+//            double nw; vpf.extractTargetWindow(nw);
+//            if(qROI.q.size() - nw > 30)
+//                qROI.setSize(std::max(nw, 50.0));
+//            if(qROI.q.size() > 3000)
+//                qROI.setSize(3000);
+
+            //calculate the temporal window of the q
+            double tw = t.qROI.q.front()->stamp - t.qROI.q.back()->stamp;
+            if(tw < 0) tw += vtsHelper::max_stamp;
+
+            Tresample = yarp::os::Time::now();
+            t.vpf.performResample();
+            Tresample = yarp::os::Time::now() - Tresample;
+
+            Tpredict = yarp::os::Time::now();
+            //vpf.performPrediction(std::max(addEvents / (5.0 * avgr), 0.7));
+            t.vpf.performPrediction(motionVariance);
+            Tpredict = yarp::os::Time::now() - Tpredict;
+
+            //check for stagnancy
+            if(t.vpf.maxlikelihood < detectionThreshold) {
+
+                if(!t.stagnantstart) {
+                    t.stagnantstart = yarp::os::Time::now();
+                } else {
+                    if(yarp::os::Time::now() - t.stagnantstart > resetTimeout) {
+                        t.vpf.resetToSeed();
+                        t.stagnantstart = 0;
+                    }
                 }
+
+            } else {
+                t.stagnantstart = 0;
             }
 
-        } else {
-            stagnantstart = 0;
-        }
+            //output our event
+            if(outputPort.getOutputCount()) {
+                auto ceg = make_event<GaussianAE>();
+                ceg->stamp = currentstamp;
+                ceg->setChannel(t.qROI.channel < 0 ? channel : t.qROI.channel);
+                ceg->ID = t.id;
+                ceg->x = t.avgx;
+                ceg->y = t.avgy;
+                ceg->sigx = t.avgr;
+                ceg->sigy = tw;
+                ceg->sigxy = 1.0;
+                if(t.vpf.maxlikelihood > detectionThreshold)
+                    ceg->polarity = 1.0;
+                else
+                    ceg->polarity = 0.0;
+
+                outq.push_back(ceg);
+            }
 
+            //and the latest state for control loops
+            targetPort.publish(t.id, t.qROI.channel < 0 ? channel : t.qROI.channel,
+                               t.avgx, t.avgy, t.avgr,
+                               t.vpf.maxlikelihood > detectionThreshold,
+                               currentstamp);
+        }
 
-        //output our event
-        if(outputPort.getOutputCount()) {
-            auto ceg = make_event<GaussianAE>();
-            ceg->stamp = currentstamp;
-            ceg->setChannel(channel);
-            ceg->x = avgx;
-            ceg->y = avgy;
-            ceg->sigx = avgr;
-            ceg->sigy = tw;
-            ceg->sigxy = 1.0;
-            if(vpf.maxlikelihood > detectionThreshold)
-                ceg->polarity = 1.0;
-            else
-                ceg->polarity = 0.0;
-
-            vQueue outq; outq.push_back(ceg);
+        if(outq.size())
             outputPort.write(outq, ystamp);
-
-        }
+        targetPort.flush(&ystamp);
 
         static double prev_update_time = Tgetwindow;
         filterPeriod = Time::now() - prev_update_time;
@@ -383,36 +464,41 @@ void delayControl::run()
                 yarp::sig::ImageOf<yarp::sig::PixelBgr> &image = *image_ptr;
                 int panoff = panelnumber * res.width;
 
-                int px1 = avgx - roisize; if(px1 < 0) px1 = 0;
-                int px2 = avgx + roisize; if(px2 >= res.width) px2 = res.width-1;
-                int py1 = avgy - roisize; if(py1 < 0) py1 = 0;
-                int py2 = avgy + roisize; if(py2 >= res.height) py2 = res.height-1;
+                for(size_t k = 0; k < targets.size(); k++) {
 
-                px1 += panoff; px2 += panoff;
-                for(int x = px1; x <= px2; x+=2) {
-                    image(x, py1) = yarp::sig::PixelBgr(255, 255, 120 * panelnumber);
-                    image(x, py2) = yarp::sig::PixelBgr(255, 255, 120 * panelnumber);
-                }
-                for(int y = py1; y <= py2; y+=2) {
-                    image(px1, y) = yarp::sig::PixelBgr(255, 255, 120 * panelnumber);
-                    image(px2, y) = yarp::sig::PixelBgr(255, 255, 120 * panelnumber);
-                }
+                    target &t = *targets[k];
+                    double roisize = t.avgr + 10;
+                    int px1 = t.avgx - roisize; if(px1 < 0) px1 = 0;
+                    int px2 = t.avgx + roisize; if(px2 >= res.width) px2 = res.width-1;
+                    int py1 = t.avgy - roisize; if(py1 < 0) py1 = 0;
+                    int py2 = t.avgy + roisize; if(py2 >= res.height) py2 = res.height-1;
+
+                    px1 += panoff; px2 += panoff;
+                    for(int x = px1; x <= px2; x+=2) {
+                        image(x, py1) = yarp::sig::PixelBgr(255, 255, 120 * panelnumber);
+                        image(x, py2) = yarp::sig::PixelBgr(255, 255, 120 * panelnumber);
+                    }
+                    for(int y = py1; y <= py2; y+=2) {
+                        image(px1, y) = yarp::sig::PixelBgr(255, 255, 120 * panelnumber);
+                        image(px2, y) = yarp::sig::PixelBgr(255, 255, 120 * panelnumber);
+                    }
 
-                std::vector<vParticle> indexedlist = vpf.getps();
+                    std::vector<vParticle> indexedlist = t.vpf.getps();
 
-                for(unsigned int i = 0; i < indexedlist.size(); i++) {
+                    for(unsigned int i = 0; i < indexedlist.size(); i++) {
 
-                    int py = indexedlist[i].gety();
-                    int px = indexedlist[i].getx();
+                        int py = indexedlist[i].gety();
+                        int px = indexedlist[i].getx();
 
-                    if(py < 0 || py >= res.height || px < 0 || px >= res.width)
-                        continue;
-                    int pscale = 255 * indexedlist[i].getl() / maxRawLikelihood;
-                    image(px+panoff, py) =
-                            yarp::sig::PixelBgr(pscale, 255, pscale);
+                        if(py < 0 || py >= res.height || px < 0 || px >= res.width)
+                            continue;
+                        int pscale = 255 * indexedlist[i].getl() / maxRawLikelihood;
+                        image(px+panoff, py) =
+                                yarp::sig::PixelBgr(pscale, 255, pscale);
 
+                    }
+                    drawEvents(image, t.qROI.q, panoff);
                 }
-                drawEvents(image, qROI.q, panoff);
 
                 panelnumber++;
             }
@@ -440,6 +526,7 @@ roiq::roiq()
     roi[0] = 0; roi[1] = 1000;
     roi[2] = 0; roi[3] = 1000;
     use_TW = false;
+    channel = -1;
 }
 
 void roiq::setSize(unsigned int value)
@@ -462,6 +549,8 @@ int roiq::add(event<AE> &v)
 
     if(v->x < roi[0] || v->x > roi[1] || v->y < roi[2] || v->y > roi[3])
         return 0;
+    if(channel >= 0 && v->channel != channel)
+        return 0;
     q.push_front(v);
     return 1;
 }
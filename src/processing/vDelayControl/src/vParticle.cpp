@@ -359,27 +359,62 @@ void vParticlefilter::setAdaptive(bool value)
     adaptive = value;
 }
 
+void vParticlefilter::setRadiusRange(int rmin, int rmax)
+{
+    if(rmin < 1) rmin = 1;
+    if(rmax < rmin) rmax = rmin;
+    rbound_min = rmin;
+    rbound_max = rmax;
+
+    //the look-up table only needs to cover the largest radius
+    pcb.configure(res.height, res.width, rbound_max, bins);
+    for(int i = 0; i < nparticles; i++)
+        ps[i].setContraints(0, res.width, 0, res.height, rbound_min, rbound_max);
+
+    resetToSeed();
+}
+
+double vParticlefilter::observe(const vQueue &q, int pStart, int pEnd)
+{
+    for(int i = pStart; i < pEnd; i++) {
+        ps[i].initLikelihood(q.size());
+    }
+
+    for(int i = pStart; i < pEnd; i++) {
+        for(int j = 0; j < (int)q.size(); j++) {
+            AE* v = read_as<AE>(q[j]);
+            ps[i].incrementalLikelihood(v->x, v->y, j);
+        }
+    }
+
+    double normval = 0.0;
+    for(int i = pStart; i < pEnd; i++) {
+        ps[i].concludeLikelihood();
+        normval += ps[i].getw();
+    }
+
+    return normval;
+}
+
+void vParticlefilter::concludeObservation(double normval)
+{
+    pwsumsq = 0;
+    maxlikelihood = 0;
+    for(int i = 0; i < nparticles; i ++) {
+        ps[i].updateWeightSync(normval);
+        pwsumsq += pow(ps[i].getw(), 2.0);
+        maxlikelihood = std::max(maxlikelihood, ps[i].getl());
+    }
+}
+
 void vParticlefilter::performObservation(const vQueue &q)
 {
     double normval = 0.0;
     if(nthreads == 1) {
 
         //START WITHOUT THREAD
-        for(int i = 0; i < nparticles; i++) {
-            ps[i].initLikelihood(q.size());
-        }
+        normval = observe(q, 0, nparticles);
 
-        for(int i = 0; i < nparticles; i++) {
-            for(int j = 0; j < (int)q.size(); j++) {
-                AE* v = read_as<AE>(q[j]);
-                ps[i].incrementalLikelihood(v->x, v->y, j);
-            }
-        }
-
-        for(int i = 0; i < nparticles; i++) {
-            ps[i].concludeLikelihood();
-            normval += ps[i].getw();
-        }
     } else {
 
         //START MULTI-THREAD
@@ -393,13 +428,7 @@ void vParticlefilter::performObservation(const vQueue &q)
         }
     }
 
-    pwsumsq = 0;
-    maxlikelihood = 0;
-    for(int i = 0; i < nparticles; i ++) {
-        ps[i].updateWeightSync(normval);
-        pwsumsq += pow(ps[i].getw(), 2.0);
-        maxlikelihood = std::max(maxlikelihood, ps[i].getl());
-    }
+    concludeObservation(normval);
 
 }
 
@@ -497,6 +526,7 @@ double vPartObsThread::waittilldone()
 
 void vPartObsThread::run()
 {
+    ev::vMetrics::get().registerThread("vDelayControl/observer");
     while(!isStopping()) {
 
         processing.lock();
@@ -526,3 +556,86 @@ void vPartObsThread::run()
     }
 
 }
+
+/*////////////////////////////////////////////////////////////////////////////*/
+//particlepool (observers shared by many filters)
+/*////////////////////////////////////////////////////////////////////////////*/
+
+bool vParticlePool::start(int nthreads)
+{
+    stop();
+    this->nthreads = nthreads > 1 ? nthreads : 1;
+    for(int i = 1; i < this->nthreads; i++) {
+        workers.push_back(new worker(this));
+        if(!workers.back()->start())
+            return false;
+    }
+    return true;
+}
+
+void vParticlePool::stop()
+{
+    for(size_t i = 0; i < workers.size(); i++) {
+        workers[i]->stop();
+        delete workers[i];
+    }
+    workers.clear();
+}
+
+void vParticlePool::add(vParticlefilter *pf, const vQueue *q)
+{
+    //enough chunks that every thread gets work even with a single filter
+    int n = pf->size();
+    int chunk = (n + nthreads - 1) / nthreads;
+    if(chunk < 1) chunk = 1;
+    for(int pStart = 0; pStart < n; pStart += chunk) {
+        job j = {pf, q, pStart, std::min(pStart + chunk, n), 0.0};
+        jobs.push_back(j);
+    }
+}
+
+void vParticlePool::work()
+{
+    unsigned int j;
+    while((j = next.fetch_add(1)) < jobs.size())
+        jobs[j].normval = jobs[j].pf->observe(*jobs[j].q, jobs[j].pStart,
+                                              jobs[j].pEnd);
+}
+
+void vParticlePool::process()
+{
+    if(jobs.empty()) return;
+
+    next = 0;
+    for(size_t i = 0; i < workers.size(); i++)
+        workers[i]->go.post();
+    work();
+    for(size_t i = 0; i < workers.size(); i++)
+        finished.wait();
+
+    //the chunks of a filter are consecutive
+    size_t first = 0;
+    while(first < jobs.size()) {
+        double normval = 0.0;
+        size_t last = first;
+        for(; last < jobs.size() && jobs[last].pf == jobs[first].pf; last++)
+            normval += jobs[last].normval;
+        jobs[first].pf->concludeObservation(normval);
+        first = last;
+    }
+
+    jobs.clear();
+}
+
+void vParticlePool::worker::run()
+{
+    ev::vMetrics::get().registerThread("vDelayControl/worker");
+    while(!isStopping()) {
+
+        go.wait();
+        if(isStopping()) return;
+
+        pool->work();
+        pool->finished.post();
+    }
+}
@@ -0,0 +1,75 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// \defgroup Modules Modules
+// \defgroup vDownsample vDownsample
+// \ingroup Modules
+// \brief reduces the spatial resolution (and event rate) of an event stream
+
+#ifndef __VDOWNSAMPLE__
+#define __VDOWNSAMPLE__
+
+#include <yarp/os/all.h>
+#include <iCub/eventdriven/all.h>
+#include <atomic>
+
+using namespace ev;
+
+class downsampler : public yarp::os::Thread
+{
+private:
+
+    vReadPort< std::vector<int32_t> > inPort;
+    vWritePort outPort;
+
+    ev::vDownsample thefilter;
+    std::atomic<unsigned long> countIn;
+    std::atomic<unsigned long> countOut;
+
+public:
+
+    downsampler() : countIn(0), countOut(0) {}
+
+    bool open(std::string name);
+    bool initialise(int width, int height, int factor, std::string mode,
+                    double threshold, double leak, double refractory);
+
+    /// \brief the number of events in and out since the last call
+    void queryCounts(unsigned long &in, unsigned long &out);
+
+    void onStop();
+    void run();
+
+};
+
+class vDownsampleModule : public yarp::os::RFModule
+{
+    downsampler eventManager;
+
+public:
+
+    //the virtual functions that need to be overloaded
+    virtual bool configure(yarp::os::ResourceFinder &rf);
+    virtual bool interruptModule();
+    virtual bool close();
+    virtual double getPeriod();
+    virtual bool updateModule();
+
+};
+
+#endif
@@ -0,0 +1,177 @@
+/*
+ *   Copyright (C) 2017 Event-driven Perception for Robotics
+ *   Author: arren.glover@iit.it
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "vDownsample.h"
+
+int main(int argc, char * argv[])
+{
+    /* initialize yarp network */
+    yarp::os::Network yarp;
+    if(!yarp.checkNetwork()) {
+        yError() << "Could not find YARP network";
+        return false;
+    }
+
+    /* prepare and configure the resource finder */
+    yarp::os::ResourceFinder rf;
+    rf.setVerbose( false );
+    rf.setDefaultContext( "eventdriven" );
+    rf.setDefaultConfigFile( "vDownsample.ini" );
+    rf.configure( argc, argv );
+
+    /* create the module */
+    vDownsampleModule module;
+    return module.runModule(rf);
+}
+
+/******************************************************************************/
+//vDownsampleModule
+/******************************************************************************/
+bool vDownsampleModule::configure(yarp::os::ResourceFinder &rf)
+{
+    setName((rf.check("name", yarp::os::Value("/vDownsample")).asString()).c_str());
+
+    int width = rf.check("width", yarp::os::Value(304)).asInt();
+    int height = rf.check("height", yarp::os::Value(240)).asInt();
+    int factor = rf.check("factor", yarp::os::Value(2)).asInt();
+    std::string mode = rf.check("mode", yarp::os::Value("integrate")).asString();
+    double threshold = rf.check("threshold", yarp::os::Value(factor * factor / 2.0)).asDouble();
+    double leak = rf.check("leak", yarp::os::Value(0.01)).asDouble();
+    double refractory = rf.check("refractory", yarp::os::Value(0.005)).asDouble();
+
+    if(!eventManager.initialise(width, height, factor, mode, threshold,
+                                leak, refractory))
+        return false;
+
+    if(!eventManager.open(getName()))
+        return false;
+
+    return eventManager.start();
+}
+
+bool vDownsampleModule::interruptModule()
+{
+    eventManager.stop();
+    return true;
+}
+
+bool vDownsampleModule::close()
+{
+    return true;
+}
+
+double vDownsampleModule::getPeriod()
+{
+    return 5.0;
+}
+
+bool vDownsampleModule::updateModule()
+{
+    unsigned long in, out;
+    eventManager.queryCounts(in, out);
+    if(in)
+        yInfo() << "[DOWNSAMPLE]" << (int)(in / (1000.0 * getPeriod()))
+                << "->" << (int)(out / (1000.0 * getPeriod())) << "kV/s";
+    return !isStopping();
+}
+
+/******************************************************************************/
+//downsampler
+/******************************************************************************/
+bool downsampler::initialise(int width, int height, int factor,
+                             std::string mode, double threshold, double leak,
+                             double refractory)
+{
+    if(!thefilter.initialise(width, height, factor)) {
+        yError() << "The downsampling factor must be a power of two:" << factor;
+        return false;
+    }
+
+    vDownsample::mode m;
+    if(!vDownsample::modeOf(mode, m)) {
+        yError() << "Unknown downsampling mode:" << mode
+                 << "(integrate or refractory)";
+        return false;
+    }
+
+    if(m == vDownsample::INTEGRATE) {
+        thefilter.setIntegrate(threshold, leak * vtsHelper::vtsscaler);
+        yInfo() << "Downsampling by" << factor << "with integrate-and-fire:"
+                << threshold << "events, leak of one every" << leak << "s";
+    } else {
+        thefilter.setRefractory(refractory * vtsHelper::vtsscaler);
+        yInfo() << "Downsampling by" << factor << "with a refractory period of"
+                << refractory << "s";
+    }
+    yInfo() << "Output resolution" << thefilter.outputWidth() << "x"
+            << thefilter.outputHeight();
+
+    return true;
+}
+
+bool downsampler::open(std::string name)
+{
+    outPort.setWriteType(AE::tag);
+    if(!outPort.open(name + "/AE:o"))
+        return false;
+    if(!inPort.open(name + "/AE:i"))
+        return false;
+    return true;
+}
+
+void downsampler::onStop()
+{
+    inPort.close();
+    outPort.close();
+}
+
+void downsampler::queryCounts(unsigned long &in, unsigned long &out)
+{
+    in = countIn.exchange(0);
+    out = countOut.exchange(0);
+}
+
+void downsampler::run()
+{
+    ev::vMetrics::get().registerThread("vDownsample");
+    yarp::os::Stamp ystamp;
+    std::deque<AE> q;
+    AE v;
+
+    while(true) {
+
+        const std::vector<int32_t> *data = inPort.read(ystamp);
+        if(!data || isStopping()) return;
+
+        //decode the whole packet, then downsample it in place
+        q.clear();
+        const int32_t *qi = data->data();
+        while((size_t)(qi - data->data()) < data->size()) {
+            v.decode(qi);
+            q.push_back(v);
+        }
+        countIn += q.size();
+
+        thefilter.filter(q);
+        countOut += q.size();
+
+        //the envelope of the input is forwarded to keep its provenance
+        if(q.size())
+            outPort.write(q, ystamp);
+    }
+}
@@ -117,10 +117,11 @@ vFlowManager::vFlowManager(int height, int width, int filterSize,
 
 
     //create our surface in synchronous mode
-    surfaceOnL = new ev::temporalSurface(width, height);
-    surfaceOfL = new ev::temporalSurface(width, height);
-    surfaceOnR = new ev::temporalSurface(width, height);
-    surfaceOfR = new ev::temporalSurface(width, height);
+    int duration = 2.0 * ev::vtsHelper::vtsscaler;
+    surfaceOnL = ev::createSurface("temporal", width, height, duration);
+    surfaceOfL = ev::createSurface("temporal", width, height, duration);
+    surfaceOnR = ev::createSurface("temporal", width, height, duration);
+    surfaceOfR = ev::createSurface("temporal", width, height, duration);
 }
 
 bool vFlowManager::open(std::string moduleName, bool strictness)
@@ -24,6 +24,8 @@
 
 #include <iCub/eventdriven/all.h>
 #include <string>
+#include <vector>
+#include <deque>
 #include <opencv2/opencv.hpp>
 
 class vDraw;
@@ -265,11 +267,68 @@ protected:
         x = xmod; y = ymod; z = zmod;
     }
 
+    //the projection is linear, so it is split into tables of the image
+    //position (including the shift) contributed by each x, y and z:
+    //u = xu[x] + zu[z] and v = xv[x] + yv[y] + zv[z]
+    std::vector<float> xu, xv, yv, zu, zv;
+
+    //project a point with the tables (pttr outside of them) and shift it
+    //into the image
+    void project(int x, int y, int z, int &u, int &v);
+
+    //project, returning false if the point is outside of the image
+    bool projectInside(int x, int y, int z, int &u, int &v)
+    {
+        project(x, y, z, u, v);
+        return u >= 0 && u < imagewidth && v >= 0 && v < imageheight;
+    }
+
     //image with warped square drawn
     cv::Mat baseimage;
+    //white image less the baseimage, on which the events are drawn
+    cv::Mat background;
+
+    //draw a colour at a pixel of an image made from the background
+    void plot(cv::Mat &image, int u, int v, const cv::Vec3b &colour)
+    {
+        const cv::Vec3b &base = baseimage.at<cv::Vec3b>(v, u);
+        image.at<cv::Vec3b>(v, u) =
+                cv::Vec3b(cv::saturate_cast<uchar>(colour[0] - base[0]),
+                          cv::saturate_cast<uchar>(colour[1] - base[1]),
+                          cv::saturate_cast<uchar>(colour[2] - base[2]));
+    }
+
+private:
+
+    //the events are kept projected onto the x-y plane in slices of time
+    //(one z step long), so only the new events are projected each frame
+    //and a slice is moved along the time axis with a single zu, zv offset.
+    //The depth of an event is therefore quantised to its slice (see draw())
+    struct isoPoint {
+        float u;
+        float v;
+        bool polarity;
+    };
+
+    struct isoSlice {
+        int64_t bin;
+        std::vector<isoPoint> points;
+    };
+
+    std::deque<isoSlice> slices;
+    unsigned int slice_ticks;
+    int64_t reference;
+    const ev::vEvent *last_event;
+    unsigned int last_stamp;
+
+    void clearSlices();
+    void addToSlices(const ev::AE *aep);
 
 public:
 
+    isoDraw() : slice_ticks(1), reference(0), last_event(nullptr),
+        last_stamp(0) {}
+
     void initialise();
 
     static const std::string drawtype;
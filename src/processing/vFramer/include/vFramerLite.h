@@ -49,7 +49,11 @@ private:
     unsigned int limit_time;
 
     map<string, vReadPort<vQueue> > read_ports;
+    //input port name -> local output port to read from in shared memory
+    map<string, string> shared_sources;
     map<string, vQueue> event_qs;
+    map<string, vMerge> mergers;
+    Stamp latest_stamp;
     vector<vDraw *> drawers;
     BufferedPort< ImageOf<PixelBgr> > image_port;
 
@@ -65,6 +69,7 @@ private:
 public:
 
     channelInstance(string channel_name);
+    void setSharedSource(string port_name, string source);
     bool addDrawer(string drawer_name, unsigned int width,
                    unsigned int height, unsigned int window_size, bool flip);
 
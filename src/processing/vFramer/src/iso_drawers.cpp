@@ -162,51 +162,158 @@ void isoDraw::initialise()
 
     }
 
+    //the projection tables (see pttr), which include the image shift
+    xu.resize(Xlimit + 1); xv.resize(Xlimit + 1);
+    yv.resize(Ylimit + 1);
+    zu.resize(Zlimit + 1); zv.resize(Zlimit + 1);
+    for(int xi = 0; xi <= Xlimit; xi++) {
+        xu[xi] = xi * CY + imagexshift;
+        xv[xi] = xi * SX * SY;
+    }
+    for(int yi = 0; yi <= Ylimit; yi++)
+        yv[yi] = yi * CX + imageyshift;
+    for(int zi = 0; zi <= Zlimit; zi++) {
+        zu[zi] = zi * SY;
+        zv[zi] = -zi * SX * CY;
+    }
+
+    background = cv::Mat(imageheight, imagewidth, CV_8UC3,
+                         cv::Scalar(255, 255, 255)) - baseimage;
+
+    //a slice is the time of one step along the time axis
+    slice_ticks = std::max(1.0, 1.0 / ts_to_axis);
+    clearSlices();
+
     yInfo() << "Finished setting up ISO draw";
 
 
 
 }
 
-void isoDraw::draw(cv::Mat &image, const ev::vQueue &eSet, int vTime)
+void isoDraw::project(int x, int y, int z, int &u, int &v)
 {
+    if(x < 0 || x > Xlimit || y < 0 || y > Ylimit || z < 0 || z > Zlimit) {
+        pttr(x, y, z);
+        u = x + imagexshift;
+        v = y + imageyshift;
+        return;
+    }
 
-    cv::Mat isoimage = baseimage.clone();
-    isoimage.setTo(255);
+    float fu = xu[x] + zu[z];
+    float fv = xv[x] + yv[y] + zv[z];
+    //+0.5 rounds rather than floor (and negatives are outside the image)
+    u = fu < 0 ? -1 : (int)(fu + 0.5f);
+    v = fv < 0 ? -1 : (int)(fv + 0.5f);
+}
 
-    if(eSet.empty()) return;
-    if(vTime < 0) vTime = eSet.back()->stamp;
+void isoDraw::clearSlices()
+{
+    slices.clear();
+    last_event = nullptr;
+}
 
-    int skip = 1 + eSet.size() / 100000;
+void isoDraw::addToSlices(const AE *aep)
+{
+    int64_t key = vMerge::unwrap(aep->stamp, reference);
+    if(key > reference) reference = key;
+    int64_t bin = key / slice_ticks;
+
+    //slices older than the time axis are no longer drawn
+    int64_t newest = reference / slice_ticks;
+    while(slices.size() && newest - slices.front().bin > Zlimit + 1)
+        slices.pop_front();
+    if(slices.size() && bin < slices.front().bin)
+        return;
 
-    for(int i = eSet.size() - 1; i >= 0; i -= skip) {
+    //keep one slice for each step from the oldest to the newest event
+    if(slices.size() && bin - slices.back().bin > Zlimit + 1)
+        slices.clear();
+    if(slices.empty()) {
+        slices.push_back(isoSlice());
+        slices.back().bin = bin;
+    }
+    while(slices.back().bin < bin) {
+        int64_t next = slices.back().bin + 1;
+        slices.push_back(isoSlice());
+        slices.back().bin = next;
+    }
 
-        AE *aep = read_as<AE>(eSet[i]);
+    int px = aep->x;
+    int py = aep->y;
+    if(flip) {
+        px = Xlimit - 1 - px;
+        py = Ylimit - 1 - py;
+    }
+    if(px < 0 || px > Xlimit || py < 0 || py > Ylimit)
+        return;
 
-        //transform values
-        int dt = vTime - aep->stamp;
-        if(dt < 0) dt += ev::vtsHelper::max_stamp;
-        if((unsigned int)dt > max_window) continue;
-        dt = dt * ts_to_axis + 0.5;
-        int px = aep->x;
-        int py = aep->y;
-        if(flip) {
-            px = Xlimit - 1 - px;
-            py = Ylimit - 1 - py;
-        }
-        int pz = dt;
-        pttr(px, py, pz);
-        px += imagexshift;
-        py += imageyshift;
+    isoPoint p = {xu[px], xv[px] + yv[py], aep->polarity != 0};
+    slices[bin - slices.front().bin].points.push_back(p);
+}
 
-        if(px < 0 || px >= imagewidth || py < 0 || py >= imageheight) {
-            continue;
-        }
+void isoDraw::draw(cv::Mat &image, const ev::vQueue &eSet, int vTime)
+{
+
+    cv::Mat isoimage = background.clone();
 
-        if(!aep->polarity) {
-            isoimage.at<cv::Vec3b>(py, px) = cv::Vec3b(255, 160, 255);
-        } else {
-            isoimage.at<cv::Vec3b>(py, px) = cv::Vec3b(160, 255, 160);
+    if(eSet.empty()) return;
+
+    //find the events added since the last frame, or start again if the
+    //last event drawn is no longer in the window
+    int first_new = eSet.size();
+    while(first_new > 0) {
+        const vEvent *v = eSet[first_new - 1].get();
+        if(v == last_event && v->stamp == last_stamp) break;
+        first_new--;
+    }
+    if(!first_new && last_event)
+        clearSlices();
+    if(slices.empty() && !last_event)
+        reference = eSet.front()->stamp;
+
+    for(size_t i = first_new; i < eSet.size(); i++)
+        addToSlices(read_as<AE>(eSet[i]));
+    last_event = eSet.back().get();
+    last_stamp = eSet.back()->stamp;
+
+    int64_t now = vTime < 0 ? reference : vMerge::unwrap(vTime, reference);
+
+    int skip = 1 + eSet.size() / 100000;
+    int count = 0;
+
+    //newest to oldest, so the older events are drawn on top
+    for(int s = slices.size() - 1; s >= 0; s--) {
+
+        const isoSlice &slice = slices[s];
+        if(slice.points.empty()) continue;
+
+        //the slice is placed at the time of its centre, so every event is
+        //drawn at the z of its bin centre rather than of its own stamp: an
+        //event up to half a slice away moves by one z step (about a quarter
+        //of the events), which is the price of one offset per slice
+        int64_t dt = now - slice.bin * slice_ticks - slice_ticks / 2;
+        if(dt < 0) dt = 0;
+        if(dt > max_window) break;
+        int pz = dt * ts_to_axis + 0.5;
+        if(pz > Zlimit) break;
+        float du = zu[pz], dv = zv[pz];
+
+        for(int i = slice.points.size() - 1; i >= 0; i--) {
+
+            if(count++ % skip) continue;
+            const isoPoint &p = slice.points[i];
+
+            float fu = p.u + du;
+            float fv = p.v + dv;
+            if(fu < 0 || fv < 0) continue;
+            int px = fu + 0.5f;
+            int py = fv + 0.5f;
+            if(px >= imagewidth || py >= imageheight) continue;
+
+            if(!p.polarity)
+                plot(isoimage, px, py, cv::Vec3b(255, 160, 255));
+            else
+                plot(isoimage, px, py, cv::Vec3b(160, 255, 160));
         }
     }
 
@@ -217,21 +324,17 @@ void isoDraw::draw(cv::Mat &image, const ev::vQueue &eSet, int vTime)
 
                 if(pixel[0] != 255 || pixel[1] != 255 || pixel[2] != 255) {
 
-                    int px = x, py = y, pz = 0; pttr(px, py, pz);
-                    px += imagexshift;
-                    py += imageyshift;
-                    if(px < 0 || px >= imagewidth || py < 0 || py >= imageheight)
+                    int px, py;
+                    if(!projectInside(x, y, 0, px, py))
                         continue;
 
-                    isoimage.at<cv::Vec3b>(py, px) = pixel;
+                    plot(isoimage, px, py, pixel);
                 }
             }
         }
     }
 
-
-
-    image = isoimage - baseimage;
+    image = isoimage;
 
 }
 
@@ -253,8 +356,7 @@ std::string isoInterestDraw::getEventType()
 void isoInterestDraw::draw(cv::Mat &image, const ev::vQueue &eSet, int vTime)
 {
 
-    cv::Mat isoimage = baseimage.clone();
-    isoimage.setTo(255);
+    cv::Mat isoimage = background.clone();
 
     if(eSet.empty()) return;
     if(vTime < 0) vTime = eSet.back()->stamp;
@@ -282,14 +384,8 @@ void isoInterestDraw::draw(cv::Mat &image, const ev::vQueue &eSet, int vTime)
             px = Xlimit - 1 - px;
             py = Ylimit - 1 - py;
         }
-        int pz = dt;
-        pttr(px, py, pz);
-        px += imagexshift;
-        py += imageyshift;
-
-        if(px < 0 || px >= imagewidth || py < 0 || py >= imageheight) {
+        if(!projectInside(px, py, dt, px, py))
             continue;
-        }
 
         cv::Point centr(px, py);
         if(cep->ID == 1)
@@ -305,17 +401,16 @@ void isoInterestDraw::draw(cv::Mat &image, const ev::vQueue &eSet, int vTime)
 
                 if(pixel[0] != 255 || pixel[1] != 255 || pixel[2] != 255) {
 
-                    int px = x, py = y;
-                    if(px < 0 || px >= imagewidth || py < 0 || py >= imageheight)
+                    if(x >= imagewidth || y >= imageheight)
                         continue;
 
-                    isoimage.at<cv::Vec3b>(py, px) = pixel;
+                    plot(isoimage, x, y, pixel);
                 }
             }
         }
     }
 
-    image = isoimage - baseimage;
+    image = isoimage;
 
 }
 
@@ -360,13 +455,8 @@ void isoCircDraw::draw(cv::Mat &image, const ev::vQueue &eSet, int vTime)
     int py2 = py1;
     int pz2 = Zlimit * (v->sigy / ev::vtsHelper::max_stamp) + 0.5;
 
-    pttr(px1, py1, pz1);
-    pttr(px2, py2, pz2);
-
-    px1 += imagexshift;
-    py1 += imageyshift;
-    px2 += imagexshift;
-    py2 += imageyshift;
+    project(px1, py1, pz1, px1, py1);
+    project(px2, py2, pz2, px2, py2);
 
     if(px1 < 0) px1 = 0;
     if(px1 >= imagewidth) px1 = imagewidth -1;
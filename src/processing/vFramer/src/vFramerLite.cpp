@@ -53,6 +53,11 @@ string channelInstance::getName()
     return channel_name;
 }
 
+void channelInstance::setSharedSource(string port_name, string source)
+{
+    shared_sources[port_name] = source;
+}
+
 bool channelInstance::addDrawer(string drawer_name, unsigned int width,
                                 unsigned int height, unsigned int window_size,
                                 bool flip)
@@ -78,12 +83,14 @@ bool channelInstance::addDrawer(string drawer_name, unsigned int width,
     //open the port
     total_time[event_type] = 0;
     prev_vstamp[event_type] = 0;
-    return read_ports[event_type].open(channel_name + "/" + event_type + ":i");
+    string port_name = channel_name + "/" + event_type + ":i";
+    return read_ports[event_type].open(port_name, shared_sources[port_name]);
 
 }
 
 bool channelInstance::threadInit()
 {
+    ev::vMetrics::get().registerThread(channel_name);
     return image_port.open(channel_name + "/image:o");
 }
 
@@ -101,19 +108,31 @@ bool channelInstance::updateQs()
 
     for(port_i = read_ports.begin(); port_i != read_ports.end(); port_i++) {
         const string &event_type = port_i->first;
+
+        //packets from several sources connected to the same port are not in
+        //order with each other, so all packets available are merged together
+        vector<vQueue> packets(qs_available[event_type]);
+        vector<const vQueue *> sources;
         for(int i = 0; i < qs_available[event_type]; i++) {
             const vQueue *q = port_i->second.read(yarp_stamp);
+            if(!q || q->empty()) continue;
+            latest_stamp = yarp_stamp;
+            packets[i] = *q;
+            sources.push_back(&packets[i]);
+        }
 
-            int q_dt = (int)q->back()->stamp - prev_vstamp[event_type];
+        if(sources.size()) {
+            vQueue &eq = event_qs[event_type];
+            size_t n_prev = eq.size();
+            mergers[event_type].merge(sources, eq);
+
+            int q_dt = (int)eq.back()->stamp - prev_vstamp[event_type];
             if(q_dt < 0) q_dt += vtsHelper::max_stamp;
 
-            prev_vstamp[event_type] = (int)q->back()->stamp;
+            prev_vstamp[event_type] = (int)eq.back()->stamp;
             total_time[event_type] += q_dt;
             bookmark_time[event_type].push_back(q_dt);
-            bookmark_n_events[event_type].push_back(q->size());
-
-            for(unsigned j = 0; j < q->size(); j++)
-                event_qs[event_type].push_back(q->at(j));
+            bookmark_n_events[event_type].push_back(eq.size() - n_prev);
         }
         while(total_time[event_type] > limit_time) {
             for(unsigned int i = 0; i < bookmark_n_events[event_type].front(); i++)
@@ -152,7 +171,8 @@ void channelInstance::run()
     o.resize(canvas.cols, canvas.rows);
 
     //write
-    //if(cEnv.isValid()) outports[i]->setEnvelope(cEnv);
+    //the image carries the envelope of the latest packet drawn
+    if(latest_stamp.isValid()) image_port.setEnvelope(latest_stamp);
     image_port.write();
 
     //updateQs();
@@ -236,6 +256,9 @@ bool vFramerModule::configure(yarp::os::ResourceFinder &rf)
 
     int nDisplays = displayList->size() / 2;
 
+    //((input port, local output port) ...) read in shared memory
+    yarp::os::Bottle * sharedList = rf.find("shared_input").asList();
+
 
     for(int i = 0; i < nDisplays; i++) {
 
@@ -244,6 +267,12 @@ bool vFramerModule::configure(yarp::os::ResourceFinder &rf)
 
         channelInstance * new_ci = new channelInstance(channel_name);
         new_ci->setRate(period);
+        for(unsigned int j = 0; sharedList && j < sharedList->size(); j++) {
+            Bottle * pair = sharedList->get(j).asList();
+            if(pair && pair->size() == 2)
+                new_ci->setSharedSource(pair->get(0).asString(),
+                                        pair->get(1).asString());
+        }
 
         Bottle * drawtypelist = displayList->get(i*2 + 1).asList();
         for(unsigned int j = 0; j < drawtypelist->size(); j++)
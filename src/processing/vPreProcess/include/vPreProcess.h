@@ -57,26 +57,36 @@ private:
     //filter class
     bool pepper;
     ev::vNoiseFilter thefilter;
-    int v_total;
-    int v_dropped;
+    ev::vCounter *v_total;
+    ev::vCounter *v_dropped;
 
-    //we store an openCV map to use as a look-up table for the undistortion
-    //given the camera parameters provided
+    //we store a look-up table for the undistortion given the camera
+    //parameters provided: the undistorted (x, y) of each pixel of both
+    //cameras in 16-bit fixed point, packed into one word
     bool rectify;
     bool undistort;
-    cv::Mat leftMap;
-    cv::Mat rightMap;
+    std::vector<int32_t> remap;
+    enum { NEAREST, SUBPIXEL, SPLAT } remap_mode;
     bool truncate;
     bool use_local_stamp;
 
     //output
     bool split;
+    bool ordered;
+    ev::vMerge stereomerge;
+
+    //local shared memory transport
+    bool shared_output;
+    std::string shared_input;
 
     //timing stats
     std::deque<double> delays;
     std::deque<double> rates;
     std::deque<double> intervals;
 
+    template <typename T> void publish(std::deque<T> &qleft,
+                                       std::deque<T> &qright, Stamp &stamp);
+
 public:
 
     vPreProcess();
@@ -86,15 +96,19 @@ public:
                    bool flipx, bool flipy, bool pepper, bool rectify, bool undistort,
                    bool split, bool local_stamp);
     void initPepper(int spatialSize, int temporalSize);
+    bool initFilterKernels(std::string left, std::string right,
+                           const yarp::os::Bottle *hotPixels);
+    void initSharedMemory(bool shared_output, std::string shared_input);
+    void initOrdering(bool ordered);
     void initUndistortion(const yarp::os::Bottle &left,
                           const yarp::os::Bottle &right,
                           const yarp::os::Bottle &stereo,
                           bool truncate);
+    bool initRemapMode(std::string mode);
     int queryUnprocessed();
     std::deque<double> getDelays();
     std::deque<double> getRates();
     std::deque<double> getIntervals();
-    void printFilterStats();
     void run();
     void onStop();
     bool threadInit();
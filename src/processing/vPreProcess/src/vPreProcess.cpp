@@ -20,6 +20,11 @@
 #include <iomanip>
 #include <stdio.h>
 
+//fractional bits of the undistortion look-up table
+static const int remap_bits = 5;
+static_assert(WeightedAE::subpixel == 1 << remap_bits,
+              "the look-up table precision should match WeightedAE");
+
 int main(int argc, char * argv[])
 {
     /* initialize yarp network */
@@ -63,6 +68,8 @@ bool vPreProcessModule::configure(yarp::os::ResourceFinder &rf)
             rf.check("split", yarp::os::Value(true)).asBool();
     bool local_stamp = rf.check("local_stamp") &&
             rf.check("local_stamp", yarp::os::Value(true)).asBool();
+    bool ordered = rf.check("ordered") &&
+            rf.check("ordered", yarp::os::Value(true)).asBool();
     if(precheck)
         yInfo() << "Performing precheck for event corruption";
     if(flipx)
@@ -79,15 +86,33 @@ bool vPreProcessModule::configure(yarp::os::ResourceFinder &rf)
         yInfo() << "Applying camera undistortion - without truncation";
     if(split)
         yInfo() << "Splitting into left/right streams";
+    if(ordered && !split)
+        yInfo() << "Merging left/right streams into temporal order";
 
     eventManager.initBasic(rf.check("name", yarp::os::Value("/vPreProcess")).asString(),
                            rf.check("height", yarp::os::Value(240)).asInt(),
                            rf.check("width", yarp::os::Value(304)).asInt(),
                            precheck, flipx, flipy, pepper, rectify, undistort, split, local_stamp);
 
+    eventManager.initSharedMemory(rf.check("shared_output") &&
+                                  rf.check("shared_output", yarp::os::Value(true)).asBool(),
+                                  rf.check("shared_input", yarp::os::Value("")).asString());
+
+    eventManager.initOrdering(ordered);
+
+    //the ev_* metrics replace the periodic statistics in the log
+    std::string metrics = rf.check("metrics", yarp::os::Value("")).asString();
+    if(metrics.size() && metrics != "false" &&
+            !ev::vMetrics::get().serve(metrics))
+        return false;
+
     if(pepper) {
         eventManager.initPepper(rf.check("spatialSize", yarp::os::Value(1)).asDouble(),
                                 rf.check("temporalSize", yarp::os::Value(0.1)).asDouble() * vtsHelper::vtsscaler);
+        if(!eventManager.initFilterKernels(rf.check("leftFilter", yarp::os::Value("ba")).asString(),
+                                           rf.check("rightFilter", yarp::os::Value("ba")).asString(),
+                                           rf.find("hotPixels").asList()))
+            return false;
     }
 
     if(undistort) {
@@ -113,6 +138,8 @@ bool vPreProcessModule::configure(yarp::os::ResourceFinder &rf)
         std::cout << rightParams.toString() << std::endl;
         std::cout << stereoParams.toString() << std::endl;
         eventManager.initUndistortion(leftParams, rightParams, stereoParams, truncate);
+        if(!eventManager.initRemapMode(rf.check("remap", yarp::os::Value("nearest")).asString()))
+            return false;
     }
 
     return eventManager.start();
@@ -122,12 +149,12 @@ bool vPreProcessModule::configure(yarp::os::ResourceFinder &rf)
 bool vPreProcessModule::close()
 {
     eventManager.stop();
+    ev::vMetrics::get().close();
     return yarp::os::RFModule::close();
 }
 
 bool vPreProcessModule::updateModule()
 {
-    eventManager.printFilterStats();
     //unprocessed data
     static int puqs = 0;
     int uqs = this->eventManager.queryUnprocessed();
@@ -186,10 +213,11 @@ double vPreProcessModule::getPeriod()
 /******************************************************************************/
 vPreProcess::vPreProcess(): name("/vPreProcess")
 {
-    leftMap.deallocate();
-    rightMap.deallocate();
-    v_total = 0;
-    v_dropped = 0;
+    remap_mode = NEAREST;
+    v_total = nullptr;
+    v_dropped = nullptr;
+    shared_output = false;
+    ordered = false;
 
     outPortCamLeft.setWriteType(AE::tag);
     outPortCamRight.setWriteType(AE::tag);
@@ -227,18 +255,56 @@ void vPreProcess::initBasic(std::string name, int height, int width,
 
 }
 
+void vPreProcess::initSharedMemory(bool shared_output, std::string shared_input)
+{
+    this->shared_output = shared_output;
+    this->shared_input = shared_input;
+}
+
+void vPreProcess::initOrdering(bool ordered)
+{
+    this->ordered = ordered;
+}
+
 void vPreProcess::initPepper(int spatialSize, int temporalSize)
 {
     thefilter.initialise(res.width, res.height, temporalSize, spatialSize);
 }
 
+bool vPreProcess::initFilterKernels(std::string left, std::string right,
+                                    const yarp::os::Bottle *hotPixels)
+{
+    std::string names[2] = {left, right};
+    for(int c = 0; c < 2; c++) {
+        vNoiseFilter::kernel k;
+        if(!vNoiseFilter::kernelOf(names[c], k)) {
+            yError() << "Unknown filter" << names[c]
+                     << "(ba, refractory, hotpixel or none)";
+            return false;
+        }
+        thefilter.setKernel(c, k);
+    }
+
+    //hot pixels as a list of (x y channel)
+    for(size_t i = 0; hotPixels && i < hotPixels->size(); i++) {
+        yarp::os::Bottle *px = hotPixels->get(i).asList();
+        if(!px || px->size() < 3) {
+            yError() << "Hot pixels should be a list of (x y channel)";
+            return false;
+        }
+        thefilter.setHotPixel(px->get(0).asInt(), px->get(1).asInt(),
+                              px->get(2).asInt());
+    }
+
+    return true;
+}
+
 void vPreProcess::initUndistortion(const yarp::os::Bottle &left,
                                    const yarp::os::Bottle &right,
                                    const yarp::os::Bottle &stereo, bool truncate)
 {
     this->truncate = truncate;
     const yarp::os::Bottle *coeffs[3] = { &left, &right, &stereo};
-    cv::Mat *maps[2] = {&leftMap, &rightMap};
     cv::Mat cameraMatrix[2];
     cv::Mat distCoeffs[2];
     cv::Mat rectRot[2];
@@ -319,31 +385,41 @@ void vPreProcess::initUndistortion(const yarp::os::Bottle &left,
 
         cv::undistortPoints(allpoints, mappoints, cameraMatrix[i], distCoeffs[i],
                             rectRot[i], Proj[i]);
-        *(maps[i]) = cv::Mat(res.height, res.width, CV_32SC2);
+        remap.resize(2 * res.height * res.width);
         for(unsigned int y = 0; y < res.height; y++) {
             for(unsigned int x = 0; x < res.width; x++) {
-                maps[i]->at<cv::Vec2i>(y, x) =
-                        mappoints.at<cv::Vec2f>(y * res.width + x);
+                cv::Vec2f p = mappoints.at<cv::Vec2f>(y * res.width + x);
+                int16_t fx = cv::saturate_cast<int16_t>(p[0] * (1 << remap_bits));
+                int16_t fy = cv::saturate_cast<int16_t>(p[1] * (1 << remap_bits));
+                remap[(i * res.height + y) * res.width + x] =
+                        (int32_t)((uint16_t)fx | ((uint32_t)(uint16_t)fy << 16));
             }
         }
     }
 }
 
-int vPreProcess::queryUnprocessed()
+bool vPreProcess::initRemapMode(std::string mode)
 {
-    return inPort.queryunprocessed();
+    if(mode == "nearest") {
+        remap_mode = NEAREST;
+    } else if(mode == "subpixel") {
+        remap_mode = SUBPIXEL;
+        yInfo() << "Undistorted events are output as" << WeightedAE::tag
+                << "with sub-pixel positions";
+    } else if(mode == "splat") {
+        remap_mode = SPLAT;
+        yInfo() << "Undistorted events are output as" << WeightedAE::tag
+                << "shared between up to four pixels";
+    } else {
+        yError() << "Unknown remap" << mode << "(nearest, subpixel or splat)";
+        return false;
+    }
+    return true;
 }
 
-void vPreProcess::printFilterStats()
+int vPreProcess::queryUnprocessed()
 {
-    if(v_total) {
-        double pc = 100.0 * (double)v_total / (double)(v_total + v_dropped);
-        yInfo() << "Using" << v_total << "/" << (v_total + v_dropped)
-                << "(" << pc << "%)" << "of events.";
-    }
-    v_total = 0;
-    v_dropped = 0;
-
+    return inPort.queryunprocessed();
 }
 
 std::deque<double> vPreProcess::getDelays()
@@ -367,8 +443,32 @@ std::deque<double> vPreProcess::getIntervals()
     return icopy;
 }
 
+template <typename T> void vPreProcess::publish(std::deque<T> &qleft,
+                                                std::deque<T> &qright,
+                                                Stamp &stamp)
+{
+    v_total->add(qleft.size() + qright.size());
+
+    if(!split && ordered) {
+        //the two cameras are each in order, but not with each other
+        std::deque<T> qstereo;
+        std::vector<const std::deque<T> *> cams = {&qleft, &qright};
+        stereomerge.merge(cams, qstereo);
+        qleft.swap(qstereo);
+        qright.clear();
+    }
+
+    if(qleft.size()) {
+        outPortCamLeft.write(qleft, stamp);
+    }
+    if(qright.size()) {
+        outPortCamRight.write(qright, stamp);
+    }
+}
+
 void vPreProcess::run()
 {
+    vMetrics::get().registerThread(name);
     Stamp zynq_stamp;
     Stamp local_stamp;
 
@@ -377,18 +477,22 @@ void vPreProcess::run()
     resmod.width -= 1;
     int nm0 = 0, nm1 = 0, nm2 = 0, nm3 = 0, nm4 = 0;
     AE v;
-    SkinEvent se;
-    SkinSample ss;
-    bool received_half_sample = false;
-    int32_t salvage_sample[2] = {-1, 0};
+    skinDemux skindemux;
+    std::vector<int32_t> qskin;
+    skinSamples qskinsamples;
+    std::vector<int32_t> skinsamples_wire;
+    std::vector<AE> vision;
+    WeightedAE w;
+    const int sub = WeightedAE::subpixel;
 
     while(true) {
 
         double pyt = zynq_stamp.getTime();
 
         std::deque<AE> qleft, qright;
-        std::deque<int32_t> qskin;
-        std::deque<int32_t> qskinsamples;
+        std::deque<WeightedAE> wleft, wright;
+        qskin.clear();
+        qskinsamples.clear();
         const std::vector<int32_t> *q = inPort.read(zynq_stamp);
         if(!q) break;
 
@@ -410,17 +514,14 @@ void vPreProcess::run()
 
         //unsigned int events_in_packet = 0;
         const int32_t *qi = q->data();
+        vision.clear();
 
         while ((size_t)(qi - q->data()) < q->size()) {
 
             if(IS_SKIN(*(qi+1))) {
-                if(IS_SAMPLE(*(qi+1))) {
-                    qskinsamples.push_back(*(qi++)); //TS
-                    qskinsamples.push_back(*(qi++)); //VALUE/TAXEL
-                } else {
-                    qskin.push_back(*(qi++)); //TS
-                    qskin.push_back(*(qi++)); //TAXEL
-                }
+                //a sample is split over two pairs which can be in different packets
+                skindemux.push(qi, qskin, qskinsamples);
+                qi += 2;
             } else { // IS_VISION
 
                 v.decode(qi);
@@ -435,89 +536,94 @@ void vPreProcess::run()
                 if(flipx) v.x = resmod.width - v.x;
                 if(flipy) v.y = resmod.height - v.y;
 
-                //salt and pepper filter
-                if(pepper && !thefilter.check(v.x, v.y, v.polarity, v.channel, v.stamp)) {
-                    v_dropped++;
+                vision.push_back(v);
+            }
+        }
+
+        //salt and pepper filter of the whole packet
+        if(pepper)
+            v_dropped->add(thefilter.filter(vision));
+
+        for(size_t i = 0; i < vision.size(); i++) {
+
+            v = vision[i];
+
+            //undistortion (including rectification)
+            if(undistort) {
+                int32_t m = remap[(v.channel * res.height + v.y) * res.width + v.x];
+                int fx = (int16_t)(m & 0xFFFF);
+                int fy = (int16_t)(m >> 16);
+                int mx = (fx + sub / 2) >> remap_bits;
+                int my = (fy + sub / 2) >> remap_bits;
+
+                //truncate to sensor bounds after mapping?
+                if(remap_mode != SPLAT && truncate &&
+                        (mx < 0 || mx > resmod.width || my < 0 || my > resmod.height)) {
                     continue;
                 }
 
-                //undistortion (including rectification)
-                if(undistort) {
-                    cv::Vec2i mapPix;
-                    if(v.getChannel() == 0)
-                        mapPix = leftMap.at<cv::Vec2i>(v.y, v.x);
-                    else
-                        mapPix = rightMap.at<cv::Vec2i>(v.y, v.x);
-
-                    //truncate to sensor bounds after mapping?
-                    if(truncate && (mapPix[0] < 0 ||
-                                    mapPix[0] > resmod.width ||
-                                    mapPix[1] < 0 ||
-                                    mapPix[1] > resmod.height)) {
+                if(remap_mode != NEAREST) {
+                    std::deque<WeightedAE> &wq =
+                            (split || ordered) && v.channel ? wright : wleft;
+                    static_cast<AE &>(w) = v;
+                    w.subx = fx;
+                    w.suby = fy;
+                    w.weight = 1;
+                    if(remap_mode == SUBPIXEL) {
+                        w.x = mx;
+                        w.y = my;
+                        wq.push_back(w);
                         continue;
                     }
 
-                    v.x = mapPix[0];
-                    v.y = mapPix[1];
-                    //std::cout.precision(30);
-                    //std::cout<<v.channel<<mapPix<<"timestamp:"<<pyt<<std::endl;
-
+                    //bilinear weights of the four pixels around the position,
+                    //dropping the pixels outside the sensor
+                    int x0 = fx >> remap_bits, ax = fx & (sub - 1);
+                    int y0 = fy >> remap_bits, ay = fy & (sub - 1);
+                    for(int dy = 0; dy < 2; dy++) {
+                        for(int dx = 0; dx < 2; dx++) {
+                            int wi = (dx ? ax : sub - ax) * (dy ? ay : sub - ay);
+                            int px = x0 + dx, py = y0 + dy;
+                            if(!wi || px < 0 || px > resmod.width ||
+                                    py < 0 || py > resmod.height)
+                                continue;
+                            w.x = px;
+                            w.y = py;
+                            w.weight = wi / (float)(sub * sub);
+                            wq.push_back(w);
+                        }
+                    }
+                    continue;
                 }
 
-                if(split && v.channel)
-                {
-                    qright.push_back(v);
-                }   else {
-                    qleft.push_back(v);
-                }
+                v.x = mx;
+                v.y = my;
             }
 
-        }
-
-        if(qskinsamples.size() > 2) { //if we have skin samples
-            //check if we need to fix the ordering
-            if(IS_SSV(qskinsamples[1])) { // missing address
-                if(received_half_sample) { // but we have it from last bottle
-                    qskinsamples.push_front(salvage_sample[1]);
-                    qskinsamples.push_front(salvage_sample[0]);
-                } else { // otherwise we are misaligned due to missing data
-                    qskinsamples.pop_front();
-                    qskinsamples.pop_front();
-                }
-            }
-            received_half_sample = false; //either case the half sample is no longer valid
-
-            //check if we now have a cut event
-            int samples_overrun = qskinsamples.size() % packetSize(SkinSample::tag);
-            if(samples_overrun == 2) {
-                salvage_sample[1] = qskinsamples.back();
-                qskinsamples.pop_back();
-                salvage_sample[0] = qskinsamples.back();
-                qskinsamples.pop_back();
-                received_half_sample = true;
-            } else if(samples_overrun) {
-                yError() << "samples cut by " << samples_overrun;
+            if((split || ordered) && v.channel)
+            {
+                qright.push_back(v);
+            }   else {
+                qleft.push_back(v);
             }
-        }
 
-        v_total += qleft.size() + qright.size();
+        }
 
         if(use_local_stamp) {
             local_stamp.update();
             zynq_stamp = local_stamp;
         }
 
-        if(qleft.size()) {
-            outPortCamLeft.write(qleft, zynq_stamp);
-        }
-        if(qright.size()) {
-            outPortCamRight.write(qright, zynq_stamp);
-        }
+        publish(qleft, qright, zynq_stamp);
+        publish(wleft, wright, zynq_stamp);
+
         if(qskin.size()) {
             outPortSkin.write(qskin, zynq_stamp);
         }
         if(qskinsamples.size()) {
-            outPortSkinSamples.write(qskinsamples, zynq_stamp);
+            skinsamples_wire.clear();
+            qskinsamples.encode(skinsamples_wire);
+            outPortSkinSamples.write(skinsamples_wire, zynq_stamp);
         }
     }
 
@@ -534,6 +640,11 @@ void vPreProcess::onStop()
 
 bool vPreProcess::threadInit()
 {
+    v_total = &vMetrics::get().counter("ev_preprocess_events_total",
+                                       "vision events passed on", "module=\"" + name + "\"");
+    v_dropped = &vMetrics::get().counter("ev_preprocess_filtered_total",
+                                         "events removed by the salt and pepper filter",
+                                         "module=\"" + name + "\"");
     if(split) {
         if(!outPortCamLeft.open(name + "/left:o"))
             return false;
@@ -547,7 +658,17 @@ bool vPreProcess::threadInit()
         return false;
     if(!outPortSkinSamples.open(name + "/skinsamples:o"))
         return false;
-    if(!inPort.open(name + "/AE:i"))
+    if(shared_output) {
+        if(!outPortCamLeft.enableSharedMemory())
+            return false;
+        if(split && !outPortCamRight.enableSharedMemory())
+            return false;
+        if(!outPortSkin.enableSharedMemory())
+            return false;
+        if(!outPortSkinSamples.enableSharedMemory())
+            return false;
+    }
+    if(!inPort.open(name + "/AE:i", shared_input))
         return false;
     return true;
 }
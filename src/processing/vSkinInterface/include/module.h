@@ -34,6 +34,12 @@ class module : public yarp::os::RFModule
 
     skinInterface skinterface;
 
+    //diagnostics (written at a fixed rate from the taxel table)
+    yarp::os::BufferedPort<yarp::os::Bottle> scopePort;
+    double scopePeriod;
+    double pscopetime;
+    std::vector<unsigned int> scopeTaxels;
+
 public:
 
     //the virtual functions that need to be overloaded
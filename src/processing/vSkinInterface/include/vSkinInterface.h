@@ -4,7 +4,7 @@
 #include <yarp/os/all.h>
 #include <yarp/sig/Vector.h>
 #include <iCub/eventdriven/all.h>
-#include <iCub/eventdriven/deprecated.h>
+#include <atomic>
 
 using namespace ev;
 
@@ -17,18 +17,19 @@ class skinInterface : public yarp::os::Thread
 private:
 
     //data structures and ports
-    queueAllocator inputPort;
-    yarp::os::Port outEvPort;
-    yarp::os::Port outRawPort;
+    vReadPort< std::vector<int32_t> > inputPort;
+    vWritePort outEvPort;
+    vWritePort outRawPort;
 
     //variables
-
-    //diagnostics
-    yarp::os::BufferedPort<yarp::os::Bottle> scopePort;
+    skinDemux demux;
+    skinTaxelTable taxels;
+    std::atomic<unsigned long> countEv;
+    std::atomic<unsigned long> countRaw;
 
 public:
 
-    skinInterface() {}
+    skinInterface() : countEv(0), countRaw(0) {}
 
     bool open(std::string name);
 
@@ -37,6 +38,11 @@ public:
     void run();
     //void threadRelease();
 
+    /// \brief the latest value of every taxel (safe to read from any thread)
+    const skinTaxelTable &getTaxels() { return taxels; }
+    /// \brief the number of events and samples since the last call
+    void queryCounts(unsigned long &events, unsigned long &samples);
+
 };
 
 
@@ -53,7 +53,20 @@ bool module::configure(yarp::os::ResourceFinder &rf)
     //        rf.check("adaptive", yarp::os::Value(true)).asBool();
 
 
-    
+    //the scope only shows the rates and the latest value of a few taxels
+    scopePeriod = 1.0 / rf.check("scopeRate", yarp::os::Value(20.0)).asDouble();
+    yarp::os::Bottle *taxellist = rf.find("scopeTaxels").asList();
+    if(taxellist) {
+        for(size_t i = 0; i < taxellist->size(); i++) {
+            unsigned int t = taxellist->get(i).asInt();
+            if(t < skinSamples::taxelCount())
+                scopeTaxels.push_back(t);
+        }
+    }
+    if(!scopePort.open(getName() + "/scope:o"))
+        return false;
+    pscopetime = yarp::os::Time::now();
+
     if(!skinterface.open(getName()))
         return false;
     return skinterface.start();
@@ -64,26 +77,50 @@ bool module::configure(yarp::os::ResourceFinder &rf)
 bool module::interruptModule()
 {
     skinterface.stop();
+    scopePort.interrupt();
     return true;
 }
 
 /******************************************************************************/
 bool module::close()
 {
-
+    scopePort.close();
     return true;
 }
 
 /******************************************************************************/
 bool module::updateModule()
 {
-    return true;
+    unsigned long countEv, countRaw;
+    skinterface.queryCounts(countEv, countRaw);
+
+    double dt = yarp::os::Time::now() - pscopetime;
+    pscopetime += dt;
+
+    if(scopePort.getOutputCount()) {
+
+        yarp::os::Bottle &scopedata = scopePort.prepare();
+        scopedata.clear();
+        scopedata.addDouble(countEv / dt);
+        scopedata.addDouble(countRaw / dt);
+
+        const skinTaxelTable &taxels = skinterface.getTaxels();
+        for(auto t : scopeTaxels) {
+            int value, delta;
+            taxels.get(t, value, delta);
+            scopedata.addInt(value);
+        }
+
+        scopePort.write();
+    }
+
+    return !isStopping();
 }
 
 /******************************************************************************/
 double module::getPeriod()
 {
-    return 1;
+    return scopePeriod;
 
 }
 
@@ -13,8 +13,9 @@ bool skinInterface::open(std::string name)
         return false;
     if(!outRawPort.open(name + "/vBottleRaw:o"))
         return false;
-    if(!scopePort.open(name + "/scope:o"))
-        return false;
+
+    outEvPort.setWriteType(SkinEvent::tag);
+    outRawPort.setWriteType(SkinSample::tag);
 
     return true;
 }
@@ -24,89 +25,48 @@ void skinInterface::onStop()
     inputPort.close();
     outEvPort.close();
     outRawPort.close();
-    scopePort.close();
-    inputPort.releaseDataLock();
+}
+
+void skinInterface::queryCounts(unsigned long &events, unsigned long &samples)
+{
+    events = countEv.exchange(0);
+    samples = countRaw.exchange(0);
 }
 
 void skinInterface::run()
 {
+    ev::vMetrics::get().registerThread("vSkinInterface");
     yarp::os::Stamp ystamp;
 
-    //event output data
-    vBottleMimic eventBottle;
-    eventBottle.setHeader(AE::tag);
-
-    vBottleMimic rawBottle;
-    rawBottle.setHeader(AE::tag);
+    std::vector<int32_t> qsend_ev;
+    skinSamples samples;
+    std::vector<int32_t> qsend_raw;
 
     while(true) {
 
-        //int firstEv = 0, lastEv = 0, firstRaw = 0 , lastRaw = 0;
-        //double dt;
-        int countEv = 0, countRaw = 0;
-        vQueue qsend_ev, qsend_raw;
-
-        const ev::vQueue *q = inputPort.read(ystamp);
+        const std::vector<int32_t> *q = inputPort.read(ystamp);
         if(!q || isStopping()) return;
 
+        //split the whole packet into events and samples
+        qsend_ev.clear();
+        samples.clear();
+        demux.process(q->data(), q->size(), qsend_ev, samples);
 
-        for(unsigned int i = 0; i < q->size(); i++) {
-
-            AE *v = read_as<AE>((*q)[i]);
-            bool vType = v->type;
-            if (vType == 0){
-                qsend_ev.push_back((*q)[i]);
-//                if (firstEv == 0)
-//                {
-//                    firstEv = v->stamp;
-//                }
-//                lastEv = v->stamp;
-                countEv++;
-
-            } else {
-                qsend_raw.push_back((*q)[i]);
-//                if (firstRaw == 0)
-//                {
-//                    firstRaw = v->stamp;
-//                }
-//                lastRaw = v->stamp;
-                countRaw++;
-            }
-
-        }
-
-        //write to our scope
-        static double pscopetime = yarp::os::Time::now();
-        if(scopePort.getOutputCount()) {
-
-            double dt = yarp::os::Time::now() - pscopetime;
-            pscopetime += dt;
-
-            yarp::os::Bottle &scopedata = scopePort.prepare();
-            scopedata.clear();
-            scopedata.addDouble(countEv / dt);
-            scopedata.addDouble(countRaw / dt);
-
-            scopePort.write();
-
-        }
+        //update the per-taxel table read by other threads
+        taxels.update(samples);
+        countEv += qsend_ev.size() / 2;
+        countRaw += samples.size();
 
+        //the envelope of the input is forwarded to keep its provenance
         if(qsend_ev.size()) {
-            ystamp.update();
-            eventBottle.setInternalData(qsend_ev);
-            outEvPort.setEnvelope(ystamp);
-            outEvPort.write(eventBottle);
+            outEvPort.write(qsend_ev, ystamp);
         }
-        if(qsend_raw.size()) {
-            ystamp.update();
-            rawBottle.setInternalData(qsend_raw);
-            outRawPort.setEnvelope(ystamp);
-            outRawPort.write(rawBottle);
+        if(samples.size()) {
+            qsend_raw.clear();
+            samples.encode(qsend_raw);
+            outRawPort.write(qsend_raw, ystamp);
         }
 
     }
 
-
-
 }
-